@@ -0,0 +1,68 @@
+#!/bin/bash
+
+#generates src/dimensions/convspec.c : row convolutions with the disc footprint of a given radius baked in
+#usage : ./scripts/genconv.sh [radius...]
+
+out=./src/dimensions/convspec.c
+radii=${@:-5 8 10 13 16 20}
+
+for r in $radii; do
+	if ! [[ $r =~ ^[1-9][0-9]*$ ]]; then
+		echo "Error: Invalid radius '$r'."
+		exit 2
+	fi
+done
+
+echo "generating $out for radii $radii..."
+awk -v radii="$radii" '
+BEGIN {
+	n = split(radii, rs, " ")
+	print "//generated by scripts/genconv.sh, do not edit"
+	print "#include \"dimpriv.h\""
+	print ""
+	print "//accumulates the taps LO..HI of kernel row K over a block of outputs"
+	print "#define ROW(K, LO, HI) { \\"
+	print "    const float *row = rows[K] + x; \\"
+	print "    const float *taps = kernel + K*SIDE; \\"
+	print "    for (int t = LO; t <= HI; ++t) { \\"
+	print "        const float tap = taps[t]; \\"
+	print "        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { acc[i] += tap*row[t+i]; } \\"
+	print "    } \\"
+	print "}"
+	for (k = 1; k <= n; ++k) {
+		r = rs[k]
+		print ""
+		print "#define SIDE " 2*r+1
+		print "static const int spans" r "[] = {"
+		line = "   "
+		for (i = -r; i <= r; ++i) {
+			#widest j with i*i+j*j <= r*r, the disc of genKernel
+			j = 0
+			while ((j+1)*(j+1) + i*i <= r*r) { ++j }
+			lo[i] = r-j; hi[i] = r+j
+			line = line " " lo[i] ", " hi[i] ","
+		}
+		print line
+		print "};"
+		print ""
+		print "static void convRow" r "(Dimension *dim, const float **rows, float *out) {"
+		print "    const float *kernel = dim->kernel;"
+		print "    const float inv = 1.f/dim->kSum;"
+		print "    int w = dim->MATRIXWIDTH, x = 0;"
+		print "    for (; x+DIM_CONV_BLOCK <= w; x += DIM_CONV_BLOCK) {"
+		print "        float acc[DIM_CONV_BLOCK] = { 0.f };"
+		for (i = -r; i <= r; ++i) { print "        ROW(" i+r ", " lo[i] ", " hi[i] ")" }
+		print "        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { out[x+i] = acc[i]*inv; }"
+		print "    }"
+		print "    convRowRange(dim, rows, out, x, w);"
+		print "}"
+		print "#undef SIDE"
+	}
+	print "#undef ROW"
+	print ""
+	print "const DimConvSpec convSpecs[] = {"
+	for (k = 1; k <= n; ++k) { print "    { " rs[k] ", spans" rs[k] ", convRow" rs[k] " }," }
+	print "    { 0, NULL, NULL }"
+	print "};"
+}' | sed 's/$/\r/' > $out
+echo "Done"
@@ -0,0 +1,157 @@
+/*  Autotuner of libdimensions worlds, times the settings of each world shape and saves the fastest for this machine    */
+
+
+/********************** PREPROCESSOR **********************/
+
+//LIBS
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dimensions.h>
+
+void usage();
+int tuneShape(int size, int radius);
+bool parseList(const char *arg, int *list, int *count, int max);
+
+
+/********************** C **********************/
+
+int sizes[16] = { 256, 512, 1024 };
+int sizeCount = 3;
+int radii[16] = { 5, 13 };
+int radiusCount = 2;
+const char *layoutNames[] = { "rows", "morton" };
+DimEngine engine = DIM_ENGINE_AUTO;
+bool inPlace = false;
+bool volume = false;
+int channels = 0;           //of multi-channel worlds, a kernel from each channel to each, 0 for single kernel ones
+double seconds = 2.;        //budget of the trials of a shape
+bool force = false;         //tune again the shapes that already have settings
+unsigned long long seed = 1;
+
+
+/************************* MAIN  *************************/
+int main(int argc, char **argv) {
+    for (int k = 1; k < argc; ++k) {
+        if (strcmp(argv[k], "-I") == 0) {
+            inPlace = true;
+        } else if (strcmp(argv[k], "-V") == 0) {
+            volume = true;
+        } else if (strcmp(argv[k], "-f") == 0) {
+            force = true;
+        } else if (strcmp(argv[k], "-n") == 0 && k+1 < argc) {
+            if (!parseList(argv[++k], sizes, &sizeCount, 16)) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-r") == 0 && k+1 < argc) {
+            if (!parseList(argv[++k], radii, &radiusCount, 16)) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-s") == 0 && k+1 < argc) {
+            seconds = atof(argv[++k]);
+            if (!(seconds > 0.)) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-C") == 0 && k+1 < argc) {
+            channels = atoi(argv[++k]);
+            if (channels < 1) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-R") == 0 && k+1 < argc) {
+            seed = strtoull(argv[++k], NULL, 10);
+        } else if (strcmp(argv[k], "-E") == 0 && k+1 < argc) {
+            const char *name = argv[++k];
+            engine = DIM_ENGINE_COUNT;
+            for (int e = 0; e < DIM_ENGINE_COUNT; ++e) { if (strcmp(name, getEngineName(e)) == 0) { engine = e; } }
+            if (engine == DIM_ENGINE_COUNT) { usage(); return 2; }
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (volume && (inPlace || channels > 0)) {
+        usage();
+        return 2;
+    }
+
+    int failed = 0;
+    printf("%-10s %-6s %-8s %-8s %-7s %-6s %-7s %-12s\n", "size", "radius", "engine", "threads", "passes", "tile", "layout", "ms/gen");
+    for (int s = 0; s < sizeCount; ++s) {
+        for (int r = 0; r < radiusCount; ++r) { failed += tuneShape(sizes[s], radii[r]); }
+    }
+    return failed > 0;
+}
+
+
+/************************* FUNCTIONS  *************************/
+
+void usage() {
+    fprintf(stderr,
+        "usage : autotune [-I] [-V] [-f] [-n sizes] [-r radii] [-E engine] [-C channels] [-s seconds] [-R seed]\n"
+        "  -I  worlds stepped in place, without cells\n"
+        "  -V  volumes, cubes of the sizes\n"
+        "  -f  tune again the shapes already tuned on this machine\n"
+        "  -n  sizes of the worlds (256,512,1024)\n"
+        "  -r  kernel radii (5,13)\n"
+        "  -E  step engine among reference,direct,jit,fft,auto (auto)\n"
+        "  -C  multi-channel worlds, a kernel from each channel to each\n"
+        "  -s  seconds of trials for each shape (2)\n"
+        "  -R  seed of the random worlds the trials step (1)\n"
+        "  settings are saved in the cache directory of libdimensions ($DIM_CACHE_DIR, else ~/.cache/dimensions)\n"
+        "  and applied to worlds of the same shape by tuneDimension\n");
+}
+
+//parses a comma separated list of positive integers
+bool parseList(const char *arg, int *list, int *count, int max) {
+    *count = 0;
+    while (*arg != '\0' && *count < max) {
+        char *end;
+        long v = strtol(arg, &end, 10);
+        if (end == arg || v <= 0) { return false; }
+        list[(*count)++] = (int)v;
+        arg = *end == ',' ? end+1 : end;
+    }
+    return *count > 0;
+}
+
+//tunes a random world of the shape, or loads its settings when it was already tuned, and prints them
+int tuneShape(int size, int radius) {
+    Dimension *dim = volume
+        ? CreateVolumeDimension(size, size, size, radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, radius)
+        : inPlace
+        ? CreateInPlaceDimension(size, size, radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, radius, DIM_STORAGE_FLOAT32)
+        : CreateDimension(size, size, 1, radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, radius);
+    if (dim == NULL) { return 1; }
+    if (channels > 0) {
+        if (setDimensionChannels(dim, channels) != 0) {
+            DestroyDimension(dim);
+            return 1;
+        }
+        for (int k = 0; k < channels*channels; ++k) {
+            addChannelKernel(dim, k % channels, k / channels, radius, 1.f/channels, dim->a, dim->b, dim->c, dim->d);
+        }
+    }
+    setDimensionEngine(dim, engine);
+    setDimensionSeed(dim, seed);
+    randomizeDimensionByKernel(dim);
+
+    int failed = tuneDimension(dim, seconds, force);
+    if (failed != 0) {
+        fprintf(stderr, "Failed to tune %dx%d r=%d\n", size, size, radius);
+        DestroyDimension(dim);
+        return 1;
+    }
+    //time of a generation with the settings, on the world as it was before the trials
+    doSteps(dim, getBlockDepth(dim) > 0 ? getBlockDepth(dim) : 1);
+    int generations = 0;
+    double start = dimClock(), elapsed = 0.;
+    while (elapsed < seconds/4 || generations == 0) {
+        int n = getBlockDepth(dim) > 0 ? getBlockDepth(dim) : 1;
+        doSteps(dim, n);
+        generations += n;
+        elapsed = dimClock() - start;
+    }
+    char shape[32];
+    if (volume) {
+        snprintf(shape, sizeof(shape), "%dx%dx%d", size, size, size);
+    } else {
+        snprintf(shape, sizeof(shape), "%dx%d", size, size);
+    }
+    printf("%-10s %-6d %-8s %-8d %-7d %-6d %-7s %-12.3f\n", shape, radius, getEngineName(getStepEngine(dim)),
+        getDimensionThreads(dim), getBlockDepth(dim), getTileRows(dim), layoutNames[getStateLayout(dim)], 1e3*elapsed/generations);
+    DestroyDimension(dim);
+    return 0;
+}
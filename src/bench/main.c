@@ -0,0 +1,541 @@
+/*  Benchmark of the libdimensions step pipeline, results are written as JSON    */
+
+
+/********************** PREPROCESSOR **********************/
+
+//LIBS
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <dimensions.h>
+#include "perfcounters.h"
+
+//DEFS
+#define MAXTHREADCOUNTS 16
+
+typedef struct Workload {
+    const char *name;
+    const char *blob; //NULL for a randomized world
+    int size;
+    int radius;
+    DimStorage storage;
+} Workload;
+
+void usage();
+int runWorkload(Workload *wl, int threads, bool first);
+bool parseList(const char *arg, int *list, int *count, int max);
+bool parseStorages(const char *arg);
+
+
+/********************** C **********************/
+
+//full sweep, -q reduces it to the small sizes
+int sizes[16] = { 128, 256, 512, 1024, 2048, 4096 };
+int sizeCount = 6;
+int radii[16] = { 5, 13, 32, 64 };
+int radiusCount = 4;
+int threadCounts[MAXTHREADCOUNTS];
+int threadCount = 0;
+const char *scenes[] = { "glider", "colision" };
+const char *storageNames[] = { "float32", "float16", "fixed16", "uint8" };
+DimStorage storages[4] = { DIM_STORAGE_FLOAT32 };
+int storageCount = 1;
+const char *layoutNames[] = { "rows", "morton" };
+DimLayout layout = DIM_LAYOUT_ROWS;
+const char *hugePageNames[] = { "auto", "transparent", "explicit", "none" };
+const char *affinityNames[] = { "none", "compact", "scatter" };
+DimAffinity affinity = DIM_AFFINITY_NONE;
+unsigned long long seed = 1; //of the random worlds, fixed so that runs time the same worlds
+const char *noiseNames[] = { "uniform", "gaussian", "correlated" };
+int noise = -1;          //noise added after every step, -1 for none
+float noiseLength = 4.f; //of correlated noise
+int channels = 0;       //of multi-channel worlds, 0 for single kernel ones
+int channelKernels = 0; //kernels between their channels
+float shellPeaks[DIM_MAX_SHELLS]; //of beta-shell kernels, 0 shells for the single bump
+int shellCount = 0;
+DimGrowthFunction growthFunction = DIM_GROWTH_GAUSSIAN;
+float growthSkew = 2.f; //of the asymmetric growth
+DimKernelFunction kernelFunction = DIM_KERNEL_EXPONENTIAL;
+int accuracyGenerations = 20;
+DimEngine engine = DIM_ENGINE_DIRECT;
+int depth = 1;
+bool inPlace = false;
+bool volume = false; //cubes of the sizes, stepped with 3D transforms
+const char *savesDir = "./saves";
+double minTime = 1.;
+double maxStepTime = 10.;
+bool useCounters = true;
+double bandwidth = -1.;
+FILE *out;
+
+//measured cell-taps per second for each thread count, used to skip hopeless configurations
+double tapRate[MAXTHREADCOUNTS];
+
+
+/************************* MAIN  *************************/
+int main(int argc, char **argv) {
+    const char *outPath = NULL;
+
+    for (int k = 1; k < argc; ++k) {
+        if (strcmp(argv[k], "-q") == 0) {
+            sizeCount = 2;
+            radiusCount = 2;
+            minTime = .25;
+        } else if (strcmp(argv[k], "-I") == 0) {
+            inPlace = true;
+        } else if (strcmp(argv[k], "-V") == 0) {
+            volume = true;
+        } else if (strcmp(argv[k], "-P") == 0) {
+            useCounters = false;
+        } else if (strcmp(argv[k], "-o") == 0 && k+1 < argc) {
+            outPath = argv[++k];
+        } else if (strcmp(argv[k], "-s") == 0 && k+1 < argc) {
+            savesDir = argv[++k];
+        } else if (strcmp(argv[k], "-m") == 0 && k+1 < argc) {
+            minTime = atof(argv[++k]);
+        } else if (strcmp(argv[k], "-x") == 0 && k+1 < argc) {
+            maxStepTime = atof(argv[++k]);
+        } else if (strcmp(argv[k], "-n") == 0 && k+1 < argc) {
+            if (!parseList(argv[++k], sizes, &sizeCount, 16)) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-r") == 0 && k+1 < argc) {
+            if (!parseList(argv[++k], radii, &radiusCount, 16)) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-S") == 0 && k+1 < argc) {
+            if (!parseStorages(argv[++k])) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-G") == 0 && k+1 < argc) {
+            accuracyGenerations = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-E") == 0 && k+1 < argc) {
+            const char *name = argv[++k];
+            engine = DIM_ENGINE_COUNT;
+            for (int e = 0; e < DIM_ENGINE_COUNT; ++e) { if (strcmp(name, getEngineName(e)) == 0) { engine = e; } }
+            if (engine == DIM_ENGINE_COUNT) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-L") == 0 && k+1 < argc) {
+            const char *name = argv[++k];
+            if (strcmp(name, layoutNames[DIM_LAYOUT_ROWS]) == 0) {
+                layout = DIM_LAYOUT_ROWS;
+            } else if (strcmp(name, layoutNames[DIM_LAYOUT_MORTON]) == 0) {
+                layout = DIM_LAYOUT_MORTON;
+            } else {
+                usage();
+                return 2;
+            }
+        } else if (strcmp(argv[k], "-H") == 0 && k+1 < argc) {
+            const char *name = argv[++k];
+            int mode = -1;
+            for (int h = 0; h < 4; ++h) { if (strcmp(name, hugePageNames[h]) == 0) { mode = h; } }
+            if (mode < 0) { usage(); return 2; }
+            setHugePages((DimHugePages)mode);
+        } else if (strcmp(argv[k], "-A") == 0 && k+1 < argc) {
+            const char *name = argv[++k];
+            int policy = -1;
+            for (int a = 0; a < 3; ++a) { if (strcmp(name, affinityNames[a]) == 0) { policy = a; } }
+            if (policy < 0) { usage(); return 2; }
+            affinity = (DimAffinity)policy;
+        } else if (strcmp(argv[k], "-B") == 0 && k+1 < argc) {
+            depth = atoi(argv[++k]);
+            if (depth < 1) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-t") == 0 && k+1 < argc) {
+            if (!parseList(argv[++k], threadCounts, &threadCount, MAXTHREADCOUNTS)) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-R") == 0 && k+1 < argc) {
+            seed = strtoull(argv[++k], NULL, 10);
+        } else if (strcmp(argv[k], "-N") == 0 && k+1 < argc) {
+            //kind[:length]
+            const char *name = argv[++k], *colon = strchr(name, ':');
+            size_t len = colon != NULL ? (size_t)(colon-name) : strlen(name);
+            noise = -1;
+            for (int n = 0; n < 3; ++n) { if (strlen(noiseNames[n]) == len && strncmp(name, noiseNames[n], len) == 0) { noise = n; } }
+            if (colon != NULL) { noiseLength = (float)atof(colon+1); }
+            if (noise < 0 || !(noiseLength > 0.f)) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-C") == 0 && k+1 < argc) {
+            //channels[:kernels]
+            char *end;
+            channels = (int)strtol(argv[++k], &end, 10);
+            channelKernels = *end == ':' ? atoi(end+1) : channels*channels;
+            if (channels < 1 || channelKernels < 1) { usage(); return 2; }
+        } else if (strcmp(argv[k], "-K") == 0 && k+1 < argc) {
+            //comma separated peaks
+            const char *arg = argv[++k];
+            for (shellCount = 0; *arg != '\0' && shellCount < DIM_MAX_SHELLS; ) {
+                char *end;
+                shellPeaks[shellCount++] = strtof(arg, &end);
+                if (end == arg) { usage(); return 2; }
+                arg = *end == ',' ? end+1 : end;
+            }
+            if (*arg != '\0') { usage(); return 2; }
+        } else if (strcmp(argv[k], "-g") == 0 && k+1 < argc) {
+            //function[:skew]
+            char name[32];
+            const char *arg = argv[++k], *colon = strchr(arg, ':');
+            snprintf(name, sizeof(name), "%.*s", colon != NULL ? (int)(colon-arg) : (int)strlen(arg), arg);
+            if (colon != NULL) { growthSkew = (float)atof(colon+1); }
+            int f = findGrowthFunction(name);
+            if (f < 0 || f == DIM_GROWTH_CALLBACK || !(growthSkew > 0.f)) { usage(); return 2; }
+            growthFunction = (DimGrowthFunction)f;
+        } else if (strcmp(argv[k], "-k") == 0 && k+1 < argc) {
+            int f = findKernelFunction(argv[++k]);
+            if (f < 0 || f == DIM_KERNEL_CALLBACK) { usage(); return 2; }
+            kernelFunction = (DimKernelFunction)f;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    //volumes have a single float32 channel in rows and no correlated noise
+    if (volume && (inPlace || channels > 0 || storageCount > 1 || storages[0] != DIM_STORAGE_FLOAT32 || layout != DIM_LAYOUT_ROWS
+        || noise == DIM_NOISE_CORRELATED)) {
+        usage();
+        return 2;
+    }
+    //worlds with cells only store float32 states
+    for (int k = 0; k < storageCount && !inPlace; ++k) {
+        if (storages[k] != DIM_STORAGE_FLOAT32) {
+            usage();
+            return 2;
+        }
+    }
+
+    //default thread counts : powers of two up to the cpu count, and the cpu count itself
+    if (threadCount == 0) {
+        int cpus = getCpuCount();
+        for (int t = 1; t < cpus && threadCount < MAXTHREADCOUNTS-1; t *= 2) { threadCounts[threadCount++] = t; }
+        threadCounts[threadCount++] = cpus;
+    }
+
+    out = stdout;
+    if (outPath != NULL) {
+        out = fopen(outPath, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Failed to open \"%s\"\n", outPath);
+            return 1;
+        }
+    }
+
+    //roof of the memory bound configurations, measured with every thread
+    if (useCounters) {
+        int maxThreads = 1;
+        for (int t = 0; t < threadCount; ++t) { if (threadCounts[t] > maxThreads) { maxThreads = threadCounts[t]; } }
+        bandwidth = measureBandwidth(maxThreads);
+    }
+
+    fprintf(out, "{\n  \"benchmark\": \"doStep\",\n  \"cpus\": %d,\n", getCpuCount());
+    if (bandwidth > 0) {
+        fprintf(out, "  \"memory_bandwidth_gbs\": %.3f,\n", bandwidth*1e-9);
+    } else {
+        fprintf(out, "  \"memory_bandwidth_gbs\": null,\n");
+    }
+    fprintf(out, "  \"results\": [");
+    bool first = true;
+
+    //randomized worlds
+    for (int t = 0; t < threadCount; ++t) {
+        for (int st = 0; st < storageCount; ++st) {
+            for (int r = 0; r < radiusCount; ++r) {
+                for (int s = 0; s < sizeCount; ++s) {
+                    Workload wl = { "random", NULL, sizes[s], radii[r], storages[st] };
+                    if (runWorkload(&wl, t, first) == 0) { first = false; }
+                }
+            }
+        }
+    }
+
+    //shipped scenes, stepped with the parameters of the viewer
+    for (int t = 0; t < threadCount && !volume; ++t) {
+        for (int k = 0; k < (int)(sizeof(scenes)/sizeof(scenes[0])); ++k) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s.blob", savesDir, scenes[k]);
+            long len = getBlobLength(path);
+            int side = (int)sqrt((double)len);
+            if (len <= 0 || (long)side*side != len) {
+                fprintf(stderr, "Skipping scene \"%s\" : not found or not square\n", path);
+                continue;
+            }
+            Workload wl = { scenes[k], path, side, 13, DIM_STORAGE_FLOAT32 };
+            if (runWorkload(&wl, t, first) == 0) { first = false; }
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) { fclose(out); }
+    return 0;
+}
+
+
+/************************* FUNCTIONS  *************************/
+
+void usage() {
+    fprintf(stderr,
+        "usage : bench [-q] [-P] [-I] [-V] [-o out.json] [-s savesdir] [-m mintime] [-x maxsteptime]\n"
+        "              [-n sizes] [-r radii] [-t threads] [-S storages] [-G generations]\n"
+        "              [-E engine] [-B depth] [-L layout] [-H hugepages] [-A affinity] [-R seed]\n"
+        "              [-N noise] [-C channels[:kernels]] [-K peaks] [-g growth] [-k kernel]\n"
+        "  -q  quick sweep (two sizes, two radii)\n"
+        "  -P  do not read the hardware performance counters\n"
+        "  -I  step worlds in place, without cells\n"
+        "  -V  step volumes, cubes of the sizes, with 3D transforms whatever the engine\n"
+        "  -m  minimum measured seconds per configuration (1)\n"
+        "  -x  configurations predicted slower than this per step are skipped (10)\n"
+        "  -E  step engine among reference,direct,jit,fft,auto (direct), the jit build is made before timing,\n"
+        "      auto reports the engine picked and the step time the cost model predicted\n"
+        "  -B  generations advanced per pass over the grid with doSteps (1)\n"
+        "  -S  state storages to sweep among float32,float16,fixed16,uint8 (float32), the packed ones need -I\n"
+        "  -G  generations compared against float32 to measure the accuracy of a storage (20)\n"
+        "  -L  order of the cells in the state plane, rows or morton (rows)\n"
+        "  -H  pages of the large buffers among auto,transparent,explicit,none (auto)\n"
+        "  -A  pinning of the workers among none,compact,scatter, each worker first touching the band it steps (none)\n"
+        "  -R  seed of the random worlds (1)\n"
+        "  -N  noise added after every step among uniform,gaussian,correlated[:length] (none, length 4)\n"
+        "  -C  multi-channel worlds, kernels (channels^2) from each channel to each in turn, of the radius,\n"
+        "      two thirds and half of it\n"
+        "  -K  beta-shell kernels, the peaks of their concentric rings, e.g. 1,.5,.25 (a single ring)\n"
+        "  -g  growth function among gaussian,polynomial,step,asymmetric[:skew] (gaussian, skew 2)\n"
+        "  -k  kernel function among exponential,polynomial,step (exponential)\n"
+        "  lists are comma separated, e.g. -n 256,1024 -r 5,13 -t 1,4\n");
+}
+
+//parses a comma separated list of positive integers
+bool parseList(const char *arg, int *list, int *count, int max) {
+    *count = 0;
+    while (*arg != '\0' && *count < max) {
+        char *end;
+        long v = strtol(arg, &end, 10);
+        if (end == arg || v <= 0) { return false; }
+        list[(*count)++] = (int)v;
+        arg = *end == ',' ? end+1 : end;
+    }
+    return *count > 0;
+}
+
+//parses a comma separated list of storage names
+bool parseStorages(const char *arg) {
+    storageCount = 0;
+    while (*arg != '\0' && storageCount < 4) {
+        size_t len = strcspn(arg, ",");
+        bool found = false;
+        for (int k = 0; k < 4; ++k) {
+            if (strlen(storageNames[k]) == len && strncmp(arg, storageNames[k], len) == 0) {
+                storages[storageCount++] = (DimStorage)k;
+                found = true;
+            }
+        }
+        if (!found) { return false; }
+        arg += arg[len] == ',' ? len+1 : len;
+    }
+    return storageCount > 0;
+}
+
+//largest deviations of a reduced storage from float32 over some generations from the same state, the timed world
+//being in-place with the storage
+void measureAccuracy(Dimension *dim, double *max, double *mean) {
+    Dimension *ref = CreateDimension(dim->MATRIXWIDTH, dim->MATRIXHEIGHT, 1, dim->KERNELRAD, dim->DT, dim->RDMDENSITY,
+        dim->a, dim->b, dim->c, dim->d, dim->noisefactor, dim->patchsize);
+    Dimension *low = CreateInPlaceDimension(dim->MATRIXWIDTH, dim->MATRIXHEIGHT, dim->KERNELRAD, dim->DT, dim->RDMDENSITY,
+        dim->a, dim->b, dim->c, dim->d, dim->noisefactor, dim->patchsize, getStateStorage(dim));
+    float *a = malloc(dim->MATRIXWIDTH*sizeof(float)), *b = malloc(dim->MATRIXWIDTH*sizeof(float));
+    *max = *mean = -1.;
+    if (ref != NULL && low != NULL && a != NULL && b != NULL) {
+        //same rules as the timed world
+        Dimension *worlds[] = { ref, low };
+        for (int k = 0; k < 2; ++k) {
+            setGrowthFunction(worlds[k], growthFunction, growthSkew);
+            setKernelFunction(worlds[k], kernelFunction);
+            if (shellCount > 0) { setKernelShells(worlds[k], shellCount, shellPeaks); }
+        }
+        copyDimensionState(ref, dim);
+        copyDimensionState(low, dim);
+        setDimensionThreads(ref, dim->threads);
+        setDimensionThreads(low, dim->threads);
+        //worst generation, a random world may well have died out by the last one
+        *max = *mean = 0.;
+        for (int g = 0; g < accuracyGenerations; ++g) {
+            doStep(ref);
+            doStep(low);
+            double sum = 0.;
+            for (int j = 0; j < ref->MATRIXHEIGHT; ++j) {
+                getStateRow(ref, j, a);
+                getStateRow(low, j, b);
+                for (int i = 0; i < ref->MATRIXWIDTH; ++i) {
+                    double dev = fabs((double)a[i] - (double)b[i]);
+                    if (dev > *max) { *max = dev; }
+                    sum += dev;
+                }
+            }
+            if (sum/getMatrixLength(ref) > *mean) { *mean = sum/getMatrixLength(ref); }
+        }
+    }
+    DestroyDimension(ref);
+    DestroyDimension(low);
+    free(a);
+    free(b);
+}
+
+//taps of the (2r+1)^2 neighbourhood read for each cell by doStep
+double tapsPerCell(int radius) {
+    return (double)(2*radius+1)*(2*radius+1);
+}
+
+//writes the counters of a run and the metrics derived from them, null when unavailable
+void writeCounters(PerfCounters *pc, double updates, double elapsed) {
+    #define COUNTER(k) (pc->available[k] ? pc->value[k] : -1.)
+    double cycles = COUNTER(PC_CYCLES), instructions = COUNTER(PC_INSTRUCTIONS), misses = COUNTER(PC_LLC_MISSES);
+    double flops = getFlops(pc);
+    #undef COUNTER
+    //dram traffic estimated as one cache line per last level miss
+    double bytes = misses >= 0 ? misses*64. : -1.;
+
+    double metrics[] = {
+        cycles, instructions, misses, flops,
+        cycles > 0 && instructions >= 0 ? instructions/cycles : -1.,
+        bytes >= 0 ? bytes/updates : -1.,
+        bytes >= 0 ? bytes/elapsed*1e-9 : -1.,
+        bytes >= 0 && bandwidth > 0 ? bytes/elapsed/bandwidth : -1.,
+        flops >= 0 ? flops/updates : -1.,
+        flops >= 0 ? flops/elapsed*1e-9 : -1.,
+        flops >= 0 && bytes > 0 ? flops/bytes : -1.
+    };
+    const char *names[] = {
+        "cycles", "instructions", "llc_misses", "flops",
+        "ipc", "bytes_per_cell_update", "dram_gbs", "bandwidth_fraction",
+        "flops_per_cell_update", "gflops", "arithmetic_intensity"
+    };
+    fprintf(out, ", \"counters\": {");
+    for (int k = 0; k < (int)(sizeof(metrics)/sizeof(metrics[0])); ++k) {
+        if (metrics[k] < 0) {
+            fprintf(out, "%s\"%s\": null", k ? ", " : "", names[k]);
+        } else {
+            fprintf(out, "%s\"%s\": %.6g", k ? ", " : "", names[k], metrics[k]);
+        }
+    }
+    fprintf(out, "}");
+}
+
+//times doStep on a workload and appends its JSON record, returns 0 if a record was written
+int runWorkload(Workload *wl, int t, bool first) {
+    int threads = threadCounts[t];
+    double cells = (double)wl->size*wl->size*(volume ? wl->size : 1);
+    double work = cells*tapsPerCell(wl->radius)*(volume ? 2*wl->radius+1 : 1)*(channels > 0 ? channelKernels : 1);
+    if (tapRate[t] > 0 && work/tapRate[t] > maxStepTime) {
+        fprintf(stderr, "Skipping %s %dx%d r=%d on %d threads : about %.0fs per step\n",
+            wl->name, wl->size, wl->size, wl->radius, threads, work/tapRate[t]);
+        return 1;
+    }
+
+    //the pinned workers start with the world, before its buffers are allocated
+    setDefaultAffinity(affinity, threads);
+    Dimension *dim = volume
+        ? CreateVolumeDimension(wl->size, wl->size, wl->size, wl->radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, wl->radius)
+        : inPlace
+        ? CreateInPlaceDimension(wl->size, wl->size, wl->radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, wl->radius, DIM_STORAGE_FLOAT32)
+        : CreateDimension(wl->size, wl->size, 1, wl->radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, wl->radius);
+    if (dim == NULL) { return 1; }
+    //before the channel kernels, they are made with the kernel function of the world
+    if (setGrowthFunction(dim, growthFunction, growthSkew) != 0 || setKernelFunction(dim, kernelFunction) != 0) {
+        DestroyDimension(dim);
+        return 1;
+    }
+    if (channels > 0) {
+        if (setDimensionChannels(dim, channels) != 0) {
+            DestroyDimension(dim);
+            return 1;
+        }
+        //each channel grown by about as many kernels, their weights summing to one
+        for (int k = 0; k < channelKernels; ++k) {
+            int radius = k % 3 == 0 ? wl->radius : k % 3 == 1 ? 2*wl->radius/3 : wl->radius/2;
+            addChannelKernel(dim, k % channels, (k/channels + k) % channels, radius < 2 ? 2 : radius,
+                (float)channels/channelKernels, dim->a, dim->b + .02f*(k % 3), dim->c, dim->d);
+            if (shellCount > 0) { setChannelKernelShells(dim, k, shellCount, shellPeaks); }
+        }
+    } else if (shellCount > 0 && setKernelShells(dim, shellCount, shellPeaks) != 0) {
+        DestroyDimension(dim);
+        return 1;
+    }
+    if (wl->blob != NULL) {
+        if (loadDimensionBlob(dim, wl->blob) != 0) {
+            DestroyDimension(dim);
+            return 1;
+        }
+    } else {
+        setDimensionSeed(dim, seed);
+        randomizeDimensionByKernel(dim);
+    }
+    setStateStorage(dim, wl->storage);
+    setStateLayout(dim, layout);
+
+    //the accuracy run is made first, from the very same state as the timed run
+    double devMax = -1., devMean = -1.;
+    if (wl->storage != DIM_STORAGE_FLOAT32 && accuracyGenerations > 0 && channels == 0) { measureAccuracy(dim, &devMax, &devMean); }
+
+    //counters are opened before the workers start so that they inherit them
+    PerfCounters pc;
+    bool counting = useCounters && openPerfCounters(&pc);
+    setDimensionAffinity(dim, affinity);
+    setDimensionThreads(dim, threads);
+    int usedThreads = getDimensionThreads(dim);
+
+    if (noise >= 0) {
+        setNoise(dim, (DimNoise)noise, noiseLength);
+        setStepNoise(dim, 1);
+    }
+
+    //one untimed step to fault in pages, start the workers and build the jit code
+    setDimensionEngine(dim, engine);
+    doSteps(dim, depth);
+    double jitTime = getPhaseTime(dim, DIM_PHASE_JIT);
+    DimEngine stepEngine = volume ? DIM_ENGINE_FFT : getStepEngine(dim);
+    double predicted = engine == DIM_ENGINE_AUTO ? predictStepTime(dim, stepEngine) : -1.;
+    resetPhaseTimes(dim);
+
+    int steps = 0;
+    if (counting) { startPerfCounters(&pc); }
+    double start = dimClock(), elapsed = 0.;
+    while (elapsed < minTime) {
+        doSteps(dim, depth);
+        steps += depth;
+        elapsed = dimClock() - start;
+    }
+    if (counting) {
+        stopPerfCounters(&pc);
+        //joining the workers folds their counts into ours
+        setDimensionThreads(dim, 1);
+        readPerfCounters(&pc);
+        closePerfCounters(&pc);
+    }
+
+    double rate = work*steps/elapsed;
+    if (rate > tapRate[t]) { tapRate[t] = rate; }
+
+    fprintf(out, "%s\n    {\"workload\": \"%s\", \"engine\": \"%s\", \"in_place\": %s, \"storage\": \"%s\", \"layout\": \"%s\", \"huge_pages\": \"%s\", \"affinity\": \"%s\", \"width\": %d, \"height\": %d, \"radius\": %d, \"threads\": %d, "
+        "\"steps\": %d, \"seconds\": %.6f, \"steps_per_second\": %.4f, \"cell_updates_per_second\": %.1f, "
+        "\"convolution_s\": %.6f, \"growth_s\": %.6f, \"swap_s\": %.6f",
+        first ? "" : ",", wl->name, getEngineName(stepEngine), inPlace ? "true" : "false", storageNames[wl->storage], layoutNames[layout], hugePageNames[getHugePages()], affinityNames[affinity], wl->size, wl->size, wl->radius, usedThreads,
+        steps, elapsed, steps/elapsed, cells*steps/elapsed,
+        getPhaseTime(dim, DIM_PHASE_CONVOLUTION), getPhaseTime(dim, DIM_PHASE_GROWTH), getPhaseTime(dim, DIM_PHASE_SWAP));
+    if (volume) { fprintf(out, ", \"slices\": %d", getMatrixDepth(dim)); }
+    if (depth > 1) { fprintf(out, ", \"depth\": %d, \"blocked_s\": %.6f", depth, getPhaseTime(dim, DIM_PHASE_BLOCKED)); }
+    if (engine == DIM_ENGINE_JIT) { fprintf(out, ", \"jit_build_s\": %.6f", jitTime); }
+    if (engine == DIM_ENGINE_AUTO) { fprintf(out, ", \"auto\": true, \"predicted_step_s\": %.6f", predicted); }
+    if (channels > 0) { fprintf(out, ", \"channels\": %d, \"kernels\": %d", channels, channelKernels); }
+    if (growthFunction != DIM_GROWTH_GAUSSIAN) { fprintf(out, ", \"growth\": \"%s\"", getGrowthFunctionName(growthFunction)); }
+    if (growthFunction == DIM_GROWTH_ASYMMETRIC) { fprintf(out, ", \"skew\": %g", growthSkew); }
+    if (kernelFunction != DIM_KERNEL_EXPONENTIAL) { fprintf(out, ", \"kernel\": \"%s\"", getKernelFunctionName(kernelFunction)); }
+    if (shellCount > 0) {
+        fprintf(out, ", \"shells\": [");
+        for (int k = 0; k < shellCount; ++k) { fprintf(out, "%s%g", k ? ", " : "", shellPeaks[k]); }
+        fprintf(out, "]");
+    }
+    if (noise >= 0) { fprintf(out, ", \"noise\": \"%s\", \"noise_length\": %g, \"noise_s\": %.6f", noiseNames[noise], noiseLength, getPhaseTime(dim, DIM_PHASE_NOISE)); }
+    if (devMax >= 0) {
+        fprintf(out, ", \"accuracy\": {\"generations\": %d, \"max_abs_dev\": %.6g, \"mean_abs_dev\": %.6g}",
+            accuracyGenerations, devMax, devMean);
+    }
+    if (counting) {
+        writeCounters(&pc, cells*steps, elapsed);
+    } else if (useCounters) {
+        fprintf(out, ", \"counters\": null");
+    }
+    fprintf(out, "}");
+    fflush(out);
+
+    DestroyDimension(dim);
+    return 0;
+}
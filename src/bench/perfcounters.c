@@ -0,0 +1,163 @@
+#include "perfcounters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dimensions.h>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+//triad arrays, large enough to spill any last level cache
+#define TRIADLENGTH (32L<<20)
+#define TRIADREPEAT 4
+
+#if defined(__linux__)
+int openCounter(unsigned int type, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+//the FP_ARITH events are only meaningful on intel cores
+bool isIntel() {
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (fp == NULL) { return false; }
+    char line[256];
+    bool intel = false;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, "vendor_id", 9) == 0) {
+            intel = strstr(line, "GenuineIntel") != NULL;
+            break;
+        }
+    }
+    fclose(fp);
+    return intel;
+}
+#endif
+
+bool openPerfCounters(PerfCounters *pc) {
+    bool any = false;
+    for (int k = 0; k < PC_COUNT; ++k) {
+        pc->fd[k] = -1;
+        pc->available[k] = false;
+        pc->value[k] = 0.;
+    }
+#if defined(__linux__)
+    pc->fd[PC_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    pc->fd[PC_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    pc->fd[PC_LLC_MISSES] = openCounter(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    if (pc->fd[PC_LLC_MISSES] < 0) { pc->fd[PC_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES); }
+    if (isIntel()) {
+        pc->fd[PC_FP_SCALAR] = openCounter(PERF_TYPE_RAW, 0x02c7);
+        pc->fd[PC_FP_PACKED128] = openCounter(PERF_TYPE_RAW, 0x08c7);
+        pc->fd[PC_FP_PACKED256] = openCounter(PERF_TYPE_RAW, 0x20c7);
+    }
+    for (int k = 0; k < PC_COUNT; ++k) {
+        pc->available[k] = pc->fd[k] >= 0;
+        any = any || pc->available[k];
+    }
+#endif
+    return any;
+}
+
+void startPerfCounters(PerfCounters *pc) {
+#if defined(__linux__)
+    for (int k = 0; k < PC_COUNT; ++k) {
+        if (pc->fd[k] < 0) { continue; }
+        ioctl(pc->fd[k], PERF_EVENT_IOC_RESET, 0);
+        ioctl(pc->fd[k], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void stopPerfCounters(PerfCounters *pc) {
+#if defined(__linux__)
+    for (int k = 0; k < PC_COUNT; ++k) {
+        if (pc->fd[k] >= 0) { ioctl(pc->fd[k], PERF_EVENT_IOC_DISABLE, 0); }
+    }
+#endif
+}
+
+//reads the counters, scaling them up when the kernel had to multiplex them
+void readPerfCounters(PerfCounters *pc) {
+#if defined(__linux__)
+    for (int k = 0; k < PC_COUNT; ++k) {
+        unsigned long long v[3];
+        if (pc->fd[k] < 0 || read(pc->fd[k], v, sizeof(v)) != sizeof(v) || v[2] == 0) {
+            pc->available[k] = false;
+            continue;
+        }
+        pc->value[k] = (double)v[0]*((double)v[1]/(double)v[2]);
+    }
+#endif
+}
+
+void closePerfCounters(PerfCounters *pc) {
+#if defined(__linux__)
+    for (int k = 0; k < PC_COUNT; ++k) {
+        if (pc->fd[k] >= 0) { close(pc->fd[k]); }
+        pc->fd[k] = -1;
+    }
+#endif
+}
+
+//single precision operations, a packed instruction counting for each of its lanes
+double getFlops(PerfCounters *pc) {
+    if (!pc->available[PC_FP_SCALAR] || !pc->available[PC_FP_PACKED128] || !pc->available[PC_FP_PACKED256]) { return -1.; }
+    return pc->value[PC_FP_SCALAR] + 4.*pc->value[PC_FP_PACKED128] + 8.*pc->value[PC_FP_PACKED256];
+}
+
+typedef struct TriadArgs {
+    float *a, *b, *c;
+    long start, end;
+} TriadArgs;
+
+void *triad(void *arg) {
+    TriadArgs *t = arg;
+    for (int r = 0; r < TRIADREPEAT; ++r) {
+        for (long k = t->start; k < t->end; ++k) { t->a[k] = t->b[k] + 3.f*t->c[k]; }
+    }
+    return NULL;
+}
+
+//STREAM-like triad a = b + s*c split over threads, counting 3 streamed floats per element
+double measureBandwidth(int threads) {
+    float *a = malloc(TRIADLENGTH*sizeof(float));
+    float *b = malloc(TRIADLENGTH*sizeof(float));
+    float *c = malloc(TRIADLENGTH*sizeof(float));
+    pthread_t *ids = malloc(threads*sizeof(pthread_t));
+    TriadArgs *args = malloc(threads*sizeof(TriadArgs));
+    double bandwidth = -1.;
+    if (a == NULL || b == NULL || c == NULL || ids == NULL || args == NULL) { goto cleanup; }
+    for (long k = 0; k < TRIADLENGTH; ++k) { a[k] = 0.f; b[k] = 1.f; c[k] = 2.f; }
+
+    double start = dimClock();
+    for (int t = 0; t < threads; ++t) {
+        args[t] = (TriadArgs){ a, b, c, TRIADLENGTH*t/threads, TRIADLENGTH*(t+1)/threads };
+        pthread_create(&ids[t], NULL, triad, &args[t]);
+    }
+    for (int t = 0; t < threads; ++t) { pthread_join(ids[t], NULL); }
+    double elapsed = dimClock() - start;
+    bandwidth = 3.*sizeof(float)*TRIADLENGTH*TRIADREPEAT/elapsed;
+
+cleanup:
+    free(a);
+    free(b);
+    free(c);
+    free(ids);
+    free(args);
+    return bandwidth;
+}
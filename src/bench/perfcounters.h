@@ -0,0 +1,35 @@
+#ifndef __perfcounters_h_
+#define __perfcounters_h_
+
+#include <stdbool.h>
+
+//hardware counters read around the timed steps, linux only (perf_event_open)
+typedef enum PerfCounter {
+    PC_CYCLES,
+    PC_INSTRUCTIONS,
+    PC_LLC_MISSES,
+    PC_FP_SCALAR,    //intel FP_ARITH_INST_RETIRED, single precision
+    PC_FP_PACKED128,
+    PC_FP_PACKED256,
+    PC_COUNT
+} PerfCounter;
+
+typedef struct PerfCounters {
+    int fd[PC_COUNT];
+    bool available[PC_COUNT];
+    double value[PC_COUNT];
+} PerfCounters;
+
+//counters are inherited by threads created after opening them, their counts only
+//reach the parent once those threads have exited
+bool openPerfCounters(PerfCounters *pc);
+void startPerfCounters(PerfCounters *pc);
+void stopPerfCounters(PerfCounters *pc);
+void readPerfCounters(PerfCounters *pc);
+void closePerfCounters(PerfCounters *pc);
+double getFlops(PerfCounters *pc);
+
+//triad bandwidth of the machine in bytes per second
+double measureBandwidth(int threads);
+
+#endif //__perfcounters_h_
@@ -0,0 +1,214 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdint.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+//most numa nodes read from sysfs
+#define DIM_MAX_NODES 64
+//mbind policy and flag, numaif.h being part of libnuma
+#define DIM_MPOL_PREFERRED 1
+#define DIM_MPOL_MF_MOVE (1 << 1)
+
+//planes of rows being zeroed by the workers owning each band
+typedef struct DimTouch {
+    char *base;
+    int planes;
+    size_t rowBytes;
+    size_t planeBytes;
+} DimTouch;
+
+//policy and threads of the worlds created from now on
+static DimAffinity defaultAffinity = DIM_AFFINITY_NONE;
+static int defaultThreads = 0;
+
+void placeTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void touchTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+
+#if defined(__linux__)
+
+//cpus the process may run on, ordered for the policy : compact fills a node before the next, scatter deals them out across nodes
+//returns how many were written to cpus
+int listCpus(DimAffinity policy, int *cpus, int max) {
+    cpu_set_t allowed;
+    if (policy == DIM_AFFINITY_NONE || sched_getaffinity(0, sizeof(allowed), &allowed) != 0) { return 0; }
+    //node and rank in the node of every allowed cpu, -1 for the others
+    int node[CPU_SETSIZE], rank[CPU_SETSIZE], nodeSize[DIM_MAX_NODES+1] = { 0 }, nodes = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) { node[cpu] = -1; }
+    for (int n = 0; n < DIM_MAX_NODES; ++n) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) { continue; }
+        //ranges like 0-3,8-11
+        int lo, hi, c;
+        while (fscanf(fp, "%d", &lo) == 1) {
+            hi = lo;
+            if ((c = fgetc(fp)) == '-') {
+                if (fscanf(fp, "%d", &hi) != 1) { break; }
+                c = fgetc(fp);
+            }
+            for (int cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; ++cpu) {
+                if (!CPU_ISSET(cpu, &allowed) || node[cpu] >= 0) { continue; }
+                node[cpu] = nodes;
+                rank[cpu] = nodeSize[nodes]++;
+            }
+            if (c != ',') { break; }
+        }
+        fclose(fp);
+        if (nodeSize[nodes] > 0) { ++nodes; }
+    }
+    //no topology, or cpus outside of every node : one more node for the leftovers
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed) || node[cpu] >= 0) { continue; }
+        node[cpu] = nodes;
+        rank[cpu] = nodeSize[nodes]++;
+    }
+    if (nodeSize[nodes] > 0) { ++nodes; }
+
+    int total = 0, rounds = policy == DIM_AFFINITY_SCATTER ? CPU_SETSIZE : 1;
+    for (int k = 0; k < rounds && total < max; ++k) {
+        int added = 0;
+        for (int n = 0; n < nodes; ++n) {
+            for (int cpu = 0; cpu < CPU_SETSIZE && total < max; ++cpu) {
+                if (node[cpu] != n || (policy == DIM_AFFINITY_SCATTER && rank[cpu] != k)) { continue; }
+                cpus[total++] = cpu;
+                ++added;
+            }
+        }
+        if (added == 0) { break; }
+    }
+    return total;
+}
+
+//pins the calling thread to cpu
+void pinThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) { fprintf(stderr, "Failed to pin a worker to cpu %d\n", cpu); }
+}
+
+//moves the pages of [p, p+bytes) to the numa node of the calling thread, in place, the pages shared with the
+//neighbouring range going to whichever worker comes last
+//nothing happens without numa support or when the pages can't move, they are then left where they are
+void placeRange(const void *p, size_t bytes) {
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+    unsigned int cpu, node;
+    if (p == NULL || bytes == 0 || syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= DIM_MAX_NODES) { return; }
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)p & ~(page-1), end = ((uintptr_t)p + bytes + page-1) & ~(page-1);
+    unsigned long long mask = 1ull << node;
+    syscall(SYS_mbind, start, end-start, DIM_MPOL_PREFERRED, &mask, DIM_MAX_NODES+1, DIM_MPOL_MF_MOVE);
+#endif
+}
+
+#else
+
+int listCpus(DimAffinity policy, int *cpus, int max) {
+    return 0;
+}
+
+void pinThread(int cpu) {}
+
+void placeRange(const void *p, size_t bytes) {}
+
+#endif
+
+//moves the rows of the band to the node of the worker stepping them, every plane of the world
+void placeTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    size_t w = dim->MATRIXWIDTH, from = (size_t)y0*w, n = (size_t)(y1-y0)*w;
+    if (dim->matrix != NULL) { placeRange(dim->matrix + from, n*sizeof(Cell)); }
+    if (dim->matrixInit != NULL) { placeRange(dim->matrixInit + from, n*sizeof(Cell)); }
+    if (dim->sums != NULL) { placeRange(dim->sums + from, n*sizeof(float)); }
+    DimChannels *ch = dim->channels;
+    for (int c = 1; ch != NULL && ch->planes != NULL && c < ch->count; ++c) {
+        size_t plane = (size_t)(c-1)*w*dim->MATRIXHEIGHT;
+        placeRange(ch->planes + plane + from, n*sizeof(float));
+        placeRange(ch->next + plane + from, n*sizeof(float));
+    }
+    if (dim->plane == NULL) { return; }
+    //runs following each other in the plane are moved at once
+    size_t cell = storageSize(dim->storage), start = 0, end = 0;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = 0, run; x < dim->MATRIXWIDTH; x += run) {
+            run = planeRun(dim, x);
+            size_t k = planeIndex(dim, x, y)*cell;
+            if (k != end) {
+                placeRange((const char *)dim->plane + start, end-start);
+                start = k;
+            }
+            end = k + run*cell;
+        }
+    }
+    placeRange((const char *)dim->plane + start, end-start);
+}
+
+//moves the pages of the world, in place, to the nodes of the workers that step each band
+//done whenever the pool restarts with a pinning policy, the buffers keep their addresses
+//the per worker scratch of the in-place and volume steps is dropped, the next step allocates it again and each
+//worker first touches its own part
+void placeDimension(Dimension *dim) {
+    if (dim->affinity == DIM_AFFINITY_NONE || dim->pool == NULL) { return; }
+    if (dim->volume != NULL) {
+        placeVolume(dim);
+        return;
+    }
+    parallelRows(dim, "place", placeTask, NULL);
+    dimFree(dim->halo);
+    dim->halo = NULL;
+}
+
+//zeroes the rows of the band in every plane
+void touchTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimTouch *t = ctx;
+    for (int p = 0; p < t->planes; ++p) { memset(t->base + p*t->planeBytes + y0*t->rowBytes, 0, (y1-y0)*t->rowBytes); }
+}
+
+//zeroed buffer of planes x rows x rowBytes, the rows [y0, y1) of every plane being zeroed, hence first touched, by
+//the worker that steps them, rows splitting between the workers as parallelRange(dim, ..., 0, rows) splits them
+//to free with dimFree
+void *placedCalloc(Dimension *dim, int planes, int rows, size_t rowBytes) {
+    if (rowBytes != 0 && (size_t)planes*rows > SIZE_MAX/rowBytes) { return NULL; }
+    DimTouch t = { dimAlloc((size_t)planes*rows*rowBytes), planes, rowBytes, (size_t)rows*rowBytes };
+    if (t.base != NULL) { parallelRange(dim, "touch", touchTask, &t, 0, rows); }
+    return t.base;
+}
+
+//pins the workers of the worlds created afterwards before their buffers are allocated, each worker then first touches
+//the band it steps, threads counting as for setDimensionThreads, ignored without a policy
+DIMAPI void setDefaultAffinity(DimAffinity policy, int threads) {
+    defaultAffinity = policy;
+    defaultThreads = threads;
+}
+
+DIMAPI DimAffinity getDefaultAffinity(void) {
+    return defaultAffinity;
+}
+
+//starts the pool of a world being created under the default policy, before any of its buffers exists
+void startPlacedPool(Dimension *dim) {
+    if (defaultAffinity == DIM_AFFINITY_NONE) { return; }
+    dim->affinity = defaultAffinity;
+    setDimensionThreads(dim, defaultThreads);
+}
+
+//pins the workers of dim, which then step every band, and moves the pages of the world to their nodes
+DIMAPI void setDimensionAffinity(Dimension *dim, DimAffinity policy) {
+    if (policy == dim->affinity) { return; }
+    dim->affinity = policy;
+    setDimensionThreads(dim, dim->threads);
+}
+
+DIMAPI DimAffinity getDimensionAffinity(Dimension *dim) {
+    return dim->affinity;
+}
@@ -0,0 +1,122 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+//header in front of every buffer, a whole cache line so that the buffer keeps the alignment
+typedef struct DimBlock {
+    size_t size;   //bytes asked for
+    size_t mapped; //bytes of the mapping, 0 for a heap buffer
+    void *base;    //start of the mapping or of the heap allocation
+} DimBlock;
+
+static DimHugePages hugePages = DIM_HUGE_PAGES_AUTO;
+
+void *mapBlock(size_t bytes, size_t *mapped);
+
+#if defined(_WIN32)
+
+//large pages need a privilege on windows, every buffer comes from the heap
+void *mapBlock(size_t bytes, size_t *mapped) {
+    return NULL;
+}
+
+static void *heapBlock(size_t bytes) {
+    return _aligned_malloc(bytes, DIM_ALIGN);
+}
+
+static void freeBlock(DimBlock *block) {
+    _aligned_free(block->base);
+}
+
+#else
+
+//maps large buffers, explicit huge pages first when asked or reserved, else small pages the kernel may merge
+//returns NULL when the buffer is better left to the heap
+void *mapBlock(size_t bytes, size_t *mapped) {
+    if (hugePages == DIM_HUGE_PAGES_NONE || bytes < DIM_HUGE_PAGE) { return NULL; }
+    size_t length = (bytes + DIM_HUGE_PAGE-1)/DIM_HUGE_PAGE*DIM_HUGE_PAGE;
+    void *base = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (hugePages != DIM_HUGE_PAGES_TRANSPARENT) {
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (base == MAP_FAILED) {
+        if (hugePages == DIM_HUGE_PAGES_EXPLICIT) {
+            fprintf(stderr, "No explicit huge page left for %zu bytes, falling back to transparent ones\n", bytes);
+        }
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) { return NULL; }
+#if defined(MADV_HUGEPAGE)
+        madvise(base, length, MADV_HUGEPAGE);
+#endif
+    }
+    *mapped = length;
+    return base;
+}
+
+static void *heapBlock(size_t bytes) {
+    void *base = NULL;
+    return posix_memalign(&base, DIM_ALIGN, bytes) == 0 ? base : NULL;
+}
+
+static void freeBlock(DimBlock *block) {
+    if (block->mapped > 0) {
+        munmap(block->base, block->mapped);
+    } else {
+        free(block->base);
+    }
+}
+
+#endif
+
+//DIM_ALIGN aligned buffer of size bytes, the large ones on huge pages when the policy allows it
+//to free with dimFree only
+void *dimAlloc(size_t size) {
+    size_t bytes = size + DIM_ALIGN, mapped = 0;
+    if (bytes < size) { return NULL; }
+    void *base = mapBlock(bytes, &mapped);
+    if (base == NULL) { base = heapBlock(bytes); }
+    if (base == NULL) { return NULL; }
+    DimBlock *block = (DimBlock *)((char *)base + DIM_ALIGN - sizeof(DimBlock));
+    *block = (DimBlock){ size, mapped, base };
+    return (char *)base + DIM_ALIGN;
+}
+
+void *dimCalloc(size_t n, size_t size) {
+    if (size != 0 && n > SIZE_MAX/size) { return NULL; }
+    void *p = dimAlloc(n*size);
+    //fresh mappings are already zero, writing them would fault every page in from this thread
+    if (p != NULL && ((DimBlock *)p - 1)->mapped == 0) { memset(p, 0, n*size); }
+    return p;
+}
+
+void *dimRealloc(void *p, size_t size) {
+    if (p == NULL) { return dimAlloc(size); }
+    size_t old = ((DimBlock *)p - 1)->size;
+    if (size <= old) { return p; }
+    void *q = dimAlloc(size);
+    if (q == NULL) { return NULL; }
+    memcpy(q, p, old);
+    dimFree(p);
+    return q;
+}
+
+void dimFree(void *p) {
+    if (p == NULL) { return; }
+    DimBlock block = *((DimBlock *)p - 1);
+    freeBlock(&block);
+}
+
+//applies to the buffers allocated afterwards
+DIMAPI void setHugePages(DimHugePages mode) {
+    hugePages = mode;
+}
+
+DIMAPI DimHugePages getHugePages(void) {
+    return hugePages;
+}
@@ -0,0 +1,152 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//bytes of the two planes of a tile when its height is left to doSteps
+#define DIM_TILE_BUDGET (4<<20)
+
+//a doSteps call : generations per pass, tile height and the row convolution to use
+typedef struct DimBlocking {
+    int n;
+    int tile;
+    DimConvRow convRow;
+} DimBlocking;
+
+int tileRowsFor(Dimension *dim, int n);
+int prepareTiles(Dimension *dim, int n, int tile);
+void blockingTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void blockingSwapTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+
+//tile height for n generations, the largest fitting the budget but never under twice the 2nR rows of halo
+int tileRowsFor(Dimension *dim, int n) {
+    if (dim->tileRows > 0) { return dim->tileRows; }
+    int halo = n*dim->KERNELRAD;
+    size_t rowBytes = 2*(size_t)(dim->MATRIXWIDTH+2*dim->KERNELRAD)*sizeof(float);
+    int rows = (int)(DIM_TILE_BUDGET/rowBytes) - 2*halo;
+    //shorter tiles would spend more than a quarter of their work on the halo
+    return rows > 4*halo ? rows : 4*halo;
+}
+
+//two planes of tile+2nR haloed rows and a row of sums per worker, prepareScratch must have succeeded
+int prepareTiles(Dimension *dim, int n, int tile) {
+    int r = dim->KERNELRAD;
+    size_t need = 2*(size_t)(tile+2*n*r)*(dim->MATRIXWIDTH+2*r) + dim->MATRIXWIDTH;
+    for (int k = 0; k < dim->threads; ++k) {
+        DimScratch *s = &dim->scratch[k];
+        if (s->tileCapacity >= need) { continue; }
+        dimFree(s->tile);
+        s->tile = dimAlloc(need*sizeof(float));
+        s->tileCapacity = s->tile != NULL ? need : 0;
+        if (s->tile == NULL) { return 1; }
+    }
+    return 0;
+}
+
+//advances the rows [y0, y1) by n generations, tile by tile, leaving the result in dim->sums
+//the cells are only written by the swap, other workers still read their state for the halos
+//each tile loads nR more rows on both sides and the valid part shrinks by R per generation
+void blockingTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimBlocking *b = ctx;
+    int r = dim->KERNELRAD, w = dim->MATRIXWIDTH, stride = w+2*r, halo = b->n*r;
+    DimScratch *s = &dim->scratch[worker];
+
+    for (int t0 = y0; t0 < y1; t0 += b->tile) {
+        int t1 = t0+b->tile < y1 ? t0+b->tile : y1;
+        int rows = t1-t0+2*halo;
+        //row k of a plane is the grid row t0-halo+k
+        float *src = s->tile, *dst = s->tile + (size_t)rows*stride, *sums = dst + (size_t)rows*stride;
+        for (int k = 0; k < rows; ++k) { loadRow(dim, t0-halo+k, src + (size_t)k*stride); }
+
+        for (int g = 1; g <= b->n; ++g) {
+            for (int k = g*r; k < rows-g*r; ++k) {
+                for (int j = 0; j < 2*r+1; ++j) { s->rows[j] = src + (size_t)(k-r+j)*stride; }
+                b->convRow(dim, s->rows, sums);
+                float *out = dst + (size_t)k*stride;
+                //like doStep the first generation grows from the cells' state, which may differ from oldState
+                if (g == 1) {
+                    int y = ((t0-halo+k) % dim->MATRIXHEIGHT + dim->MATRIXHEIGHT) % dim->MATRIXHEIGHT;
+                    const Cell *cells = &dim->matrix[(size_t)y*w];
+                    for (int i = 0; i < w; ++i) { out[r+i] = cells[i].state; }
+                } else {
+                    memcpy(out+r, src + (size_t)k*stride + r, w*sizeof(float));
+                }
+                growthPlane(dim, sums, out+r, w);
+                //rounded as the swap of doStep would
+                if (dim->storage != DIM_STORAGE_FLOAT32) {
+                    for (int i = 0; i < w; ++i) { out[r+i] = quantizeState(dim->storage, out[r+i]); }
+                }
+                for (int i = 0; i < r; ++i) {
+                    out[i] = out[r + ((i - r) % w + w) % w];
+                    out[r + w + i] = out[r + i % w];
+                }
+            }
+            float *swap = src;
+            src = dst;
+            dst = swap;
+        }
+
+        for (int y = t0; y < t1; ++y) {
+            memcpy(&dim->sums[(size_t)y*w], src + (size_t)(y-t0+halo)*stride + r, w*sizeof(float));
+        }
+    }
+}
+
+void blockingSwapTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    for (int y = y0; y < y1; ++y) {
+        Cell *cells = &dim->matrix[(size_t)y*dim->MATRIXWIDTH];
+        const float *states = &dim->sums[(size_t)y*dim->MATRIXWIDTH];
+        for (int i = 0; i < dim->MATRIXWIDTH; ++i) { cells[i].state = states[i]; }
+        swapRow(dim, y);
+    }
+}
+
+//whether doSteps steps several generations per pass over dim, with the engine it has now
+//noise between the generations would have to be drawn inside the tiles, the fft engine and the channels step whole planes
+int canBlock(Dimension *dim) {
+    return dim->stepNoise <= 0 && dim->engine != DIM_ENGINE_REFERENCE && dim->engine != DIM_ENGINE_FFT && !dim->inPlace
+        && dim->channels == NULL && dim->volume == NULL;
+}
+
+//same result as n calls to doStep, but each tile is stepped n times while it is in cache
+//with a block depth set, in passes of at most that many generations
+DIMAPI void doSteps(Dimension *dim, int n) {
+    if (n <= 0) { return; }
+    if (dim->blockDepth > 0 && n > dim->blockDepth) {
+        for (; n > 0; n -= dim->blockDepth) { doSteps(dim, n < dim->blockDepth ? n : dim->blockDepth); }
+        return;
+    }
+    chooseEngine(dim);
+    DimBlocking b = { n, tileRowsFor(dim, n), dim->convRow };
+    if (dim->engine == DIM_ENGINE_JIT && buildDimensionJIT(dim) == 0) {
+        DimGrowthRow growthRow = NULL;
+        getJITRows(dim, &b.convRow, &growthRow);
+    }
+    if (n == 1 || !canBlock(dim) || prepareScratch(dim) != 0 || prepareTiles(dim, n, b.tile) != 0) {
+        for (int k = 0; k < n; ++k) { doStep(dim); }
+        return;
+    }
+
+    double t = dimClock();
+    prepareGrowth(dim);
+    parallelRows(dim, "blocked", blockingTask, &b);
+    t = lapPhase(dim, DIM_PHASE_BLOCKED, t);
+    parallelRows(dim, "swap", blockingSwapTask, NULL);
+    lapPhase(dim, DIM_PHASE_SWAP, t);
+}
+
+DIMAPI void setTileRows(Dimension *dim, int rows) {
+    dim->tileRows = rows > 0 ? rows : 0;
+}
+
+DIMAPI int getTileRows(Dimension *dim) {
+    return dim->tileRows;
+}
+
+//generations per pass of doSteps, 0 for all those of the call in a single pass
+DIMAPI void setBlockDepth(Dimension *dim, int depth) {
+    dim->blockDepth = depth > 0 ? depth : 0;
+}
+
+DIMAPI int getBlockDepth(Dimension *dim) {
+    return dim->blockDepth;
+}
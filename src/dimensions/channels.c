@@ -0,0 +1,470 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+void freeGroups(DimChannels *ch);
+int prepareGroups(Dimension *dim);
+int prepareChannelScratch(Dimension *dim);
+void loadChannelHaloRow(Dimension *dim, int channel, int y, int r, float *dst);
+void convGroupRow(const DimKernelGroup *g, const float *ring, size_t stride, int y, float *sums, int w);
+void applyChannelRow(Dimension *dim, int y, const float *delta, size_t stride);
+void channelsTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void channelSumsTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void clearDeltaTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void applyTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void channelSwapTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+int stepChannelsFFT(Dimension *dim);
+
+//makes dim a world of count channels grown by the kernels of addChannelKernel instead of dim->kernel
+//channel 0 is the cells' state : the viewers, the exports, noisify and getStateRow see it, randomizeDimensionByKernel fills
+//every channel. 0 goes back to the single kernel world, a new count drops the kernels
+DIMAPI int setDimensionChannels(Dimension *dim, int count) {
+    if (count < 0) { return 1; }
+    if ((dim->inPlace || dim->volume != NULL) && count > 0) {
+        fprintf(stderr, "An in-place or volumetric world has a single channel\n");
+        return 1;
+    }
+    if (dim->channels != NULL && dim->channels->count == count) { return 0; }
+    freeChannels(dim);
+    if (count == 0) { return 0; }
+
+    DimChannels *ch = calloc(1, sizeof(DimChannels));
+    if (ch == NULL) { return 1; }
+    dim->channels = ch;
+    ch->count = count;
+    if (count > 1) {
+        //each band of every plane first touched by the worker stepping it
+        ch->planes = placedCalloc(dim, count-1, dim->MATRIXHEIGHT, (size_t)dim->MATRIXWIDTH*sizeof(float));
+        ch->next = placedCalloc(dim, count-1, dim->MATRIXHEIGHT, (size_t)dim->MATRIXWIDTH*sizeof(float));
+        if (ch->planes == NULL || ch->next == NULL) {
+            fprintf(stderr, "Failed to allocate %d channels of %dx%d\n", count, dim->MATRIXWIDTH, dim->MATRIXHEIGHT);
+            freeChannels(dim);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+DIMAPI int getDimensionChannels(Dimension *dim) {
+    return dim->channels != NULL ? dim->channels->count : 1;
+}
+
+//adds a kernel of the given radius whose sums u over channel source grow channel target by weight*g(u)*DT,
+//g being the growth function of the world with the parameters a, b, c and d, by default a*exp(-(u-b)^2/(2c^2))+d
+//returns its index, -1 if it can't be added
+DIMAPI int addChannelKernel(Dimension *dim, int source, int target, int radius, float weight, float a, float b, float c, float d) {
+    DimChannels *ch = dim->channels;
+    if (ch == NULL || source < 0 || source >= ch->count || target < 0 || target >= ch->count || radius < 2) {
+        fprintf(stderr, "No kernel of radius %d from channel %d to %d in a world of %d channels\n", radius, source, target, getDimensionChannels(dim));
+        return -1;
+    }
+    const float one = 1.f;
+    const DimCompiledKernel *shape = compileKernel(dim, radius, 1, &one);
+    DimChannelKernel *kernels = shape != NULL ? realloc(ch->kernels, (ch->kernelCount+1)*sizeof(DimChannelKernel)) : NULL;
+    if (kernels == NULL) { return -1; }
+    ch->kernels = kernels;
+    kernels[ch->kernelCount] = (DimChannelKernel){ source, target, radius, weight, a, b, c, d, shape };
+    freeGroups(ch);
+    return ch->kernelCount++;
+}
+
+//gives a kernel count concentric shells of the given peaks, 0 going back to the single bump
+//the taps of each shape are computed once per dimension, switching between presets only regroups the kernels
+DIMAPI int setChannelKernelShells(Dimension *dim, int kernel, int count, const float *peaks) {
+    DimChannels *ch = dim->channels;
+    if (ch == NULL || kernel < 0 || kernel >= ch->kernelCount) {
+        fprintf(stderr, "No channel kernel %d in this dimension\n", kernel);
+        return 1;
+    }
+    const float one = 1.f;
+    DimChannelKernel *k = &ch->kernels[kernel];
+    const DimCompiledKernel *shape = count > 0 ? compileKernel(dim, k->radius, count, peaks) : compileKernel(dim, k->radius, 1, &one);
+    if (shape == NULL) { return 1; }
+    k->shape = shape;
+    freeGroups(ch);
+    return 0;
+}
+
+//shapes of the kernels made again with the current kernel function, none is changed if one fails
+int recompileChannelKernels(Dimension *dim) {
+    DimChannels *ch = dim->channels;
+    if (ch == NULL) { return 0; }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int k = 0; k < ch->kernelCount; ++k) {
+            DimChannelKernel *kernel = &ch->kernels[k];
+            const DimCompiledKernel *shape = compileKernel(dim, kernel->radius, kernel->shape->shells, kernel->shape->peaks);
+            if (shape == NULL) { return 1; }
+            //the first pass only makes sure every shape can be made, the second finds them in the cache
+            if (pass == 1) { kernel->shape = shape; }
+        }
+    }
+    freeGroups(ch);
+    return 0;
+}
+
+DIMAPI void clearChannelKernels(Dimension *dim) {
+    DimChannels *ch = dim->channels;
+    if (ch == NULL) { return; }
+    free(ch->kernels);
+    ch->kernels = NULL;
+    ch->kernelCount = 0;
+    freeGroups(ch);
+}
+
+DIMAPI int getChannelKernelCount(Dimension *dim) {
+    return dim->channels != NULL ? dim->channels->kernelCount : 0;
+}
+
+//current states of row y of a channel
+DIMAPI void getChannelRow(Dimension *dim, int channel, int y, float *dst) {
+    if (channel == 0) {
+        getStateRow(dim, y, dst);
+        return;
+    }
+    if (channel < 0 || channel >= getDimensionChannels(dim)) { return; }
+    int w = dim->MATRIXWIDTH;
+    memcpy(dst, dim->channels->planes + ((size_t)(channel-1)*dim->MATRIXHEIGHT + y)*w, w*sizeof(float));
+}
+
+DIMAPI void setChannelRow(Dimension *dim, int channel, int y, const float *src) {
+    if (channel == 0) {
+        setStateRow(dim, y, src);
+        return;
+    }
+    if (channel < 0 || channel >= getDimensionChannels(dim)) { return; }
+    int w = dim->MATRIXWIDTH;
+    memcpy(dim->channels->planes + ((size_t)(channel-1)*dim->MATRIXHEIGHT + y)*w, src, w*sizeof(float));
+}
+
+//states of row y of a channel as the convolutions read them
+void loadChannelRow(Dimension *dim, int channel, int y, float *dst) {
+    if (channel == 0) {
+        decodeRow(dim, y, dst);
+        return;
+    }
+    int w = dim->MATRIXWIDTH;
+    memcpy(dst, dim->channels->planes + ((size_t)(channel-1)*dim->MATRIXHEIGHT + y)*w, w*sizeof(float));
+}
+
+//row y (wrapped) of a channel with r cells of toroidal halo on each side, as loadRow
+void loadChannelHaloRow(Dimension *dim, int channel, int y, int r, float *dst) {
+    int w = dim->MATRIXWIDTH;
+    y = ((y % dim->MATRIXHEIGHT) + dim->MATRIXHEIGHT) % dim->MATRIXHEIGHT;
+    loadChannelRow(dim, channel, y, dst + r);
+    for (int i = 0; i < r; ++i) {
+        dst[i] = dst[r + ((i - r) % w + w) % w];
+        dst[r + w + i] = dst[r + i % w];
+    }
+}
+
+void freeGroups(DimChannels *ch) {
+    for (int g = 0; g < ch->groupCount; ++g) {
+        free(ch->groups[g].taps);
+        free(ch->groups[g].runs);
+    }
+    free(ch->groups);
+    ch->groups = NULL;
+    ch->groupCount = 0;
+}
+
+void freeChannels(Dimension *dim) {
+    DimChannels *ch = dim->channels;
+    if (ch == NULL) { return; }
+    clearChannelKernels(dim);
+    dimFree(ch->planes);
+    dimFree(ch->next);
+    dimFree(ch->delta);
+    for (int k = 0; k < ch->scratchWorkers; ++k) { dimFree(ch->scratch[k]); }
+    free(ch->scratch);
+    free(ch);
+    dim->channels = NULL;
+}
+
+//gathers the kernels by source, DIM_GROUP_KERNELS at most per group, their taps padded to the group's radius
+//the group keeps the segments of taps where one of its kernels is non zero, the gaps between shells are skipped
+int prepareGroups(Dimension *dim) {
+    DimChannels *ch = dim->channels;
+    if (ch->groups != NULL || ch->kernelCount == 0) { return 0; }
+    ch->groups = calloc(ch->kernelCount, sizeof(DimKernelGroup));
+    if (ch->groups == NULL) { return 1; }
+    for (int s = 0; s < ch->count; ++s) {
+        DimKernelGroup *g = NULL;
+        for (int k = 0; k < ch->kernelCount; ++k) {
+            if (ch->kernels[k].source != s) { continue; }
+            if (g == NULL || g->count == DIM_GROUP_KERNELS) {
+                g = &ch->groups[ch->groupCount++];
+                g->source = s;
+            }
+            g->kernels[g->count++] = k;
+            if (ch->kernels[k].radius > g->radius) { g->radius = ch->kernels[k].radius; }
+        }
+    }
+    for (int i = 0; i < ch->groupCount; ++i) {
+        DimKernelGroup *g = &ch->groups[i];
+        int side = 2*g->radius+1, area = side*side;
+        g->taps = calloc((size_t)g->count*area, sizeof(float));
+        //a row has at most side/2+1 segments
+        g->runs = malloc(3*(size_t)side*(side/2+1)*sizeof(int));
+        if (g->taps == NULL || g->runs == NULL) {
+            freeGroups(ch);
+            return 1;
+        }
+        for (int n = 0; n < g->count; ++n) {
+            const DimChannelKernel *k = &ch->kernels[g->kernels[n]];
+            int ks = 2*k->radius+1, offset = g->radius - k->radius;
+            for (int ty = 0; ty < ks; ++ty) {
+                memcpy(g->taps + (size_t)n*area + (ty+offset)*side + offset, k->shape->taps + ty*ks, ks*sizeof(float));
+            }
+        }
+        for (int ty = 0; ty < side; ++ty) {
+            int start = -1;
+            for (int tx = 0; tx <= side; ++tx) {
+                bool live = false;
+                for (int n = 0; n < g->count && tx < side; ++n) { live = live || g->taps[(size_t)n*area + ty*side + tx] != 0.f; }
+                if (live && start < 0) { start = tx; }
+                if (!live && start >= 0) {
+                    int *run = g->runs + 3*g->runCount++;
+                    run[0] = ty;
+                    run[1] = start;
+                    run[2] = tx-1;
+                    start = -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+//per worker : a ring of 2R+1 haloed rows for each group, the sums of a group and the growth of every channel along a row
+int prepareChannelScratch(Dimension *dim) {
+    DimChannels *ch = dim->channels;
+    int w = dim->MATRIXWIDTH;
+    size_t need = (size_t)(DIM_GROUP_KERNELS + ch->count)*w;
+    for (int g = 0; g < ch->groupCount; ++g) {
+        int r = ch->groups[g].radius;
+        need += (size_t)(2*r+1)*(w+2*r);
+    }
+    if (ch->scratchWorkers < dim->threads) {
+        float **scratch = realloc(ch->scratch, dim->threads*sizeof(float *));
+        if (scratch == NULL) { return 1; }
+        for (int k = ch->scratchWorkers; k < dim->threads; ++k) { scratch[k] = NULL; }
+        ch->scratch = scratch;
+        ch->scratchWorkers = dim->threads;
+        ch->scratchSize = 0;
+    }
+    if (ch->scratchSize >= need) { return 0; }
+    for (int k = 0; k < ch->scratchWorkers; ++k) {
+        dimFree(ch->scratch[k]);
+        ch->scratch[k] = dimAlloc(need*sizeof(float));
+        if (ch->scratch[k] == NULL) {
+            ch->scratchSize = 0;
+            return 1;
+        }
+    }
+    ch->scratchSize = need;
+    return 0;
+}
+
+//n sums of every kernel of a group at x, each block of source cells being loaded once for all of them
+static inline __attribute__((always_inline)) void convGroupBlock(const DimKernelGroup *g, const float *ring, size_t stride, int y, float *sums, int w, int x, int n) {
+    int side = 2*g->radius+1, area = side*side;
+    float acc[DIM_GROUP_KERNELS][DIM_CONV_BLOCK] = {{ 0.f }};
+    for (int r = 0; r < g->runCount; ++r) {
+        const int *run = g->runs + 3*r;
+        int j = run[0];
+        const float *row = ring + (size_t)(((y+j) % side + side) % side)*stride + x;
+        for (int t = run[1]; t <= run[2]; ++t) {
+            float v[DIM_CONV_BLOCK];
+            for (int i = 0; i < n; ++i) { v[i] = row[t+i]; }
+            for (int k = 0; k < g->count; ++k) {
+                const float tap = g->taps[(size_t)k*area + j*side + t];
+                //the taps of a smaller kernel of the group are zeros around its disc
+                if (tap == 0.f) { continue; }
+                for (int i = 0; i < n; ++i) { acc[k][i] += tap*v[i]; }
+            }
+        }
+    }
+    for (int k = 0; k < g->count; ++k) { memcpy(sums + (size_t)k*w + x, acc[k], n*sizeof(float)); }
+}
+
+//sums of the kernels of a group over an output row, y being the source row of the first kernel row
+//the ring holds 2R+1 haloed rows of stride floats, row y in slot y modulo 2R+1
+void convGroupRow(const DimKernelGroup *g, const float *ring, size_t stride, int y, float *sums, int w) {
+    int x = 0;
+    for (; x+DIM_CONV_BLOCK <= w; x += DIM_CONV_BLOCK) { convGroupBlock(g, ring, stride, y, sums, w, x, DIM_CONV_BLOCK); }
+    if (x < w) { convGroupBlock(g, ring, stride, y, sums, w, x, w-x); }
+}
+
+//loop of a built-in growth function, inlined with a constant function as growthLoop
+static inline __attribute__((always_inline)) void kernelGrowthLoop(DimGrowthFunction function, bool fast, const DimChannelKernel *k, float skew, const float *sums, int stride, float *delta, int n) {
+    const float weight = k->weight, a = k->a, b = k->b, c = k->c, d = k->d;
+    for (int i = 0; i < n; ++i) { delta[i] += weight*growthShape(function, fast, sums[i*stride], a, b, c, d, skew); }
+}
+
+//adds the growth of n sums stride floats apart to delta, the lookup table of dim being for its own parameters
+static inline void kernelGrowth(Dimension *dim, const DimChannelKernel *k, const float *sums, int stride, float *delta, int n) {
+    bool fast = dim->growthMode == DIM_GROWTH_FASTEXP;
+    const float skew = dim->growthSkew;
+    switch (dim->growthFunction) {
+        case DIM_GROWTH_POLYNOMIAL: kernelGrowthLoop(DIM_GROWTH_POLYNOMIAL, false, k, skew, sums, stride, delta, n); break;
+        case DIM_GROWTH_STEP: kernelGrowthLoop(DIM_GROWTH_STEP, false, k, skew, sums, stride, delta, n); break;
+        case DIM_GROWTH_ASYMMETRIC:
+            if (fast) { kernelGrowthLoop(DIM_GROWTH_ASYMMETRIC, true, k, skew, sums, stride, delta, n); }
+            else { kernelGrowthLoop(DIM_GROWTH_ASYMMETRIC, false, k, skew, sums, stride, delta, n); }
+            break;
+        case DIM_GROWTH_CALLBACK: {
+            const float params[4] = { k->a, k->b, k->c, k->d };
+            for (int i = 0; i < n; ++i) { delta[i] += k->weight*dim->growthCallback(sums[i*stride], params, dim->growthUser); }
+            break;
+        }
+        default:
+            if (fast) { kernelGrowthLoop(DIM_GROWTH_GAUSSIAN, true, k, skew, sums, stride, delta, n); }
+            else { kernelGrowthLoop(DIM_GROWTH_GAUSSIAN, false, k, skew, sums, stride, delta, n); }
+            break;
+    }
+}
+
+//new states of row y of every channel from their growth, channel c's being stride floats after channel c-1's
+//channel 0 goes to the cells' state, the others to their next plane
+void applyChannelRow(Dimension *dim, int y, const float *delta, size_t stride) {
+    DimChannels *ch = dim->channels;
+    int w = dim->MATRIXWIDTH;
+    size_t plane = (size_t)w*dim->MATRIXHEIGHT;
+    const float dt = dim->DT;
+    Cell *cells = &dim->matrix[(size_t)y*w];
+    for (int x = 0; x < w; ++x) {
+        float s = cells[x].state + delta[x]*dt;
+        cells[x].state = s > 1.f ? 1.f : s < 0.f ? 0.f : s;
+    }
+    for (int c = 1; c < ch->count; ++c) {
+        const float *cur = ch->planes + (c-1)*plane + (size_t)y*w, *dc = delta + c*stride;
+        float *next = ch->next + (c-1)*plane + (size_t)y*w;
+        for (int x = 0; x < w; ++x) {
+            float s = cur[x] + dc[x]*dt;
+            next[x] = s > 1.f ? 1.f : s < 0.f ? 0.f : s;
+        }
+    }
+}
+
+//fused direct step of the rows [y0, y1) : for each row, every group convolves its source once for all its kernels
+//and their growth is summed into the targets
+void channelsTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimChannels *ch = dim->channels;
+    int w = dim->MATRIXWIDTH;
+    float *scratch = ch->scratch[worker], *rings = scratch;
+    for (int g = 0; g < ch->groupCount; ++g) {
+        int r = ch->groups[g].radius;
+        scratch += (size_t)(2*r+1)*(w+2*r);
+    }
+    float *sums = scratch, *delta = sums + (size_t)DIM_GROUP_KERNELS*w;
+
+    float *ring = rings;
+    for (int g = 0; g < ch->groupCount; ++g) {
+        int r = ch->groups[g].radius, side = 2*r+1;
+        size_t stride = w+2*r;
+        for (int y = y0-r; y < y0+r; ++y) { loadChannelHaloRow(dim, ch->groups[g].source, y, r, ring + (size_t)((y % side + side) % side)*stride); }
+        ring += side*stride;
+    }
+    for (int y = y0; y < y1; ++y) {
+        memset(delta, 0, (size_t)ch->count*w*sizeof(float));
+        ring = rings;
+        for (int g = 0; g < ch->groupCount; ++g) {
+            const DimKernelGroup *group = &ch->groups[g];
+            int r = group->radius, side = 2*r+1;
+            size_t stride = w+2*r;
+            loadChannelHaloRow(dim, group->source, y+r, r, ring + (size_t)(((y+r) % side + side) % side)*stride);
+            convGroupRow(group, ring, stride, y-r, sums, w);
+            for (int k = 0; k < group->count; ++k) {
+                const DimChannelKernel *kernel = &ch->kernels[group->kernels[k]];
+                kernelGrowth(dim, kernel, sums + (size_t)k*w, 1, delta + (size_t)kernel->target*w, w);
+            }
+            ring += side*stride;
+        }
+        applyChannelRow(dim, y, delta, w);
+    }
+}
+
+//growth of the sums of a pair of kernels added to the delta planes of their targets
+void channelSumsTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimFFTSums *sums = ctx;
+    DimChannels *ch = dim->channels;
+    int w = dim->MATRIXWIDTH;
+    size_t plane = (size_t)w*dim->MATRIXHEIGHT;
+    const DimChannelKernel *k0 = &ch->kernels[sums->first], *k1 = k0+1;
+    for (int y = y0; y < y1; ++y) {
+        const float *src = sums->plane + 2*(size_t)y*w;
+        kernelGrowth(dim, k0, src, 2, ch->delta + k0->target*plane + (size_t)y*w, w);
+        if (sums->pair) { kernelGrowth(dim, k1, src+1, 2, ch->delta + k1->target*plane + (size_t)y*w, w); }
+    }
+}
+
+void clearDeltaTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimChannels *ch = dim->channels;
+    int w = dim->MATRIXWIDTH;
+    size_t plane = (size_t)w*dim->MATRIXHEIGHT;
+    for (int c = 0; c < ch->count; ++c) { memset(ch->delta + c*plane + (size_t)y0*w, 0, (size_t)(y1-y0)*w*sizeof(float)); }
+}
+
+void applyTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimChannels *ch = dim->channels;
+    int w = dim->MATRIXWIDTH;
+    for (int y = y0; y < y1; ++y) { applyChannelRow(dim, y, ch->delta + (size_t)y*w, (size_t)w*dim->MATRIXHEIGHT); }
+}
+
+void channelSwapTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    for (int y = y0; y < y1; ++y) { swapRow(dim, y); }
+}
+
+//growth of every kernel through the fft engine, returns 1 when it can't be used
+int stepChannelsFFT(Dimension *dim) {
+    DimChannels *ch = dim->channels;
+    size_t plane = (size_t)dim->MATRIXWIDTH*dim->MATRIXHEIGHT;
+    if (ch->delta == NULL) {
+        ch->delta = dimAlloc(ch->count*plane*sizeof(float));
+        if (ch->delta == NULL) { return 1; }
+    }
+    DimFFTKernel *kernels = malloc(ch->kernelCount*sizeof(DimFFTKernel));
+    if (kernels == NULL) { return 1; }
+    for (int k = 0; k < ch->kernelCount; ++k) { kernels[k] = (DimFFTKernel){ ch->kernels[k].source, ch->kernels[k].radius, ch->kernels[k].shape->taps, 1.f }; }
+
+    double t = dimClock();
+    parallelRows(dim, "clear", clearDeltaTask, NULL);
+    int failed = fftConvolve(dim, ch->count, kernels, ch->kernelCount, channelSumsTask, NULL);
+    free(kernels);
+    if (failed) { return 1; }
+    t = lapPhase(dim, DIM_PHASE_CONVOLUTION, t);
+    parallelRows(dim, "channels", applyTask, NULL);
+    lapPhase(dim, DIM_PHASE_GROWTH, t);
+    return 0;
+}
+
+//one generation of a multi-channel world
+void doStepChannels(Dimension *dim) {
+    DimChannels *ch = dim->channels;
+    bool done = false;
+    if (dim->engine == DIM_ENGINE_FFT && ch->kernelCount > 0) {
+        done = stepChannelsFFT(dim) == 0;
+        if (!done) {
+            fprintf(stderr, "The fft engine can't step these channels, switching to the direct engine\n");
+            dim->engine = DIM_ENGINE_DIRECT;
+        }
+    }
+    if (!done && (prepareGroups(dim) != 0 || prepareChannelScratch(dim) != 0)) {
+        fprintf(stderr, "Failed to allocate the kernel groups of the channels, the dimension is not stepped\n");
+        return;
+    }
+    //the growth is fused in the sweep, the whole sweep is timed as convolution
+    if (!done) {
+        double t = dimClock();
+        parallelRows(dim, "channels", channelsTask, NULL);
+        lapPhase(dim, DIM_PHASE_CONVOLUTION, t);
+    }
+
+    double t = dimClock();
+    parallelRows(dim, "swap", channelSwapTask, NULL);
+    float *planes = ch->planes;
+    ch->planes = ch->next;
+    ch->next = planes;
+    lapPhase(dim, DIM_PHASE_SWAP, t);
+}
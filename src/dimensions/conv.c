@@ -0,0 +1,202 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+//records the first and last non zero tap of each kernel row, the convolution skips the rest
+void genSpans(Dimension *dim) {
+    int side = 2*dim->KERNELRAD+1;
+    free(dim->spans);
+    dim->spans = malloc(2*side*sizeof(int));
+    if (dim->spans == NULL) { return; }
+    for (int k = 0; k < side; ++k) {
+        int lo = side, hi = -1;
+        for (int t = 0; t < side; ++t) {
+            if (dim->kernel[t+k*side] != 0.f) {
+                if (t < lo) { lo = t; }
+                hi = t;
+            }
+        }
+        dim->spans[2*k] = lo;
+        dim->spans[2*k+1] = hi;
+    }
+
+    //a generated row convolution is only valid if no tap lies outside of its spans
+    dim->convRow = convRowGeneric;
+    for (const DimConvSpec *spec = convSpecs; spec->convRow != NULL; ++spec) {
+        if (spec->radius != dim->KERNELRAD) { continue; }
+        bool fits = true;
+        for (int k = 0; k < side; ++k) {
+            if (dim->spans[2*k] > dim->spans[2*k+1]) { continue; }
+            if (dim->spans[2*k] < spec->spans[2*k] || dim->spans[2*k+1] > spec->spans[2*k+1]) { fits = false; }
+        }
+        if (fits) { dim->convRow = spec->convRow; }
+    }
+}
+
+//makes sure every worker has a ring large enough for the current world
+int prepareScratch(Dimension *dim) {
+    //one row more than the kernel for the rows computed by pairs, then the two output rows
+    int side = 2*dim->KERNELRAD+2;
+    size_t need = (size_t)side*(dim->MATRIXWIDTH+2*dim->KERNELRAD) + 2*(size_t)dim->MATRIXWIDTH;
+    if (dim->scratchCount < dim->threads) {
+        DimScratch *scratch = realloc(dim->scratch, dim->threads*sizeof(DimScratch));
+        if (scratch == NULL) { return 1; }
+        for (int k = dim->scratchCount; k < dim->threads; ++k) { scratch[k] = (DimScratch){ NULL, NULL, 0, NULL, 0 }; }
+        dim->scratch = scratch;
+        dim->scratchCount = dim->threads;
+    }
+    for (int k = 0; k < dim->threads; ++k) {
+        DimScratch *s = &dim->scratch[k];
+        if (s->capacity >= need) { continue; }
+        dimFree(s->ring);
+        free(s->rows);
+        s->ring = dimAlloc(need*sizeof(float));
+        s->rows = malloc(side*sizeof(float *));
+        s->capacity = s->ring != NULL && s->rows != NULL ? need : 0;
+        if (s->capacity == 0) { return 1; }
+    }
+    return 0;
+}
+
+void freeScratch(Dimension *dim) {
+    for (int k = 0; k < dim->scratchCount; ++k) {
+        dimFree(dim->scratch[k].ring);
+        free(dim->scratch[k].rows);
+        dimFree(dim->scratch[k].tile);
+    }
+    free(dim->scratch);
+    dim->scratch = NULL;
+    dim->scratchCount = 0;
+}
+
+//decodes source row y (wrapped) into dst, with R cells of toroidal halo on each side
+void loadRow(Dimension *dim, int y, float *dst) {
+    int w = dim->MATRIXWIDTH, r = dim->KERNELRAD;
+    y = ((y % dim->MATRIXHEIGHT) + dim->MATRIXHEIGHT) % dim->MATRIXHEIGHT;
+    decodeRow(dim, y, dst + r);
+    for (int i = 0; i < r; ++i) {
+        dst[i] = dst[r + ((i - r) % w + w) % w];
+        dst[r + w + i] = dst[r + i % w];
+    }
+}
+
+//neighbour sums of the outputs [x0, x1) of a row, rows[k] being the haloed source row at offset k-R
+void convRowRange(Dimension *dim, const float **rows, float *out, int x0, int x1) {
+    int side = 2*dim->KERNELRAD+1;
+    const float inv = 1.f/dim->kSum;
+    for (int x = x0; x < x1; ++x) { out[x] = 0.f; }
+    for (int k = 0; k < side; ++k) {
+        int lo = dim->spans[2*k], hi = dim->spans[2*k+1];
+        const float *taps = dim->kernel + k*side;
+        const float *row = rows[k];
+        for (int t = lo; t <= hi; ++t) {
+            const float tap = taps[t];
+            const float *src = row + t;
+            for (int x = x0; x < x1; ++x) { out[x] += tap*src[x]; }
+        }
+    }
+    for (int x = x0; x < x1; ++x) { out[x] *= inv; }
+}
+
+void convRowGeneric(Dimension *dim, const float **rows, float *out) {
+    convRowRange(dim, rows, out, 0, dim->MATRIXWIDTH);
+}
+
+#define PAIR_LANES (DIM_PAIR_BLOCK/DIM_VEC_WIDTH)
+
+//adds source row J to the accumulators of a pair block at x, it is kernel row J of the first output and J-1 of the second
+//taps outside of a kernel row's span are zeros, adding their products leaves the sums unchanged
+#define PAIR_ROW(J, LO, HI, SIDE) { \
+    const float *src = rows[J] + x; \
+    for (int t = (LO); t <= (HI); ++t) { \
+        const float tap0 = (J) < (SIDE) ? kernel[(J)*(SIDE)+t] : 0.f; \
+        const float tap1 = (J) > 0 ? kernel[((J)-1)*(SIDE)+t] : 0.f; \
+        for (int l = 0; l < PAIR_LANES; ++l) { \
+            DimVec v; \
+            memcpy(&v, src + t + l*DIM_VEC_WIDTH, sizeof(v)); \
+            acc0[l] += tap0*v; \
+            acc1[l] += tap1*v; \
+        } \
+    } \
+}
+
+#define PAIR_STORE() { \
+    for (int l = 0; l < PAIR_LANES; ++l) { \
+        DimVec v0 = acc0[l]*inv, v1 = acc1[l]*inv; \
+        memcpy(out0 + x + l*DIM_VEC_WIDTH, &v0, sizeof(v0)); \
+        memcpy(out1 + x + l*DIM_VEC_WIDTH, &v1, sizeof(v1)); \
+    } \
+}
+
+//neighbour sums of two consecutive output rows, every source segment loaded serving both rows' accumulators
+//each output still sums its taps in the order of convRowRange
+void convRowPair(Dimension *dim, const float **rows, float *out0, float *out1) {
+    int side = 2*dim->KERNELRAD+1, last = side, w = dim->MATRIXWIDTH;
+    const DimVec inv = { 1.f/dim->kSum, 1.f/dim->kSum, 1.f/dim->kSum, 1.f/dim->kSum };
+    const float *kernel = dim->kernel;
+    const int *spans = dim->spans;
+    int x = 0;
+    for (; x+DIM_PAIR_BLOCK <= w; x += DIM_PAIR_BLOCK) {
+        DimVec acc0[PAIR_LANES] = { 0 }, acc1[PAIR_LANES] = { 0 };
+        PAIR_ROW(0, spans[0], spans[1], side)
+        for (int j = 1; j < side; ++j) {
+            int lo = spans[2*j] < spans[2*j-2] ? spans[2*j] : spans[2*j-2];
+            int hi = spans[2*j+1] > spans[2*j-1] ? spans[2*j+1] : spans[2*j-1];
+            PAIR_ROW(j, lo, hi, side)
+        }
+        PAIR_ROW(last, spans[2*side-2], spans[2*side-1], side)
+        PAIR_STORE()
+    }
+    convRowRange(dim, rows, out0, x, w);
+    convRowRange(dim, rows+1, out1, x, w);
+}
+#undef PAIR_STORE
+#undef PAIR_ROW
+
+//convolution of the outputs [x0, x1) of the rows [y0, y1), every source row being decoded once into the worker's ring
+//ctx points to the range and the row convolution to use
+//a range covering half of the row or more is convolved whole into the worker's output rows, the part then copied,
+//a narrower one goes through convRowRange, every row convolution summing each output's taps in the same order
+void convolutionRingTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimConvRange *range = ctx;
+    DimConvRow convRow = range->convRow;
+    int r = dim->KERNELRAD, side = 2*r+1, slots = side+1, w = dim->MATRIXWIDTH, stride = w+2*r;
+    int x0 = range->x0, x1 = range->x1;
+    DimScratch *s = &dim->scratch[worker];
+    float *out = s->ring + (size_t)slots*stride;
+    bool whole = x0 == 0 && x1 == w, wide = 2*(x1-x0) >= w;
+    #define SLOT(y) (s->ring + (size_t)((((y) % slots) + slots) % slots)*stride)
+
+    //the generic rows go by pairs, generated and compiled rows are already blocked over their literal spans
+    bool pairs = convRow == convRowGeneric && wide;
+    for (int y = y0-r; y < y0+r; ++y) { loadRow(dim, y, SLOT(y)); }
+    for (int y = y0; y < y1; ++y) {
+        float *sums = &dim->sums[(size_t)y*w];
+        loadRow(dim, y+r, SLOT(y+r));
+        if (pairs && y+1 < y1) {
+            loadRow(dim, y+r+1, SLOT(y+r+1));
+            for (int k = 0; k <= side; ++k) { s->rows[k] = SLOT(y-r+k); }
+            if (whole) {
+                convRowPair(dim, s->rows, sums, sums+w);
+            } else {
+                convRowPair(dim, s->rows, out, out+w);
+                memcpy(sums+x0, out+x0, (x1-x0)*sizeof(float));
+                memcpy(sums+w+x0, out+w+x0, (x1-x0)*sizeof(float));
+            }
+            ++y;
+            continue;
+        }
+        for (int k = 0; k < side; ++k) { s->rows[k] = SLOT(y-r+k); }
+        if (whole) {
+            convRow(dim, s->rows, sums);
+        } else if (wide) {
+            convRow(dim, s->rows, out);
+            memcpy(sums+x0, out+x0, (x1-x0)*sizeof(float));
+        } else {
+            convRowRange(dim, s->rows, sums, x0, x1);
+        }
+    }
+    #undef SLOT
+}
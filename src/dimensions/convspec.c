@@ -0,0 +1,275 @@
+//generated by scripts/genconv.sh, do not edit
+#include "dimpriv.h"
+
+//accumulates the taps LO..HI of kernel row K over a block of outputs
+#define ROW(K, LO, HI) { \
+    const float *row = rows[K] + x; \
+    const float *taps = kernel + K*SIDE; \
+    for (int t = LO; t <= HI; ++t) { \
+        const float tap = taps[t]; \
+        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { acc[i] += tap*row[t+i]; } \
+    } \
+}
+
+#define SIDE 11
+static const int spans5[] = {
+    5, 5, 2, 8, 1, 9, 1, 9, 1, 9, 0, 10, 1, 9, 1, 9, 1, 9, 2, 8, 5, 5,
+};
+
+static void convRow5(Dimension *dim, const float **rows, float *out) {
+    const float *kernel = dim->kernel;
+    const float inv = 1.f/dim->kSum;
+    int w = dim->MATRIXWIDTH, x = 0;
+    for (; x+DIM_CONV_BLOCK <= w; x += DIM_CONV_BLOCK) {
+        float acc[DIM_CONV_BLOCK] = { 0.f };
+        ROW(0, 5, 5)
+        ROW(1, 2, 8)
+        ROW(2, 1, 9)
+        ROW(3, 1, 9)
+        ROW(4, 1, 9)
+        ROW(5, 0, 10)
+        ROW(6, 1, 9)
+        ROW(7, 1, 9)
+        ROW(8, 1, 9)
+        ROW(9, 2, 8)
+        ROW(10, 5, 5)
+        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { out[x+i] = acc[i]*inv; }
+    }
+    convRowRange(dim, rows, out, x, w);
+}
+#undef SIDE
+
+#define SIDE 17
+static const int spans8[] = {
+    8, 8, 5, 11, 3, 13, 2, 14, 2, 14, 1, 15, 1, 15, 1, 15, 0, 16, 1, 15, 1, 15, 1, 15, 2, 14, 2, 14, 3, 13, 5, 11, 8, 8,
+};
+
+static void convRow8(Dimension *dim, const float **rows, float *out) {
+    const float *kernel = dim->kernel;
+    const float inv = 1.f/dim->kSum;
+    int w = dim->MATRIXWIDTH, x = 0;
+    for (; x+DIM_CONV_BLOCK <= w; x += DIM_CONV_BLOCK) {
+        float acc[DIM_CONV_BLOCK] = { 0.f };
+        ROW(0, 8, 8)
+        ROW(1, 5, 11)
+        ROW(2, 3, 13)
+        ROW(3, 2, 14)
+        ROW(4, 2, 14)
+        ROW(5, 1, 15)
+        ROW(6, 1, 15)
+        ROW(7, 1, 15)
+        ROW(8, 0, 16)
+        ROW(9, 1, 15)
+        ROW(10, 1, 15)
+        ROW(11, 1, 15)
+        ROW(12, 2, 14)
+        ROW(13, 2, 14)
+        ROW(14, 3, 13)
+        ROW(15, 5, 11)
+        ROW(16, 8, 8)
+        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { out[x+i] = acc[i]*inv; }
+    }
+    convRowRange(dim, rows, out, x, w);
+}
+#undef SIDE
+
+#define SIDE 21
+static const int spans10[] = {
+    10, 10, 6, 14, 4, 16, 3, 17, 2, 18, 2, 18, 1, 19, 1, 19, 1, 19, 1, 19, 0, 20, 1, 19, 1, 19, 1, 19, 1, 19, 2, 18, 2, 18, 3, 17, 4, 16, 6, 14, 10, 10,
+};
+
+static void convRow10(Dimension *dim, const float **rows, float *out) {
+    const float *kernel = dim->kernel;
+    const float inv = 1.f/dim->kSum;
+    int w = dim->MATRIXWIDTH, x = 0;
+    for (; x+DIM_CONV_BLOCK <= w; x += DIM_CONV_BLOCK) {
+        float acc[DIM_CONV_BLOCK] = { 0.f };
+        ROW(0, 10, 10)
+        ROW(1, 6, 14)
+        ROW(2, 4, 16)
+        ROW(3, 3, 17)
+        ROW(4, 2, 18)
+        ROW(5, 2, 18)
+        ROW(6, 1, 19)
+        ROW(7, 1, 19)
+        ROW(8, 1, 19)
+        ROW(9, 1, 19)
+        ROW(10, 0, 20)
+        ROW(11, 1, 19)
+        ROW(12, 1, 19)
+        ROW(13, 1, 19)
+        ROW(14, 1, 19)
+        ROW(15, 2, 18)
+        ROW(16, 2, 18)
+        ROW(17, 3, 17)
+        ROW(18, 4, 16)
+        ROW(19, 6, 14)
+        ROW(20, 10, 10)
+        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { out[x+i] = acc[i]*inv; }
+    }
+    convRowRange(dim, rows, out, x, w);
+}
+#undef SIDE
+
+#define SIDE 27
+static const int spans13[] = {
+    13, 13, 8, 18, 7, 19, 5, 21, 4, 22, 3, 23, 3, 23, 2, 24, 1, 25, 1, 25, 1, 25, 1, 25, 1, 25, 0, 26, 1, 25, 1, 25, 1, 25, 1, 25, 1, 25, 2, 24, 3, 23, 3, 23, 4, 22, 5, 21, 7, 19, 8, 18, 13, 13,
+};
+
+static void convRow13(Dimension *dim, const float **rows, float *out) {
+    const float *kernel = dim->kernel;
+    const float inv = 1.f/dim->kSum;
+    int w = dim->MATRIXWIDTH, x = 0;
+    for (; x+DIM_CONV_BLOCK <= w; x += DIM_CONV_BLOCK) {
+        float acc[DIM_CONV_BLOCK] = { 0.f };
+        ROW(0, 13, 13)
+        ROW(1, 8, 18)
+        ROW(2, 7, 19)
+        ROW(3, 5, 21)
+        ROW(4, 4, 22)
+        ROW(5, 3, 23)
+        ROW(6, 3, 23)
+        ROW(7, 2, 24)
+        ROW(8, 1, 25)
+        ROW(9, 1, 25)
+        ROW(10, 1, 25)
+        ROW(11, 1, 25)
+        ROW(12, 1, 25)
+        ROW(13, 0, 26)
+        ROW(14, 1, 25)
+        ROW(15, 1, 25)
+        ROW(16, 1, 25)
+        ROW(17, 1, 25)
+        ROW(18, 1, 25)
+        ROW(19, 2, 24)
+        ROW(20, 3, 23)
+        ROW(21, 3, 23)
+        ROW(22, 4, 22)
+        ROW(23, 5, 21)
+        ROW(24, 7, 19)
+        ROW(25, 8, 18)
+        ROW(26, 13, 13)
+        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { out[x+i] = acc[i]*inv; }
+    }
+    convRowRange(dim, rows, out, x, w);
+}
+#undef SIDE
+
+#define SIDE 33
+static const int spans16[] = {
+    16, 16, 11, 21, 9, 23, 7, 25, 6, 26, 5, 27, 4, 28, 3, 29, 3, 29, 2, 30, 2, 30, 1, 31, 1, 31, 1, 31, 1, 31, 1, 31, 0, 32, 1, 31, 1, 31, 1, 31, 1, 31, 1, 31, 2, 30, 2, 30, 3, 29, 3, 29, 4, 28, 5, 27, 6, 26, 7, 25, 9, 23, 11, 21, 16, 16,
+};
+
+static void convRow16(Dimension *dim, const float **rows, float *out) {
+    const float *kernel = dim->kernel;
+    const float inv = 1.f/dim->kSum;
+    int w = dim->MATRIXWIDTH, x = 0;
+    for (; x+DIM_CONV_BLOCK <= w; x += DIM_CONV_BLOCK) {
+        float acc[DIM_CONV_BLOCK] = { 0.f };
+        ROW(0, 16, 16)
+        ROW(1, 11, 21)
+        ROW(2, 9, 23)
+        ROW(3, 7, 25)
+        ROW(4, 6, 26)
+        ROW(5, 5, 27)
+        ROW(6, 4, 28)
+        ROW(7, 3, 29)
+        ROW(8, 3, 29)
+        ROW(9, 2, 30)
+        ROW(10, 2, 30)
+        ROW(11, 1, 31)
+        ROW(12, 1, 31)
+        ROW(13, 1, 31)
+        ROW(14, 1, 31)
+        ROW(15, 1, 31)
+        ROW(16, 0, 32)
+        ROW(17, 1, 31)
+        ROW(18, 1, 31)
+        ROW(19, 1, 31)
+        ROW(20, 1, 31)
+        ROW(21, 1, 31)
+        ROW(22, 2, 30)
+        ROW(23, 2, 30)
+        ROW(24, 3, 29)
+        ROW(25, 3, 29)
+        ROW(26, 4, 28)
+        ROW(27, 5, 27)
+        ROW(28, 6, 26)
+        ROW(29, 7, 25)
+        ROW(30, 9, 23)
+        ROW(31, 11, 21)
+        ROW(32, 16, 16)
+        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { out[x+i] = acc[i]*inv; }
+    }
+    convRowRange(dim, rows, out, x, w);
+}
+#undef SIDE
+
+#define SIDE 41
+static const int spans20[] = {
+    20, 20, 14, 26, 12, 28, 10, 30, 8, 32, 7, 33, 6, 34, 5, 35, 4, 36, 4, 36, 3, 37, 3, 37, 2, 38, 2, 38, 1, 39, 1, 39, 1, 39, 1, 39, 1, 39, 1, 39, 0, 40, 1, 39, 1, 39, 1, 39, 1, 39, 1, 39, 1, 39, 2, 38, 2, 38, 3, 37, 3, 37, 4, 36, 4, 36, 5, 35, 6, 34, 7, 33, 8, 32, 10, 30, 12, 28, 14, 26, 20, 20,
+};
+
+static void convRow20(Dimension *dim, const float **rows, float *out) {
+    const float *kernel = dim->kernel;
+    const float inv = 1.f/dim->kSum;
+    int w = dim->MATRIXWIDTH, x = 0;
+    for (; x+DIM_CONV_BLOCK <= w; x += DIM_CONV_BLOCK) {
+        float acc[DIM_CONV_BLOCK] = { 0.f };
+        ROW(0, 20, 20)
+        ROW(1, 14, 26)
+        ROW(2, 12, 28)
+        ROW(3, 10, 30)
+        ROW(4, 8, 32)
+        ROW(5, 7, 33)
+        ROW(6, 6, 34)
+        ROW(7, 5, 35)
+        ROW(8, 4, 36)
+        ROW(9, 4, 36)
+        ROW(10, 3, 37)
+        ROW(11, 3, 37)
+        ROW(12, 2, 38)
+        ROW(13, 2, 38)
+        ROW(14, 1, 39)
+        ROW(15, 1, 39)
+        ROW(16, 1, 39)
+        ROW(17, 1, 39)
+        ROW(18, 1, 39)
+        ROW(19, 1, 39)
+        ROW(20, 0, 40)
+        ROW(21, 1, 39)
+        ROW(22, 1, 39)
+        ROW(23, 1, 39)
+        ROW(24, 1, 39)
+        ROW(25, 1, 39)
+        ROW(26, 1, 39)
+        ROW(27, 2, 38)
+        ROW(28, 2, 38)
+        ROW(29, 3, 37)
+        ROW(30, 3, 37)
+        ROW(31, 4, 36)
+        ROW(32, 4, 36)
+        ROW(33, 5, 35)
+        ROW(34, 6, 34)
+        ROW(35, 7, 33)
+        ROW(36, 8, 32)
+        ROW(37, 10, 30)
+        ROW(38, 12, 28)
+        ROW(39, 14, 26)
+        ROW(40, 20, 20)
+        for (int i = 0; i < DIM_CONV_BLOCK; ++i) { out[x+i] = acc[i]*inv; }
+    }
+    convRowRange(dim, rows, out, x, w);
+}
+#undef SIDE
+#undef ROW
+
+const DimConvSpec convSpecs[] = {
+    { 5, spans5, convRow5 },
+    { 8, spans8, convRow8 },
+    { 10, spans10, convRow10 },
+    { 13, spans13, convRow13 },
+    { 16, spans16, convRow16 },
+    { 20, spans20, convRow20 },
+    { 0, NULL, NULL }
+};
@@ -0,0 +1,270 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+//version of the model, costs measured for another one are measured again
+#define DIM_COST_MODEL 1
+//side of the calibration worlds and their two radii
+#define DIM_COST_SIDE 256
+#define DIM_COST_SMALL 4
+#define DIM_COST_LARGE 16
+//seconds each calibration world is stepped for
+#define DIM_COST_TIME .05
+#define DIM_COST_THREADS 64
+
+//seconds of a step on this machine for a thread count : per cell-tap of the direct engine, per cell of everything both
+//engines do (growth, copies), per cell and level of a complex transform of the fft engine
+typedef struct DimEngineCosts {
+    int threads;
+    double tap, cell, butterfly;
+} DimEngineCosts;
+
+//costs known to the process, read from the cache or measured
+static DimEngineCosts costs[DIM_COST_THREADS];
+static int costCount = 0;
+static pthread_mutex_t costLock = PTHREAD_MUTEX_INITIALIZER;
+
+int costPath(char *path, size_t size);
+int loadCosts(int threads, DimEngineCosts *c);
+void saveCosts(const DimEngineCosts *c);
+double timeSteps(Dimension *dim);
+int measureCosts(int threads, DimEngineCosts *c);
+const DimEngineCosts *engineCosts(int threads);
+double transformCost(int n);
+uint64_t engineKey(Dimension *dim);
+
+//model name of the cpu, "unknown" where it can't be read
+void cpuName(char *name, size_t size) {
+    snprintf(name, size, "unknown");
+#if !defined(_WIN32)
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (fp == NULL) { return; }
+    char line[256];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) != 0 || colon == NULL) { continue; }
+        snprintf(name, size, "%s", colon + 2);
+        name[strcspn(name, "\n")] = '\0';
+        break;
+    }
+    fclose(fp);
+#endif
+}
+
+//the cpu and its count, measurements of another machine sharing the home directory are not read
+uint64_t machineKey(void) {
+    char name[256];
+    cpuName(name, sizeof(name));
+    int shape[] = { getCpuCount(), DIM_COST_MODEL };
+    uint64_t h = hashBytes(0xcbf29ce484222325ull, name, strlen(name));
+    return hashBytes(h, shape, sizeof(shape));
+}
+
+//directory of the measurements kept across runs : $DIM_CACHE_DIR, else $XDG_CACHE_HOME/dimensions, else
+//$HOME/.cache/dimensions, made if needed, returns 1 when there is none
+int cacheDirectory(char *dir, size_t size) {
+#if defined(_WIN32)
+    return 1;
+#else
+    if (getenv("DIM_CACHE_DIR") != NULL) {
+        snprintf(dir, size, "%s", getenv("DIM_CACHE_DIR"));
+    } else if (getenv("XDG_CACHE_HOME") != NULL) {
+        snprintf(dir, size, "%s/dimensions", getenv("XDG_CACHE_HOME"));
+    } else if (getenv("HOME") != NULL) {
+        snprintf(dir, size, "%s/.cache", getenv("HOME"));
+        mkdir(dir, 0700);
+        snprintf(dir, size, "%s/.cache/dimensions", getenv("HOME"));
+    } else {
+        return 1;
+    }
+    mkdir(dir, 0700);
+    return access(dir, W_OK) != 0;
+#endif
+}
+
+int costPath(char *path, size_t size) {
+    char dir[512];
+    if (cacheDirectory(dir, sizeof(dir)) != 0) { return 1; }
+    snprintf(path, size, "%s/engines-%016llx.txt", dir, (unsigned long long)machineKey());
+    return 0;
+}
+
+//last line of the cache for the thread count
+int loadCosts(int threads, DimEngineCosts *c) {
+    char path[600], line[256];
+    if (costPath(path, sizeof(path)) != 0) { return 1; }
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) { return 1; }
+    int found = 1;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        DimEngineCosts read;
+        if (sscanf(line, "%d %lg %lg %lg", &read.threads, &read.tap, &read.cell, &read.butterfly) != 4 || read.threads != threads) { continue; }
+        *c = read;
+        found = 0;
+    }
+    fclose(fp);
+    return found;
+}
+
+//appended, a line is written in one go so concurrent processes at worst measure twice
+void saveCosts(const DimEngineCosts *c) {
+    char path[600], name[256];
+    if (costPath(path, sizeof(path)) != 0) { return; }
+    FILE *fp = fopen(path, "a");
+    if (fp == NULL) { return; }
+    if (ftell(fp) == 0) {
+        cpuName(name, sizeof(name));
+        fprintf(fp, "# libdimensions engine costs on %s : threads, seconds per tap, per cell, per transformed point and level\n", name);
+    }
+    fprintf(fp, "%d %.9g %.9g %.9g\n", c->threads, c->tap, c->cell, c->butterfly);
+    fclose(fp);
+}
+
+//seconds per step, after a first step paying for the pool, the scratch and the spectra
+double timeSteps(Dimension *dim) {
+    doStep(dim);
+    int steps = 0;
+    double start = dimClock(), elapsed = 0.;
+    while (elapsed < DIM_COST_TIME || steps < 2) {
+        doStep(dim);
+        steps++;
+        elapsed = dimClock() - start;
+    }
+    return elapsed/steps;
+}
+
+//two radii of the direct engine give the cost of a tap and of the rest, the fft engine then gives the cost of its transforms
+int measureCosts(int threads, DimEngineCosts *c) {
+    const int radii[] = { DIM_COST_SMALL, DIM_COST_LARGE, DIM_COST_LARGE };
+    const DimEngine engines[] = { DIM_ENGINE_DIRECT, DIM_ENGINE_DIRECT, DIM_ENGINE_FFT };
+    double seconds[3], taps[3], cells = (double)DIM_COST_SIDE*DIM_COST_SIDE;
+    for (int k = 0; k < 3; ++k) {
+        Dimension *dim = CreateDimension(DIM_COST_SIDE, DIM_COST_SIDE, 1, radii[k], .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, radii[k]);
+        if (dim == NULL) { return 1; }
+        setDimensionEngine(dim, engines[k]);
+        setDimensionThreads(dim, threads);
+        setDimensionSeed(dim, 1);
+        randomizeDimensionByKernel(dim);
+        taps[k] = kernelTaps(dim);
+        seconds[k] = timeSteps(dim);
+        DestroyDimension(dim);
+    }
+    c->threads = threads;
+    c->tap = fmax((seconds[1] - seconds[0])/(cells*(taps[1] - taps[0])), 1e-15);
+    c->cell = fmax(seconds[0]/cells - taps[0]*c->tap, 0.);
+    //a forward and an inverse transform of the plane, each a pass over its rows and one over its columns
+    c->butterfly = fmax((seconds[2] - cells*c->cell)/(2.*2.*DIM_COST_SIDE*transformCost(DIM_COST_SIDE)), 1e-15);
+    return 0;
+}
+
+//costs for the thread count, measured on the first call on this machine, NULL if they can't be
+const DimEngineCosts *engineCosts(int threads) {
+    pthread_mutex_lock(&costLock);
+    const DimEngineCosts *found = NULL;
+    for (int k = 0; k < costCount && found == NULL; ++k) { if (costs[k].threads == threads) { found = &costs[k]; } }
+    if (found == NULL && costCount < DIM_COST_THREADS) {
+        DimEngineCosts *c = &costs[costCount];
+        if (loadCosts(threads, c) == 0) {
+            found = &costs[costCount++];
+        } else if (measureCosts(threads, c) == 0) {
+            saveCosts(c);
+            found = &costs[costCount++];
+        }
+    }
+    pthread_mutex_unlock(&costLock);
+    return found;
+}
+
+//measures the costs of the engines for a thread count again, replacing those of the cache
+DIMAPI int calibrateEngines(int threads) {
+    if (threads <= 0) { threads = getCpuCount(); }
+    if (threads > DIM_COST_SIDE) { threads = DIM_COST_SIDE; }
+    DimEngineCosts c;
+    if (measureCosts(threads, &c) != 0) { return 1; }
+    pthread_mutex_lock(&costLock);
+    int k = 0;
+    while (k < costCount && costs[k].threads != threads) { ++k; }
+    if (k < DIM_COST_THREADS) {
+        costs[k] = c;
+        if (k == costCount) { costCount++; }
+    }
+    pthread_mutex_unlock(&costLock);
+    saveCosts(&c);
+    return 0;
+}
+
+//points times levels of a transform of n points, a bluestein one costing two radix 2 ones of its padded length
+double transformCost(int n) {
+    int m = 1;
+    while (m < n) { m *= 2; }
+    if (m == n) { return n*log2((double)n); }
+    while (m < 2*n-1) { m *= 2; }
+    return 2.*m*log2((double)m);
+}
+
+//taps read per cell by the direct engine, the spans of the kernel or of the channel kernels
+int kernelTaps(Dimension *dim) {
+    int taps = 0;
+    if (dim->channels != NULL) {
+        for (int k = 0; k < dim->channels->kernelCount; ++k) {
+            const DimCompiledKernel *shape = dim->channels->kernels[k].shape;
+            int side = 2*shape->radius+1;
+            for (int t = 0; t < side*side; ++t) { taps += shape->raw[t] != 0.f; }
+        }
+        return taps;
+    }
+    for (int k = 0; k < 2*dim->KERNELRAD+1 && dim->spans != NULL; ++k) {
+        if (dim->spans[2*k] <= dim->spans[2*k+1]) { taps += dim->spans[2*k+1] - dim->spans[2*k] + 1; }
+    }
+    return taps;
+}
+
+//predicted seconds of a step of dim with an engine, -1 for the engines the model does not cover
+//the jit engine is counted as the direct one it specializes
+DIMAPI double predictStepTime(Dimension *dim, DimEngine engine) {
+    if (engine != DIM_ENGINE_DIRECT && engine != DIM_ENGINE_JIT && engine != DIM_ENGINE_FFT) { return -1.; }
+    const DimEngineCosts *c = engineCosts(dim->threads);
+    if (c == NULL) { return -1.; }
+    double w = dim->MATRIXWIDTH, h = dim->MATRIXHEIGHT, cells = w*h;
+    if (engine != DIM_ENGINE_FFT) { return cells*(kernelTaps(dim)*c->tap + c->cell); }
+    //the sources go by pairs in the forward transforms, the kernels by pairs in the inverse ones
+    int sources = dim->channels != NULL ? dim->channels->count : 1, kernels = dim->channels != NULL ? dim->channels->kernelCount : 1;
+    double transforms = (sources+1)/2 + (kernels+1)/2;
+    double plane = h*transformCost(dim->MATRIXWIDTH) + w*transformCost(dim->MATRIXHEIGHT);
+    return cells*c->cell*kernels + transforms*plane*c->butterfly;
+}
+
+//everything the choice depends on
+uint64_t engineKey(Dimension *dim) {
+    int shape[] = { dim->MATRIXWIDTH, dim->MATRIXHEIGHT, dim->threads, kernelTaps(dim),
+        dim->channels != NULL ? dim->channels->count : 0, dim->channels != NULL ? dim->channels->kernelCount : 0 };
+    return hashBytes(0xcbf29ce484222325ull, shape, sizeof(shape)) | 1;
+}
+
+//picks the engine of an automatic world before its step, again only when its shape changed
+//$DIM_ENGINE names an engine overriding the model for every automatic world
+void chooseEngine(Dimension *dim) {
+    if (!dim->engineAuto) { return; }
+    uint64_t key = engineKey(dim);
+    if (key == dim->engineKey) { return; }
+    dim->engineKey = key;
+    const char *forced = getenv("DIM_ENGINE");
+    for (int e = 0; forced != NULL && e < DIM_ENGINE_AUTO; ++e) {
+        if (strcmp(forced, getEngineName(e)) != 0) { continue; }
+        dim->engine = e;
+        return;
+    }
+    //an in-place world only has the direct engines, a volume only the transforms
+    if (dim->inPlace || dim->volume != NULL) {
+        dim->engine = dim->inPlace ? DIM_ENGINE_DIRECT : DIM_ENGINE_FFT;
+        return;
+    }
+    double direct = predictStepTime(dim, DIM_ENGINE_DIRECT), fft = predictStepTime(dim, DIM_ENGINE_FFT);
+    dim->engine = direct >= 0. && fft >= 0. && fft < direct ? DIM_ENGINE_FFT : DIM_ENGINE_DIRECT;
+}
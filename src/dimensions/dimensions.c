@@ -1,14 +1,19 @@
-#include "dimensions.h"
+#include "dimpriv.h"
 #include <string.h>
-#include <time.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 int loopback(int value, int max);
 float neighbourSum(Dimension *dim, int x, int y);
-float kernelF(float radius);
 float growth(Dimension *dim, int x, int y);
+float growthValue(Dimension *dim, float sum);
+void convolutionTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void growthTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void swapTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void initCellsTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void doStepReference(Dimension *dim);
+int loadBlobInPlace(Dimension *dim, FILE *fp);
 
 
 //calculate a new index as if the arrays were looping end <=> start
@@ -20,14 +25,22 @@ DIMAPI int loopback(int index, int len) {
 
 //tells wether a cell should be alive or not next gen
 DIMAPI float growth(Dimension *dim, int x, int y) {
-    float sum = neighbourSum(dim, x, y);
+    return growthValue(dim, neighbourSum(dim, x, y));
+}
 
-    //GAUSSIAN
+//growth of a cell from its already computed neighbour sum
+DIMAPI float growthValue(Dimension *dim, float sum) {
     float a = dim->a;
     float b = dim->b;
     float c = dim->c;
     float d = dim->d;
-    float res = a * expf(-(sum-b)*(sum-b)/(2*c*c))+d;
+    float res;
+    if (dim->growthFunction == DIM_GROWTH_CALLBACK) {
+        const float params[4] = { a, b, c, d };
+        res = dim->growthCallback(sum, params, dim->growthUser);
+    } else {
+        res = growthShape(dim->growthFunction, false, sum, a, b, c, d, dim->growthSkew);
+    }
 
     return res*dim->DT;
 }
@@ -45,18 +58,9 @@ DIMAPI float neighbourSum(Dimension *dim, int x, int y) {
 
 //generates the kernel matrix, containing the weight of each cells in the neighbour sum
 DIMAPI void genKernel(Dimension *dim) {
-    for (int i = -dim->KERNELRAD ; i <= dim->KERNELRAD ; ++i){
-        for (int j = -dim->KERNELRAD ; j <= dim->KERNELRAD ; ++j) {
-            float r = sqrtf(i*i+j*j)/dim->KERNELRAD;
-            if (r > 1 || r == 0) {
-                dim->kernel[(i+dim->KERNELRAD)*(2*dim->KERNELRAD+1)+(j+dim->KERNELRAD)] = .0f;
-                continue;
-            }
-            float k = kernelF(r);
-            dim->kernel[(i+dim->KERNELRAD)*(2*dim->KERNELRAD+1)+(j+dim->KERNELRAD)] = k;
-            dim->kSum += k;
-        }
-    }
+    const float one = 1.f;
+    if (dim->kernelShells > 0) { dim->kSum += shellTaps(dim, dim->kernel, dim->KERNELRAD, dim->kernelShells, dim->kernelPeaks); }
+    else { dim->kSum += shellTaps(dim, dim->kernel, dim->KERNELRAD, 1, &one); }
 }
 
 //The function to apply to a cell's radius to get its kernel factor
@@ -64,32 +68,9 @@ DIMAPI float kernelF(float radius) {
     return expf(4*(1-1/(4*radius*(1-radius))));
 }
 
-DIMAPI void randomizeDimensionByKernel(Dimension *dim) {
-    srand(time(0));
-    for(unsigned int i = 0; i < dim->MATRIXWIDTH; ++i) {
-        for(unsigned int j = 0; j < dim->MATRIXHEIGHT; ++j) {
-            dim->matrix[i+j*dim->MATRIXWIDTH].oldState = .0f;
-            dim->matrix[i+j*dim->MATRIXWIDTH].state = .0f;
-            dim->matrixInit[i+j*dim->MATRIXWIDTH].oldState = .0f;
-            dim->matrixInit[i+j*dim->MATRIXWIDTH].state = .0f;
-        }
-    }
-
-    for(unsigned int k = 0; k <= ((float)dim->MATRIXWIDTH*1.f)/((float)dim->KERNELRAD)*dim->RDMDENSITY; ++k) {
-        unsigned int x = ((float)rand()/(float)(RAND_MAX))*((float)dim->MATRIXWIDTH), y = ((float)rand()/(float)(RAND_MAX))*((float)dim->MATRIXHEIGHT);
-        for(int i = 0; i <= dim->patchsize; ++i) {
-            for (int j = 0 ; j <= dim->patchsize ; ++j) {
-                dim->matrix[loopback(x+i, dim->MATRIXHEIGHT-1)+loopback(y+j, dim->MATRIXWIDTH-1)*dim->MATRIXWIDTH].state = ((float)rand()/(float)(RAND_MAX));
-                dim->matrix[loopback(x+i, dim->MATRIXHEIGHT-1)+loopback(y+j, dim->MATRIXWIDTH-1)*dim->MATRIXWIDTH].oldState = ((float)rand()/(float)(RAND_MAX));
-            }
-        }
-    }
-    memcpy(dim->matrixInit, dim->matrix, sizeof(struct Cell)*dim->MATRIXHEIGHT*dim->MATRIXWIDTH);
-}
-
-//return the length of the cell array for the specified dimension
+//return the length of the cell array for the specified dimension, every slice of a volume
 DIMAPI unsigned int getMatrixLength(Dimension *dim) {
-    return dim->MATRIXWIDTH*dim->MATRIXHEIGHT;
+    return dim->MATRIXWIDTH*dim->MATRIXHEIGHT*getMatrixDepth(dim);
 }
 
 DIMAPI Cell *getMatrixInitPointer(Dimension *dim) {
@@ -100,37 +81,140 @@ DIMAPI Cell *getMatrixPointer(Dimension *dim) {
     return dim->matrix;
 }
 
-DIMAPI void noisify(Dimension *dim) {
-	srand(0);
-	for(unsigned int i = 0; i < dim->MATRIXWIDTH; ++i) {
-		for(unsigned int j = 0; j < dim->MATRIXHEIGHT; ++j) {
-			dim->matrix[i+j*dim->MATRIXWIDTH].state += (((float)rand())/((float)RAND_MAX)*2.f - 1.f)*dim->noisefactor;
-		}
-	}
+//neighbour sums of the outputs [x0, x1) of the rows [y0, y1) from oldState, ctx pointing to the range
+void convolutionTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimConvRange *range = ctx;
+    for(int j = y0; j < y1; ++j) {
+        for(int i = range->x0; i < range->x1; ++i) {
+            dim->sums[i+j*dim->MATRIXWIDTH] = neighbourSum(dim, i, j);
+        }
+    }
 }
 
-//simulation step
-DIMAPI void doStep(Dimension *dim) {
+//calculate state of the rows [y0, y1) from the sums
+//ctx may point to a growth row replacing the one of the growth mode
+void growthTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimGrowthRow row = ctx != NULL ? *(DimGrowthRow *)ctx : NULL;
+    for(int j = y0; j < y1; ++j) {
+        if (row != NULL) { row(&dim->sums[j*dim->MATRIXWIDTH], &dim->matrix[j*dim->MATRIXWIDTH], dim->MATRIXWIDTH); }
+        else { growthRow(dim, &dim->sums[j*dim->MATRIXWIDTH], &dim->matrix[j*dim->MATRIXWIDTH], dim->MATRIXWIDTH); }
+    }
+}
+
+void swapTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    for(int j = y0; j < y1; ++j) {
+        swapRow(dim, j);
+    }
+}
+
+//cells of the band at their place and dead, matrixInit being a copy of them
+void initCellsTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    for(int j = y0; j < y1; ++j) {
+        for(int i = 0; i < dim->MATRIXWIDTH; ++i) {
+            Cell *cell = &dim->matrix[i+j*dim->MATRIXWIDTH];
+            cell->x = 2.f*(i+.5f)/(dim->MATRIXWIDTH)-1.f;
+            cell->y = 1.f-2.f*(j+.5f)/(dim->MATRIXHEIGHT);
+            cell->state = .0f;
+            cell->oldState = .0f;
+            dim->matrixInit[i+j*dim->MATRIXWIDTH] = *cell;
+        }
+    }
+}
+
+//original step, single threaded and column by column, its whole loop is timed as convolution
+void doStepReference(Dimension *dim) {
+    double t = dimClock();
+    DIM_TRACE_BEGIN("reference");
     //calculate state from oldState
     for(unsigned int i = 0; i < dim->MATRIXWIDTH; ++i) {
         for(unsigned int j = 0; j < dim->MATRIXHEIGHT; ++j) {
-            //DEBUG printf("%f => ", matrix[i][j].state);
             dim->matrix[i+j*dim->MATRIXWIDTH].state += growth(dim, i, j);
-            //DEBUG printf("%f => ", matrix[i][j].state);
             if(dim->matrix[i+j*dim->MATRIXWIDTH].state > 1.f) { dim->matrix[i+j*dim->MATRIXWIDTH].state = 1.f; }
             if(dim->matrix[i+j*dim->MATRIXWIDTH].state < 0.f) { dim->matrix[i+j*dim->MATRIXWIDTH].state = 0.f; }
-            //DEBUG printf("%f\n", matrix[i][j].state);
         }
     }
+    t = lapPhase(dim, DIM_PHASE_CONVOLUTION, t);
+    DIM_TRACE_END("reference");
     //switch them
-    for(unsigned int i = 0; i < dim->MATRIXWIDTH; ++i) {
-        for(unsigned int j = 0; j < dim->MATRIXHEIGHT; ++j) {
-            dim->matrix[i+j*dim->MATRIXWIDTH].oldState = dim->matrix[i+j*dim->MATRIXWIDTH].state;
-        }
+    swapTask(dim, NULL, 0, dim->MATRIXHEIGHT, 0);
+    lapPhase(dim, DIM_PHASE_SWAP, t);
+}
+
+//simulation step, each pass is split in row bands over the threads of dim
+DIMAPI void doStep(Dimension *dim) {
+    chooseEngine(dim);
+    if (dim->volume != NULL) {
+        doStepVolume(dim);
+    } else if (dim->inPlace) {
+        doStepInPlace(dim);
+    } else if (dim->channels != NULL) {
+        doStepChannels(dim);
+    } else if (dim->engine == DIM_ENGINE_REFERENCE) {
+        doStepReference(dim);
+    } else {
+        convolveDimensionRows(dim, 0, dim->MATRIXHEIGHT);
+        growDimensionRows(dim, 0, dim->MATRIXHEIGHT);
+    }
+    stepNoise(dim);
+}
+
+//first half of a step : the neighbour sums of the rows [y0, y1) from the current states
+//the rows of a step can be convolved in several calls, e.g. while the halos of a distributed block are in flight,
+//as long as no row is grown before every row reading it is convolved
+DIMAPI void convolveDimensionRows(Dimension *dim, int y0, int y1) {
+    convolveDimensionRegion(dim, 0, dim->MATRIXWIDTH, y0, y1);
+}
+
+//neighbour sums of the cells [x0, x1) of the rows [y0, y1), the other sums of the rows are left as they are
+//the columns of the rows can be convolved in several calls too, e.g. the ones away from the column halos first
+DIMAPI void convolveDimensionRegion(Dimension *dim, int x0, int x1, int y0, int y1) {
+    if (dim->inPlace || dim->channels != NULL || dim->volume != NULL) {
+        fprintf(stderr, "An in-place, multi-channel or volumetric world can only be stepped whole\n");
+        return;
     }
+    if (x0 < 0) { x0 = 0; }
+    if (x1 > dim->MATRIXWIDTH) { x1 = dim->MATRIXWIDTH; }
+    if (x0 >= x1) { return; }
+    DimConvRange range = { dim->convRow, x0, x1 };
+    DimGrowthRow growthRow = NULL;
+    //rebuilt only when a constant changed, otherwise the direct rows are kept
+    if (dim->engine == DIM_ENGINE_JIT && buildDimensionJIT(dim) == 0) { getJITRows(dim, &range.convRow, &growthRow); }
+
+    double t = dimClock();
+    //the transforms cover the whole plane, a part of it is convolved directly
+    bool whole = x0 == 0 && x1 == dim->MATRIXWIDTH && y0 == 0 && y1 == dim->MATRIXHEIGHT;
+    if (dim->engine == DIM_ENGINE_FFT && whole && fftSums(dim) == 0) {
+        lapPhase(dim, DIM_PHASE_CONVOLUTION, t);
+        return;
+    }
+    //the ring path decodes each source row once, the per cell path serves the reference engine
+    //and when the ring buffers can't be allocated
+    if (dim->engine != DIM_ENGINE_REFERENCE && prepareScratch(dim) == 0) {
+        parallelRange(dim, "convolution", convolutionRingTask, &range, y0, y1);
+    } else {
+        parallelRange(dim, "convolution", convolutionTask, &range, y0, y1);
+    }
+    lapPhase(dim, DIM_PHASE_CONVOLUTION, t);
+}
+
+//second half of a step : growth of the rows [y0, y1) from their sums, then the swap making them the current states
+DIMAPI void growDimensionRows(Dimension *dim, int y0, int y1) {
+    if (dim->inPlace || dim->channels != NULL || dim->volume != NULL) { return; }
+    DimConvRow convRow = dim->convRow;
+    DimGrowthRow growthRow = NULL;
+    if (dim->engine == DIM_ENGINE_JIT && buildDimensionJIT(dim) == 0) { getJITRows(dim, &convRow, &growthRow); }
+
+    double t = dimClock();
+    prepareGrowth(dim);
+    parallelRange(dim, "growth", growthTask, &growthRow, y0, y1);
+    t = lapPhase(dim, DIM_PHASE_GROWTH, t);
+    //switch them
+    parallelRange(dim, "swap", swapTask, NULL, y0, y1);
+    lapPhase(dim, DIM_PHASE_SWAP, t);
 }
 
 DIMAPI void printMatrix(Dimension *dim) {
+    if (dim->inPlace) { return; }
     printf("[");
     for(unsigned int i = 0; i < dim->MATRIXWIDTH-2; ++i) {
         printf("[");
@@ -147,38 +231,183 @@ DIMAPI void printMatrix(Dimension *dim) {
 }
 
 DIMAPI Dimension *CreateDimension(int w, int h, int cs, int kr, float dt, float rdmd, float a, float b, float c, float d, float nf, int ps) {
-    static Dimension dim;
-    dim.MATRIXWIDTH = w;
-    dim.MATRIXHEIGHT = h;
-    dim.CELLSIZE = cs;
-    dim.KERNELRAD = kr;
-    dim.DT = dt;
-    dim.RDMDENSITY = rdmd;
-    dim.a = a;
-    dim.b = b;
-    dim.c = c;
-    dim.d = d;
-    dim.matrix = malloc(w*h*sizeof(struct Cell));
-    dim.matrixInit = malloc(w*h*sizeof(struct Cell));
-    dim.kernel = malloc((2*kr+1)*(2*kr+1)*sizeof(float));
-    dim.noisefactor = nf;
-    dim.patchsize = ps;
+    Dimension *dim = calloc(1, sizeof(Dimension));
+    if (dim == NULL) { return NULL; }
+    dim->MATRIXWIDTH = w;
+    dim->MATRIXHEIGHT = h;
+    dim->CELLSIZE = cs;
+    dim->KERNELRAD = kr;
+    dim->DT = dt;
+    dim->RDMDENSITY = rdmd;
+    dim->a = a;
+    dim->b = b;
+    dim->c = c;
+    dim->d = d;
+    dim->noisefactor = nf;
+    dim->patchsize = ps;
+    dim->threads = 1;
+    dim->engine = DIM_ENGINE_DIRECT;
+    dim->engineAuto = 1;
+    dim->seed = defaultSeed();
+    //the pinned workers, if any, first touch the bands they step
+    startPlacedPool(dim);
+    dim->matrix = dimAlloc((size_t)w*h*sizeof(struct Cell));
+    dim->matrixInit = dimAlloc((size_t)w*h*sizeof(struct Cell));
+    dim->kernel = dimAlloc((2*kr+1)*(2*kr+1)*sizeof(float));
+    dim->sums = placedCalloc(dim, 1, h, (size_t)w*sizeof(float));
+    if (dim->matrix == NULL || dim->matrixInit == NULL || dim->kernel == NULL || dim->sums == NULL) {
+        fprintf(stderr, "Failed to allocate a %dx%d dimension\n", w, h);
+        DestroyDimension(dim);
+        return NULL;
+    }
 
     //matrix and matrixInit initialization
-    for(unsigned int i = 0; i < dim.MATRIXWIDTH; ++i) {
-        for(unsigned int j = 0; j < dim.MATRIXHEIGHT; ++j) {
-            dim.matrix[i+j*dim.MATRIXWIDTH].x = 2.f*(i+.5f)/(dim.MATRIXWIDTH)-1.f;
-            dim.matrix[i+j*dim.MATRIXWIDTH].y = 1.f-2.f*(j+.5f)/(dim.MATRIXHEIGHT);
-            dim.matrix[i+j*dim.MATRIXWIDTH].state = .0f;
-            dim.matrix[i+j*dim.MATRIXWIDTH].oldState = .0f;
+    parallelRows(dim, "init", initCellsTask, NULL);
+
+    //Kernel initialization
+    genKernel(dim);
+    genSpans(dim);
+    if (dim->spans == NULL) {
+        DestroyDimension(dim);
+        return NULL;
+    }
+
+    return dim;
+}
+
+DIMAPI void DestroyDimension(Dimension *dim) {
+    if (dim == NULL) { return; }
+    destroyPool(dim);
+    dimFree(dim->matrix);
+    dimFree(dim->matrixInit);
+    dimFree(dim->kernel);
+    dimFree(dim->sums);
+    free(dim->growthLUT);
+    dimFree(dim->plane);
+    free(dim->tileOrder);
+    free(dim->spans);
+    freeScratch(dim);
+    freeJIT(dim);
+    freeInPlace(dim);
+    freeNoise(dim);
+    freeChannels(dim);
+    freeSpectra(dim);
+    freeKernelCache(dim);
+    freeVolume(dim);
+    free(dim);
+}
+
+//any engine but DIM_ENGINE_AUTO overrides the choice of the cost model until the next call with DIM_ENGINE_AUTO
+DIMAPI void setDimensionEngine(Dimension *dim, DimEngine engine) {
+    if (engine >= DIM_ENGINE_COUNT) { return; }
+    dim->engineAuto = engine == DIM_ENGINE_AUTO;
+    dim->engineKey = 0;
+    if (engine != DIM_ENGINE_AUTO) { dim->engine = engine; }
+}
+
+//DIM_ENGINE_AUTO when the cost model picks the engine, see getStepEngine for its pick
+DIMAPI DimEngine getDimensionEngine(Dimension *dim) {
+    return dim->engineAuto ? DIM_ENGINE_AUTO : dim->engine;
+}
+
+//engine the next step will use
+DIMAPI DimEngine getStepEngine(Dimension *dim) {
+    chooseEngine(dim);
+    return dim->engine;
+}
+
+DIMAPI const char *getEngineName(DimEngine engine) {
+    switch (engine) {
+        case DIM_ENGINE_REFERENCE: return "reference";
+        case DIM_ENGINE_DIRECT: return "direct";
+        case DIM_ENGINE_JIT: return "jit";
+        case DIM_ENGINE_FFT: return "fft";
+        case DIM_ENGINE_AUTO: return "auto";
+        default: return "unknown";
+    }
+}
+
+//copies the current and initial states of src into dst, both having the same size
+//an in-place world only has current states, copying from it sets both state and oldState
+//a volume is only copied to a volume of the same depth
+DIMAPI void copyDimensionState(Dimension *dst, Dimension *src) {
+    if (getMatrixDepth(dst) != getMatrixDepth(src) || (dst->volume == NULL) != (src->volume == NULL)) {
+        fprintf(stderr, "Failed to copy a %d deep dimension to a %d deep one\n", getMatrixDepth(src), getMatrixDepth(dst));
+        return;
+    }
+    if (dst->volume != NULL) {
+        for (int z = 0; z < getMatrixDepth(src); ++z) { setVolumeSlice(dst, z, volumeRow(src, (size_t)z*src->MATRIXHEIGHT)); }
+        return;
+    }
+    if (!dst->inPlace && !src->inPlace) {
+        memcpy(dst->matrix, src->matrix, sizeof(struct Cell)*getMatrixLength(src));
+        memcpy(dst->matrixInit, src->matrixInit, sizeof(struct Cell)*getMatrixLength(src));
+        syncDimension(dst);
+        return;
+    }
+    float *row = malloc(src->MATRIXWIDTH*sizeof(float));
+    if (row == NULL) { return; }
+    for (int j = 0; j < src->MATRIXHEIGHT; ++j) {
+        getStateRow(src, j, row);
+        if (dst->inPlace) {
+            for (int i = 0; i < src->MATRIXWIDTH; ++i) { row[i] = quantizeState(dst->storage, row[i]); }
+            encodeRow(dst, j, row);
+            continue;
         }
+        Cell *cells = &dst->matrix[(size_t)j*dst->MATRIXWIDTH];
+        for (int i = 0; i < src->MATRIXWIDTH; ++i) { cells[i].state = cells[i].oldState = row[i]; }
     }
-    memcpy(dim.matrixInit, dim.matrix, w*h*sizeof(struct Cell));
+    free(row);
+    if (!dst->inPlace) {
+        syncDimension(dst);
+        memcpy(dst->matrixInit, dst->matrix, sizeof(struct Cell)*getMatrixLength(dst));
+    }
+}
 
-    //Kernel initialization
-    genKernel(&dim);
+//number of cells stored in a .blob save, -1 if it can't be read
+DIMAPI long getBlobLength(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) { return -1; }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size < 0 ? -1 : size/(long)sizeof(struct Cell);
+}
 
-    return &dim;
+//loads a .blob save (as written by the viewers) as both the current and the initial state
+DIMAPI int loadDimensionBlob(Dimension *dim, const char *path) {
+    if (getBlobLength(path) != (long)getMatrixLength(dim)) {
+        fprintf(stderr, "\"%s\" is not a %dx%d save\n", path, dim->MATRIXWIDTH, dim->MATRIXHEIGHT);
+        return 1;
+    }
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) { return 1; }
+    if (dim->inPlace || dim->volume != NULL) { return loadBlobInPlace(dim, fp); }
+    size_t read = fread(dim->matrix, sizeof(struct Cell), getMatrixLength(dim), fp);
+    fclose(fp);
+    if (read != getMatrixLength(dim)) { return 1; }
+    syncDimension(dim);
+    memcpy(dim->matrixInit, dim->matrix, sizeof(struct Cell)*getMatrixLength(dim));
+    return 0;
+}
+
+//reads the blob a row of cells at a time, keeping their state, the slices of a volume one after the other
+int loadBlobInPlace(Dimension *dim, FILE *fp) {
+    Cell *cells = malloc(dim->MATRIXWIDTH*sizeof(struct Cell));
+    float *row = malloc(dim->MATRIXWIDTH*sizeof(float));
+    int failed = cells == NULL || row == NULL;
+    for (int j = 0; j < dim->MATRIXHEIGHT*getMatrixDepth(dim) && !failed; ++j) {
+        if (fread(cells, sizeof(struct Cell), dim->MATRIXWIDTH, fp) != (size_t)dim->MATRIXWIDTH) {
+            failed = 1;
+            break;
+        }
+        for (int i = 0; i < dim->MATRIXWIDTH; ++i) { row[i] = quantizeState(dim->storage, cells[i].state); }
+        setStateRow(dim, j, row);
+    }
+    fclose(fp);
+    free(cells);
+    free(row);
+    return failed;
 }
 
 DIMAPI unsigned int getDimensionCellSize(Dimension *dim) {
@@ -24,10 +24,114 @@
 #  endif
 #endif
 
+#include <stdio.h>
+#include <stdint.h>
+
 typedef struct Cell {
     float x, y, state, oldState;
 } Cell;
 
+//stages timed by libdimensions, upload and draw are reported by the viewers
+typedef enum DimPhase {
+    DIM_PHASE_CONVOLUTION,
+    DIM_PHASE_GROWTH,
+    DIM_PHASE_SWAP,
+    DIM_PHASE_NOISE,
+    DIM_PHASE_RANDOMIZE,
+    DIM_PHASE_UPLOAD,
+    DIM_PHASE_DRAW,
+    DIM_PHASE_JIT,
+    DIM_PHASE_BLOCKED,
+    DIM_PHASE_COUNT
+} DimPhase;
+
+//ways of computing doStep, every engine must match the reference within tolerance
+typedef enum DimEngine {
+    DIM_ENGINE_REFERENCE, //the original serial scalar loop, kept as ground truth
+    DIM_ENGINE_DIRECT,    //direct convolution split over the pool workers
+    DIM_ENGINE_JIT,       //direct engine with rows compiled at run time for the world's constants
+    DIM_ENGINE_FFT,       //convolution through transforms of the whole plane, its cost does not grow with the radius
+    DIM_ENGINE_AUTO,      //direct or fft, whichever the cost model measured on this machine predicts faster
+    DIM_ENGINE_COUNT
+} DimEngine;
+
+//how the growth function is evaluated by the direct engine
+typedef enum DimGrowthMode {
+    DIM_GROWTH_EXACT,   //expf, as the reference
+    DIM_GROWTH_LUT,     //linear interpolation in a table sampled over sums in [0, 1]
+    DIM_GROWTH_FASTEXP  //polynomial exp approximation, vectorizable
+} DimGrowthMode;
+
+//shape of the growth of a cell from its neighbour sum u, selected per Dimension with setGrowthFunction
+typedef enum DimGrowthFunction {
+    DIM_GROWTH_GAUSSIAN,   //a*exp(-(u-b)^2/(2c^2))+d, the original
+    DIM_GROWTH_POLYNOMIAL, //a*max(0, 1-(u-b)^2/(9c^2))^4+d, a bump of about the gaussian's width without exp
+    DIM_GROWTH_STEP,       //a+d where |u-b| <= c, d elsewhere
+    DIM_GROWTH_ASYMMETRIC, //gaussian of deviation c below b and c*skew above
+    DIM_GROWTH_CALLBACK,   //a DimGrowthCallback, called for every cell
+    DIM_GROWTH_FUNCTION_COUNT
+} DimGrowthFunction;
+
+//shape of the kernel, or of each of its shells, at the relative radius r in (0, 1)
+typedef enum DimKernelFunction {
+    DIM_KERNEL_EXPONENTIAL, //exp(4-1/(r(1-r))), kernelF, the original
+    DIM_KERNEL_POLYNOMIAL,  //(4r(1-r))^4
+    DIM_KERNEL_STEP,        //1 over [1/4, 3/4]
+    DIM_KERNEL_CALLBACK,    //a DimKernelCallback
+    DIM_KERNEL_FUNCTION_COUNT
+} DimKernelFunction;
+
+//growth of a sum before the time step, params being a, b, c and d of the world or of the channel kernel
+typedef float (*DimGrowthCallback)(float sum, const float *params, void *user);
+//kernel value at the relative radius r in (0, 1), called once per tap when the kernel is made
+typedef float (*DimKernelCallback)(float r, void *user);
+
+//precision of the states of an in-place world, whose packed plane is its only copy of them, the sums are always float
+//a world with cells keeps its 16 byte cells for the growth, the swap and the renderers, it only stores float32
+typedef enum DimStorage {
+    DIM_STORAGE_FLOAT32, //the cells' oldState, or the float plane of an in-place world
+    DIM_STORAGE_FLOAT16, //ieee half floats
+    DIM_STORAGE_FIXED16, //16 bit fixed point over [0, 1]
+    DIM_STORAGE_UINT8    //8 bit fixed point over [0, 1]
+} DimStorage;
+
+//page size of the large world buffers
+typedef enum DimHugePages {
+    DIM_HUGE_PAGES_AUTO,        //explicit huge pages when some are reserved, else transparent ones
+    DIM_HUGE_PAGES_TRANSPARENT, //small pages the kernel is advised to merge
+    DIM_HUGE_PAGES_EXPLICIT,    //MAP_HUGETLB, falling back to transparent pages with a warning
+    DIM_HUGE_PAGES_NONE         //heap buffers
+} DimHugePages;
+
+//which cpus the workers of a Dimension run on
+typedef enum DimAffinity {
+    DIM_AFFINITY_NONE,    //left to the scheduler, the world stays where it was first touched
+    DIM_AFFINITY_COMPACT, //one cpu per worker, filling a numa node before the next
+    DIM_AFFINITY_SCATTER  //one cpu per worker, dealt out across the numa nodes
+} DimAffinity;
+
+//noise added by noisify
+typedef enum DimNoise {
+    DIM_NOISE_UNIFORM,   //white, uniform in [-noisefactor, noisefactor]
+    DIM_NOISE_GAUSSIAN,  //white, normal of deviation noisefactor
+    DIM_NOISE_CORRELATED //normal of deviation noisefactor, smoothed by a gaussian of the noise length
+} DimNoise;
+
+//order of the cells in the state plane
+typedef enum DimLayout {
+    DIM_LAYOUT_ROWS,  //row-major
+    DIM_LAYOUT_MORTON //square tiles of DIM_TILE_SIDE cells along a Z curve, row-major inside a tile
+} DimLayout;
+
+//concentric shells of a kernel at most, the Lenia beta parameterization
+#define DIM_MAX_SHELLS 8
+
+struct DimPool;
+struct DimScratch;
+struct DimChannels;
+struct DimSpectra;
+struct DimKernelCache;
+
 typedef struct Dimension {
     int MATRIXWIDTH;
     int MATRIXHEIGHT;
@@ -45,11 +149,98 @@ typedef struct Dimension {
     float d;
     float noisefactor;
     int patchsize;
+    float *sums;
+    double phaseTime[DIM_PHASE_COUNT];
+    unsigned long phaseCount[DIM_PHASE_COUNT];
+    int threads;
+    struct DimPool *pool;
+    DimAffinity affinity;
+    DimEngine engine;  //engine stepping the world, picked before each step while engineAuto is set
+    int engineAuto;
+    uint64_t engineKey; //shape of the world the automatic choice was made for
+    DimGrowthMode growthMode;
+    float *growthLUT;
+    int growthLUTSize;
+    float growthLUTError;
+    float growthLUTParams[5]; //a, b, c, d and DT the table was sampled with
+    DimGrowthFunction growthFunction;
+    float growthSkew; //width above b over width below b of the asymmetric growth
+    DimGrowthCallback growthCallback;
+    void *growthUser;
+    DimKernelFunction kernelFunction;
+    DimKernelCallback kernelCallback;
+    void *kernelUser;
+    DimStorage storage;
+    void *plane; //oldState packed in the storage format, NULL for float32 rows
+    DimLayout layout;
+    int *tileOrder; //rank of each tile of the plane along the Z curve, NULL for the row layout
+    int *spans;  //first and last non zero tap of each kernel row
+    void (*convRow)(struct Dimension *dim, const float **rows, float *out); //row convolution for this kernel
+    struct DimScratch *scratch;
+    int scratchCount;
+    struct DimJIT *jit;
+    int tileRows; //rows of the temporal tiles of doSteps, 0 to size them from the cache budget
+    int blockDepth; //generations per pass of doSteps, 0 for all of them in one
+    int inPlace;  //no cells, the plane is the only copy of the states and is overwritten by the sweep
+    float *halo;  //edge rows of every band saved before an in-place sweep
+    const float **haloRows; //saved copy of each grid row, NULL for rows far from the band edges
+    uint64_t seed;  //randomize and noisify draw from counter based streams of it, whatever the thread count
+    uint64_t draws; //streams already used
+    DimNoise noise;
+    float noiseLength; //deviation in cells of the smoothing of correlated noise
+    int stepNoise;     //generations between two noisify of doStep, 0 for none
+    int stepNoiseClock;
+    struct DimNoiseField *noiseField;
+    struct DimChannels *channels; //states and kernels of a multi-channel world, NULL when dim->kernel grows the cells
+    struct DimSpectra *spectra;   //planes of the fft engine
+    struct DimKernelCache *kernelCache; //taps of every kernel shape used so far and their spectra
+    int kernelShells;             //shells of dim->kernel, 0 for the single bump of kernelF
+    float kernelPeaks[DIM_MAX_SHELLS];
+    struct DimVolume *volume;     //states and transforms of a volumetric world, NULL for a plane
 } Dimension;
 
+//binary export of the state plane, one frame per generation
+typedef enum DimStreamFormat {
+    DIM_STREAM_RAW, //bare frames, back to back
+    DIM_STREAM_NPY  //each frame is a standalone .npy record
+} DimStreamFormat;
+
+typedef enum DimStreamType {
+    DIM_STREAM_FLOAT32,
+    DIM_STREAM_UINT8
+} DimStreamType;
+
+typedef struct DimStream {
+    FILE *fp;
+    int ownsFile;
+    DimStreamFormat format;
+    DimStreamType type;
+    char *buffer;
+    unsigned char *frame;
+    size_t frameSize;
+    unsigned long frames;
+} DimStream;
+
+//chrome trace events, the flag is tested inline so disabled tracing costs a single branch
+DIMAPI int dimTraceOn;
+#define DIM_TRACE_BEGIN(name) do { if (dimTraceOn) { traceEvent(name, 'B'); } } while (0)
+#define DIM_TRACE_END(name) do { if (dimTraceOn) { traceEvent(name, 'E'); } } while (0)
+
 DIMAPI Dimension *CreateDimension(int w, int h, int cs, int kr, float dt, float rdmd, float a, float b, float c, float d, float nf, int ps);
+DIMAPI Dimension *CreateInPlaceDimension(int w, int h, int kr, float dt, float rdmd, float a, float b, float c, float d, float nf, int ps, DimStorage storage);
+DIMAPI Dimension *CreateVolumeDimension(int w, int h, int depth, int kr, float dt, float rdmd, float a, float b, float c, float d, float nf, int ps);
+DIMAPI void DestroyDimension(Dimension *dim);
 DIMAPI void printMatrix(Dimension *dim);
 DIMAPI void doStep(Dimension *dim);
+DIMAPI void doSteps(Dimension *dim, int n);
+DIMAPI void convolveDimensionRows(Dimension *dim, int y0, int y1);
+DIMAPI void convolveDimensionRegion(Dimension *dim, int x0, int x1, int y0, int y1);
+DIMAPI void growDimensionRows(Dimension *dim, int y0, int y1);
+DIMAPI void setTileRows(Dimension *dim, int rows);
+DIMAPI int getTileRows(Dimension *dim);
+DIMAPI void setBlockDepth(Dimension *dim, int depth);
+DIMAPI int getBlockDepth(Dimension *dim);
+DIMAPI int tuneDimension(Dimension *dim, double seconds, int force);
 DIMAPI void genKernel(Dimension *dim);
 DIMAPI unsigned int getMatrixLength(Dimension *dim);
 DIMAPI void randomizeDimensionByKernel(Dimension *dim);
@@ -58,6 +249,78 @@ DIMAPI Cell *getMatrixInitPointer(Dimension *dim);
 DIMAPI unsigned int getDimensionCellSize(Dimension *dim);
 DIMAPI unsigned int getMatrixWidth(Dimension *dim);
 DIMAPI unsigned int getMatrixHeight(Dimension *dim);
+DIMAPI int getMatrixDepth(Dimension *dim);
+DIMAPI int getVolumeSlice(Dimension *dim, int z, float *dst);
+DIMAPI int setVolumeSlice(Dimension *dim, int z, const float *src);
 DIMAPI void noisify(Dimension *dim);
+DIMAPI void setDimensionSeed(Dimension *dim, uint64_t seed);
+DIMAPI uint64_t getDimensionSeed(Dimension *dim);
+DIMAPI int setNoise(Dimension *dim, DimNoise kind, float length);
+DIMAPI DimNoise getNoise(Dimension *dim);
+DIMAPI void setStepNoise(Dimension *dim, int every);
+DIMAPI int getStepNoise(Dimension *dim);
+DIMAPI int setDimensionChannels(Dimension *dim, int channels);
+DIMAPI int getDimensionChannels(Dimension *dim);
+DIMAPI int addChannelKernel(Dimension *dim, int source, int target, int radius, float weight, float a, float b, float c, float d);
+DIMAPI void clearChannelKernels(Dimension *dim);
+DIMAPI int getChannelKernelCount(Dimension *dim);
+DIMAPI int setKernelShells(Dimension *dim, int count, const float *peaks);
+DIMAPI int setChannelKernelShells(Dimension *dim, int kernel, int count, const float *peaks);
+DIMAPI void getChannelRow(Dimension *dim, int channel, int y, float *dst);
+DIMAPI void setChannelRow(Dimension *dim, int channel, int y, const float *src);
+DIMAPI DimStream *openDimStream(const char *path, DimStreamFormat format, DimStreamType type);
+DIMAPI DimStream *openDimStreamFile(FILE *fp, DimStreamFormat format, DimStreamType type);
+DIMAPI int writeDimStream(DimStream *stream, Dimension *dim);
+DIMAPI int writeDimStreamSlice(DimStream *stream, Dimension *dim, int z);
+DIMAPI void closeDimStream(DimStream *stream);
+DIMAPI double dimClock(void);
+DIMAPI void addPhaseTime(Dimension *dim, DimPhase phase, double seconds);
+DIMAPI double lapPhase(Dimension *dim, DimPhase phase, double start);
+DIMAPI double getPhaseTime(Dimension *dim, DimPhase phase);
+DIMAPI unsigned long getPhaseCount(Dimension *dim, DimPhase phase);
+DIMAPI const char *getPhaseName(DimPhase phase);
+DIMAPI void resetPhaseTimes(Dimension *dim);
+DIMAPI int dumpPhaseTimesCSV(Dimension *dim, FILE *fp);
+DIMAPI int startTrace(const char *path);
+DIMAPI int stopTrace(void);
+DIMAPI void traceEvent(const char *name, char phase);
+DIMAPI int getCpuCount(void);
+DIMAPI void setDimensionThreads(Dimension *dim, int n);
+DIMAPI int getDimensionThreads(Dimension *dim);
+DIMAPI void setDimensionAffinity(Dimension *dim, DimAffinity policy);
+DIMAPI DimAffinity getDimensionAffinity(Dimension *dim);
+DIMAPI void setDefaultAffinity(DimAffinity policy, int threads);
+DIMAPI DimAffinity getDefaultAffinity(void);
+DIMAPI void setDimensionEngine(Dimension *dim, DimEngine engine);
+DIMAPI DimEngine getDimensionEngine(Dimension *dim);
+DIMAPI const char *getEngineName(DimEngine engine);
+DIMAPI DimEngine getStepEngine(Dimension *dim);
+DIMAPI double predictStepTime(Dimension *dim, DimEngine engine);
+DIMAPI int calibrateEngines(int threads);
+DIMAPI int buildDimensionJIT(Dimension *dim);
+DIMAPI void copyDimensionState(Dimension *dst, Dimension *src);
+DIMAPI void setGrowthMode(Dimension *dim, DimGrowthMode mode);
+DIMAPI int setGrowthLUT(Dimension *dim, int resolution, float maxError);
+DIMAPI int setGrowthFunction(Dimension *dim, DimGrowthFunction function, float skew);
+DIMAPI void setGrowthCallback(Dimension *dim, DimGrowthCallback callback, void *user);
+DIMAPI DimGrowthFunction getGrowthFunction(Dimension *dim);
+DIMAPI const char *getGrowthFunctionName(DimGrowthFunction function);
+DIMAPI int findGrowthFunction(const char *name);
+DIMAPI int setKernelFunction(Dimension *dim, DimKernelFunction function);
+DIMAPI int setKernelCallback(Dimension *dim, DimKernelCallback callback, void *user);
+DIMAPI DimKernelFunction getKernelFunction(Dimension *dim);
+DIMAPI const char *getKernelFunctionName(DimKernelFunction function);
+DIMAPI int findKernelFunction(const char *name);
+DIMAPI int setStateStorage(Dimension *dim, DimStorage storage);
+DIMAPI DimStorage getStateStorage(Dimension *dim);
+DIMAPI int setStateLayout(Dimension *dim, DimLayout layout);
+DIMAPI DimLayout getStateLayout(Dimension *dim);
+DIMAPI void setHugePages(DimHugePages mode);
+DIMAPI DimHugePages getHugePages(void);
+DIMAPI void syncDimension(Dimension *dim);
+DIMAPI void getStateRow(Dimension *dim, int y, float *dst);
+DIMAPI void setStateRow(Dimension *dim, int y, const float *src);
+DIMAPI long getBlobLength(const char *path);
+DIMAPI int loadDimensionBlob(Dimension *dim, const char *path);
 
 #endif // __dim_h_
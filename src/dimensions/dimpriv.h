@@ -0,0 +1,400 @@
+#ifndef __dimpriv_h_
+#define __dimpriv_h_
+
+//declarations shared between the translation units of libdimensions, not part of the api
+
+#include "dimensions.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//outputs accumulated together by the row convolutions
+#define DIM_CONV_BLOCK 32
+//outputs of each of the two rows accumulated together by convRowPair
+#define DIM_PAIR_BLOCK 16
+//portable vector of the gcc and clang extensions, the compiler picks the instructions
+#define DIM_VEC_WIDTH 4
+typedef float DimVec __attribute__((vector_size(DIM_VEC_WIDTH*sizeof(float))));
+//alignment of the world buffers, a cache line and the widest vector loads
+#define DIM_ALIGN 64
+//buffers from this size are mapped, on huge pages if possible
+#define DIM_HUGE_PAGE (2u<<20)
+//cells per side of the tiles of the morton layout
+#define DIM_TILE_SIDE 16
+
+//kernels of a multi-channel world convolved together over a pass on their source channel
+#define DIM_GROUP_KERNELS 8
+//kernel spectra kept by a dimension, the least recently used goes first
+#define DIM_SPECTRA_CACHE 16
+//lines gathered together by the column and depth passes of the transforms, 16 complex are two cache lines of a row
+#define DIM_FFT_COLUMNS 16
+
+//neighbour sums of an output row from the haloed source rows around it
+typedef void (*DimConvRow)(Dimension *dim, const float **rows, float *out);
+//growth of n cells from their neighbour sums
+typedef void (*DimGrowthRow)(const float *sums, Cell *cells, int n);
+
+//outputs [x0, x1) of the rows convolved by convolutionRingTask or convolutionTask, with the row convolution to use
+typedef struct DimConvRange {
+    DimConvRow convRow;
+    int x0, x1;
+} DimConvRange;
+
+//per worker buffers : a ring of the 2R+1 source rows around the current one, each with R halo cells on both sides
+//and two output rows for the convolutions of a part of the columns, then the planes of the temporal tiles
+typedef struct DimScratch {
+    float *ring;
+    const float **rows;
+    size_t capacity;
+    float *tile;
+    size_t tileCapacity;
+} DimScratch;
+
+//row convolution generated for a radius, usable when the kernel's taps fit in the disc spans
+typedef struct DimConvSpec {
+    int radius;
+    const int *spans;
+    DimConvRow convRow;
+} DimConvSpec;
+
+extern const DimConvSpec convSpecs[];
+
+//taps of a kernel shape, computed once per dimension and kept until it is destroyed
+typedef struct DimCompiledKernel {
+    int radius;
+    int shells;
+    float peaks[DIM_MAX_SHELLS];
+    float *raw;  //(2R+1)^2 as the shells give them
+    float sum;
+    float *taps; //normalized, summing to one
+    DimKernelFunction function; //of the shells, with the callback and its data when it is DIM_KERNEL_CALLBACK
+    DimKernelCallback callback;
+    void *user;
+    struct DimCompiledKernel *next;
+} DimCompiledKernel;
+
+//a kernel of a multi-channel world, its sums over the source channel grow the target channel
+typedef struct DimChannelKernel {
+    int source, target;
+    int radius;
+    float weight;     //share of its growth in the target's
+    float a, b, c, d; //parameters of the world's growth function of its sums
+    const DimCompiledKernel *shape;
+} DimChannelKernel;
+
+//up to DIM_GROUP_KERNELS kernels of a source, their taps padded to the largest radius
+typedef struct DimKernelGroup {
+    int source;
+    int radius;
+    int count;
+    int kernels[DIM_GROUP_KERNELS]; //indices in the world's kernels
+    float *taps;                    //count x (2R+1)^2
+    int *runs;                      //sparse form : (row, first, last) of the segments of taps non zero for one of the kernels
+    int runCount;
+} DimKernelGroup;
+
+typedef struct DimChannels {
+    int count;
+    float *planes; //states of the channels 1 to count-1, channel 0 being the cells'
+    float *next;   //their next states during a step
+    DimChannelKernel *kernels;
+    int kernelCount;
+    DimKernelGroup *groups; //NULL until the next step after the kernels changed
+    int groupCount;
+    float *delta;  //growth of each channel, planes filled by the fft engine
+    float **scratch; //per worker rings, sums and growth rows of the direct pass
+    size_t scratchSize;
+    int scratchWorkers;
+} DimChannels;
+
+//work on the rows [y0, y1) of dim, worker being the index of the calling thread in the pool
+typedef void (*DimRowTask)(Dimension *dim, void *ctx, int y0, int y1, int worker);
+
+//complex transforms of one length, radix 2 or bluestein (chirp != NULL) over m points
+typedef struct DimFFT {
+    int n;
+    int m;
+    float *twiddles;
+    float *chirp;
+    float *chirpSpectrum;
+} DimFFT;
+
+//transform of n reals through a complex one of n/2 points
+typedef struct DimRealFFT {
+    int n;
+    DimFFT *half;
+    float *twiddles; //exp(-2i pi k/n) for k <= n/2
+} DimRealFFT;
+
+//transforms of w x h complex planes, the rows then the columns split over the workers
+typedef struct DimFFT2D {
+    int w, h;
+    DimFFT *x, *y; //the same plan when the plane is square
+    float *work;   //workStride floats per worker
+    size_t workStride;
+    int workers;
+} DimFFT2D;
+
+//a kernel of the fft engine : the source plane weighted by its centred (2R+1)^2 taps times scale
+//the taps must be point symmetric, as radial kernels are, so that their spectrum is real
+typedef struct DimFFTKernel {
+    int source;
+    int radius;
+    const float *taps;
+    float scale;
+} DimFFTKernel;
+
+//sums handed by fftConvolve : kernel first in the real parts of the w x h complex plane, first+1 (if any) in the imaginary ones
+typedef struct DimFFTSums {
+    const float *plane;
+    int first;
+    bool pair;
+    void *ctx;
+} DimFFTSums;
+
+void *dimAlloc(size_t size);
+void *dimCalloc(size_t n, size_t size);
+void *dimRealloc(void *p, size_t size);
+void dimFree(void *p);
+void parallelRows(Dimension *dim, const char *name, DimRowTask task, void *ctx);
+void parallelRange(Dimension *dim, const char *name, DimRowTask task, void *ctx, int y0, int y1);
+void destroyPool(Dimension *dim);
+int listCpus(DimAffinity policy, int *cpus, int max);
+void pinThread(int cpu);
+void placeRange(const void *p, size_t bytes);
+void placeDimension(Dimension *dim);
+void *placedCalloc(Dimension *dim, int planes, int rows, size_t rowBytes);
+void startPlacedPool(Dimension *dim);
+void genSpans(Dimension *dim);
+int prepareScratch(Dimension *dim);
+void freeScratch(Dimension *dim);
+void loadRow(Dimension *dim, int y, float *dst);
+void convRowRange(Dimension *dim, const float **rows, float *out, int x0, int x1);
+void convRowGeneric(Dimension *dim, const float **rows, float *out);
+void convRowPair(Dimension *dim, const float **rows, float *out0, float *out1);
+void convolutionRingTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+size_t storageSize(DimStorage storage);
+float quantizeState(DimStorage storage, float s);
+void decodeRow(Dimension *dim, int y, float *dst);
+void swapRow(Dimension *dim, int y);
+void encodeRow(Dimension *dim, int y, const float *src);
+float loadState(Dimension *dim, size_t k);
+void storeState(Dimension *dim, size_t k, float s);
+int repackPlane(Dimension *dim, DimStorage storage, DimLayout layout);
+size_t planeLength(Dimension *dim, DimLayout layout);
+int *buildTileOrder(Dimension *dim);
+void doStepInPlace(Dimension *dim);
+void freeInPlace(Dimension *dim);
+void prepareGrowth(Dimension *dim);
+void getJITRows(Dimension *dim, DimConvRow *convRow, DimGrowthRow *growthRow);
+void freeJIT(Dimension *dim);
+void growthRow(Dimension *dim, const float *sums, Cell *cells, int n);
+void growthPlane(Dimension *dim, const float *sums, float *states, int n);
+uint64_t defaultSeed(void);
+DimFFT *createFFT(int n);
+void destroyFFT(DimFFT *f);
+size_t fftWorkSize(const DimFFT *f);
+void fftTransform(const DimFFT *f, float *data, bool inverse, float *work);
+size_t fftLinesWorkSize(const DimFFT *f);
+void fftLines(const DimFFT *f, float *data, int count, size_t stride, bool inverse, float *work);
+DimRealFFT *createRealFFT(int n);
+void destroyRealFFT(DimRealFFT *f);
+void realFFTForward(const DimRealFFT *f, float *data, float *work);
+void realFFTInverse(const DimRealFFT *f, float *data, float *work);
+DimFFT2D *createFFT2D(int w, int h);
+void destroyFFT2D(DimFFT2D *p);
+int fft2D(Dimension *dim, DimFFT2D *p, float *data, bool inverse, const bool *rows);
+void stepNoise(Dimension *dim);
+void freeNoise(Dimension *dim);
+uint64_t hashBytes(uint64_t h, const void *data, size_t n);
+float kernelF(float radius);
+float kernelValue(const Dimension *dim, float r);
+float shellTaps(Dimension *dim, float *taps, int r, int shells, const float *peaks);
+const DimCompiledKernel *compileKernel(Dimension *dim, int radius, int shells, const float *peaks);
+float *findSpectrum(Dimension *dim, uint64_t key);
+int storeSpectrum(Dimension *dim, uint64_t key, float *spectrum);
+void trimSpectra(Dimension *dim);
+void freeKernelCache(Dimension *dim);
+void loadChannelRow(Dimension *dim, int channel, int y, float *dst);
+void doStepChannels(Dimension *dim);
+void freeChannels(Dimension *dim);
+int recompileChannelKernels(Dimension *dim);
+int fftConvolve(Dimension *dim, int sources, const DimFFTKernel *kernels, int count, DimRowTask sink, void *ctx);
+int fftSums(Dimension *dim);
+void freeSpectra(Dimension *dim);
+float shellValue(Dimension *dim, float d, int shells, const float *peaks);
+float *volumeRow(Dimension *dim, size_t k);
+void doStepVolume(Dimension *dim);
+void cpuName(char *name, size_t size);
+int cacheDirectory(char *dir, size_t size);
+void chooseEngine(Dimension *dim);
+uint64_t machineKey(void);
+int kernelTaps(Dimension *dim);
+int canBlock(Dimension *dim);
+void freeVolume(Dimension *dim);
+void placeVolume(Dimension *dim);
+
+//splitmix64 finalizer, a bijection of the 64 bit integers
+static inline uint64_t dimMix64(uint64_t z) {
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+//key of the k-th stream derived from key
+static inline uint64_t dimSubKey(uint64_t key, uint64_t k) {
+    return dimMix64(key + (k+1)*0x9e3779b97f4a7c15ull);
+}
+
+//n-th draw of the stream key, a hash of the counter alone so any thread can draw any n
+//32 bit multiplies only (lowbias32), loops over n vectorize
+static inline uint32_t dimDraw(uint32_t key, uint32_t n) {
+    uint32_t z = key ^ n*0x9e3779b9u;
+    z ^= z >> 16;
+    z *= 0x21f0aaadu;
+    z ^= z >> 15;
+    z *= 0x735a2d97u;
+    return z ^ (z >> 15);
+}
+
+//uniform in [0, 1) from the 24 high bits of a draw
+static inline float dimUniform(uint32_t bits) {
+    return (float)(int)(bits >> 8)*0x1p-24f;
+}
+
+//index in the plane of the cell (x, y)
+static inline size_t planeIndex(const Dimension *dim, int x, int y) {
+    if (dim->tileOrder == NULL) { return (size_t)y*dim->MATRIXWIDTH + x; }
+    int tilesX = (dim->MATRIXWIDTH + DIM_TILE_SIDE-1)/DIM_TILE_SIDE;
+    size_t tile = (size_t)dim->tileOrder[(y/DIM_TILE_SIDE)*tilesX + x/DIM_TILE_SIDE];
+    return (tile*DIM_TILE_SIDE + y%DIM_TILE_SIDE)*DIM_TILE_SIDE + x%DIM_TILE_SIDE;
+}
+
+//cells of a row stored one after the other in the plane from column x
+static inline int planeRun(const Dimension *dim, int x) {
+    int left = dim->MATRIXWIDTH - x;
+    if (dim->tileOrder == NULL || left < DIM_TILE_SIDE - x%DIM_TILE_SIDE) { return left; }
+    return DIM_TILE_SIDE - x%DIM_TILE_SIDE;
+}
+
+//a if c else b through the bits : gcc threads the branches of a ?: into the code after it, which then
+//no longer if-converts, these selects keep the loops around them vectorizable
+static inline float dimSelect(bool c, float a, float b) {
+    uint32_t ua, ub, mask = -(uint32_t)c;
+    memcpy(&ua, &a, sizeof(ua));
+    memcpy(&ub, &b, sizeof(ub));
+    uint32_t bits = (ua & mask) | (ub & ~mask);
+    float s;
+    memcpy(&s, &bits, sizeof(s));
+    return s;
+}
+
+//exp(x) with a relative error around 2e-7, branch free so that loops calling it vectorize
+static inline float fastExpf(float x) {
+    x = dimSelect(x < -87.f, -87.f, x);
+    x = dimSelect(x > 88.f, 88.f, x);
+    //x = n*ln2 + r with |r| <= ln2/2, ln2 split in two for precision
+    //n rounded by the 1.5*2^23 trick, floorf is a libm call below sse4.1 and no loop calling it vectorizes
+    float n = (x*1.44269504f + 12582912.f) - 12582912.f;
+    float r = x - n*.693359375f + n*2.12194440e-4f;
+    float p = 1.9875691500e-4f;
+    p = p*r + 1.3981999507e-3f;
+    p = p*r + 8.3334519073e-3f;
+    p = p*r + 4.1665795894e-2f;
+    p = p*r + 1.6666665459e-1f;
+    p = p*r + 5.0000001201e-1f;
+    p = p*r*r + r + 1.f;
+    //scale by 2^n through the exponent bits
+    int bits = ((int)n + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p*scale;
+}
+
+//natural log of x > 0 with a relative error around 1e-7, branch free as fastExpf
+static inline float fastLogf(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    //x = m*2^e with m in [sqrt(2)/2, sqrt(2)), the offset moves the mantissas over sqrt(2) to the next exponent
+    bits += 0x3f800000 - 0x3f3504f3;
+    int e = (int)(bits >> 23) - 127;
+    bits = (bits & 0x7fffff) + 0x3f3504f3;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    float f = m - 1.f, z = f*f;
+    float p = 7.0376836292e-2f;
+    p = p*f - 1.1514610310e-1f;
+    p = p*f + 1.1676998740e-1f;
+    p = p*f - 1.2420140846e-1f;
+    p = p*f + 1.4249322787e-1f;
+    p = p*f - 1.6668057665e-1f;
+    p = p*f + 2.0000714765e-1f;
+    p = p*f - 2.4999993993e-1f;
+    p = p*f + 3.3333331174e-1f;
+    return f + f*z*p - .5f*z + e*.693147181f;
+}
+
+//sin(x) for x in [-pi, pi] with an absolute error under 1e-7, branch free as fastExpf
+static inline float fastSinf(float x) {
+    //sin(|x|) = sin(pi-|x|), folded on [0, pi/2] without a compare, the sign put back through the bits
+    //(copysignf and min keep gcc from vectorizing the callers' loops)
+    uint32_t bits, sign;
+    memcpy(&bits, &x, sizeof(bits));
+    sign = bits & 0x80000000u;
+    float a = __builtin_fabsf(x);
+    a = .5f*(3.14159265f - __builtin_fabsf(2.f*a - 3.14159265f));
+    float z = a*a;
+    float p = 2.5052108e-8f;
+    p = p*z - 2.7557319e-6f;
+    p = p*z + 1.9841270e-4f;
+    p = p*z - 8.3333333e-3f;
+    p = p*z + 1.6666667e-1f;
+    float s = a - a*z*p;
+    memcpy(&bits, &s, sizeof(bits));
+    bits ^= sign;
+    memcpy(&s, &bits, sizeof(s));
+    return s;
+}
+
+//two independent standard normal values from the n-th draws of the streams key and ~key, box-muller
+//(counters 2n and 2n+1 of a single stream keep gcc from vectorizing the loops)
+static inline float dimGaussian(uint32_t key, uint32_t n, float *second) {
+    //u in (0, 1] so that the log is finite
+    float u = (float)(int)((dimDraw(key, n) >> 8) + 1)*0x1p-24f;
+    float a = dimUniform(dimDraw(~key, n))*6.28318531f - 3.14159265f;
+    //sqrt through three newton steps on the inverse square root, gcc does not vectorize these loops around sqrtf
+    float v = -2.f*fastLogf(u) + 1e-30f, y;
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    bits = 0x5f3759df - (bits >> 1);
+    memcpy(&y, &bits, sizeof(y));
+    for (int k = 0; k < 3; ++k) { y *= 1.5f - .5f*v*y*y; }
+    float r = v*y;
+    *second = r*fastSinf(a);
+    return r*fastSinf(1.57079633f - __builtin_fabsf(a));
+}
+
+//growth of the sum u by a built-in function, through fastExpf when fast
+//loops call it with a constant function and get inlined once per function, each of them vectorizes
+static inline __attribute__((always_inline)) float growthShape(DimGrowthFunction function, bool fast, float u, float a, float b, float c, float d, float skew) {
+    switch (function) {
+        case DIM_GROWTH_POLYNOMIAL: {
+            float t = 1.f - (u-b)*(u-b)*(1.f/(9*c*c));
+            t = dimSelect(t > 0.f, t, 0.f);
+            return a*(t*t)*(t*t)+d;
+        }
+        case DIM_GROWTH_STEP:
+            return ((u-b)*(u-b) <= c*c ? a : 0.f)+d;
+        case DIM_GROWTH_ASYMMETRIC: {
+            float inv = dimSelect(u < b, -1.f/(2*c*c), -1.f/(2*c*c*skew*skew));
+            float x = (u-b)*(u-b)*inv;
+            return a*(fast ? fastExpf(x) : __builtin_expf(x))+d;
+        }
+        default:
+            if (fast) { return a*fastExpf((u-b)*(u-b)*(-1.f/(2*c*c)))+d; }
+            //the expression of growthValue, so that results stay bit identical to the reference
+            return a * __builtin_expf(-(u-b)*(u-b)/(2*c*c))+d;
+    }
+}
+
+#endif //__dimpriv_h_
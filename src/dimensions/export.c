@@ -0,0 +1,162 @@
+#include "dimensions.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+//stdio buffer given to the stream, frames bigger than this are written in one go anyway
+#define DIM_STREAM_BUFFER (4<<20)
+
+int writeNpyHeader(DimStream *stream, unsigned int w, unsigned int h, unsigned int depth);
+int gatherSlice(DimStream *stream, Dimension *dim, int z);
+int writeStreamSlices(DimStream *stream, Dimension *dim, int z0, int depth, int volume);
+
+//writes the .npy v1.0 header of a single (height, width) frame, (depth, height, width) for a non zero depth
+int writeNpyHeader(DimStream *stream, unsigned int w, unsigned int h, unsigned int depth) {
+    char header[128], shape[48];
+    if (depth > 0) { sprintf(shape, "(%u, %u, %u)", depth, h, w); }
+    else { sprintf(shape, "(%u, %u)", h, w); }
+    int len = sprintf(header, "{'descr': '%s', 'fortran_order': False, 'shape': %s, }",
+        stream->type == DIM_STREAM_UINT8 ? "|u1" : "<f4", shape);
+    //magic (6) + version (2) + length (2) + dict + '\n' must be a multiple of 64
+    while ((10 + len + 1) % 64 != 0) { header[len++] = ' '; }
+    header[len++] = '\n';
+    unsigned char pre[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, len & 0xff, (len >> 8) & 0xff };
+    if (fwrite(pre, 1, 10, stream->fp) != 10) { return 1; }
+    if (fwrite(header, 1, len, stream->fp) != (size_t)len) { return 1; }
+    return 0;
+}
+
+DIMAPI DimStream *openDimStreamFile(FILE *fp, DimStreamFormat format, DimStreamType type) {
+    if (fp == NULL) { return NULL; }
+    DimStream *stream = calloc(1, sizeof(DimStream));
+    if (stream == NULL) { return NULL; }
+    stream->fp = fp;
+    stream->format = format;
+    stream->type = type;
+    return stream;
+}
+
+//opens a stream on a file, "-" being the standard output (so it can be piped)
+DIMAPI DimStream *openDimStream(const char *path, DimStreamFormat format, DimStreamType type) {
+    FILE *fp;
+    int owns = 1;
+    if (strcmp(path, "-") == 0) {
+        fp = stdout;
+        owns = 0;
+#if defined(_WIN32)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    } else {
+        fp = fopen(path, "wb");
+    }
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open stream \"%s\"\n", path);
+        return NULL;
+    }
+    DimStream *stream = openDimStreamFile(fp, format, type);
+    if (stream == NULL) {
+        if (owns) { fclose(fp); }
+        return NULL;
+    }
+    stream->ownsFile = owns;
+    //setvbuf is only legal before any i/o, so only on files opened here
+    if (owns) {
+        stream->buffer = malloc(DIM_STREAM_BUFFER);
+        if (stream->buffer != NULL) { setvbuf(fp, stream->buffer, _IOFBF, DIM_STREAM_BUFFER); }
+    }
+    return stream;
+}
+
+//gathers the states of slice z (the plane of a flat world) into the frame of the stream, packed row-major
+int gatherSlice(DimStream *stream, Dimension *dim, int z) {
+    unsigned int w = dim->MATRIXWIDTH, h = dim->MATRIXHEIGHT;
+    size_t cellSize = stream->type == DIM_STREAM_UINT8 ? sizeof(unsigned char) : sizeof(float);
+    size_t size = (size_t)w*h*cellSize;
+
+    //an in-place world or a volume is read a row at a time, behind the frame
+    int rows = dim->inPlace || dim->volume != NULL;
+    size_t rowOffset = (size + sizeof(float)-1)/sizeof(float)*sizeof(float);
+    size_t need = rows ? rowOffset + w*sizeof(float) : size;
+    if (stream->frameSize < need) {
+        unsigned char *frame = realloc(stream->frame, need);
+        if (frame == NULL) { return 1; }
+        stream->frame = frame;
+        stream->frameSize = need;
+    }
+
+    //gather the interleaved states into a packed plane
+    if (rows) {
+        float *row = (float *)(stream->frame + rowOffset);
+        for (unsigned int j = 0; j < h; ++j) {
+            if (stream->type == DIM_STREAM_FLOAT32) {
+                getStateRow(dim, j + z*h, (float *)stream->frame + (size_t)j*w);
+                continue;
+            }
+            getStateRow(dim, j + z*h, row);
+            for (unsigned int i = 0; i < w; ++i) {
+                float s = row[i];
+                stream->frame[i+j*w] = s <= 0.f ? 0 : s >= 1.f ? 255 : (unsigned char)(s*255.f+.5f);
+            }
+        }
+    } else if (stream->type == DIM_STREAM_UINT8) {
+        unsigned char *out = stream->frame;
+        for (unsigned int j = 0; j < h; ++j) {
+            for (unsigned int i = 0; i < w; ++i) {
+                float s = dim->matrix[i+j*w].state;
+                out[i+j*w] = s <= 0.f ? 0 : s >= 1.f ? 255 : (unsigned char)(s*255.f+.5f);
+            }
+        }
+    } else {
+        float *out = (float *)stream->frame;
+        for (unsigned int j = 0; j < h; ++j) {
+            for (unsigned int i = 0; i < w; ++i) {
+                out[i+j*w] = dim->matrix[i+j*w].state;
+            }
+        }
+    }
+    return 0;
+}
+
+//appends the slices [z0, z0+depth) as one frame, (depth, height, width) when volume is set
+int writeStreamSlices(DimStream *stream, Dimension *dim, int z0, int depth, int volume) {
+    unsigned int w = dim->MATRIXWIDTH, h = dim->MATRIXHEIGHT;
+    size_t size = (size_t)w*h*(stream->type == DIM_STREAM_UINT8 ? sizeof(unsigned char) : sizeof(float));
+    if (stream->format == DIM_STREAM_NPY && writeNpyHeader(stream, w, h, volume ? depth : 0) != 0) { return 1; }
+    //a volume is written a slice at a time, the frame buffer never holds more than one
+    for (int z = z0; z < z0+depth; ++z) {
+        if (gatherSlice(stream, dim, z) != 0) { return 1; }
+        if (fwrite(stream->frame, 1, size, stream->fp) != size) {
+            fprintf(stderr, "Failed to write frame %lu to stream\n", stream->frames);
+            return 1;
+        }
+    }
+    stream->frames++;
+    return 0;
+}
+
+//appends the current state plane of dim to the stream, row-major (height, width), or the whole (depth, height, width) volume
+DIMAPI int writeDimStream(DimStream *stream, Dimension *dim) {
+    return writeStreamSlices(stream, dim, 0, getMatrixDepth(dim), dim->volume != NULL);
+}
+
+//appends slice z of a volume as a (height, width) frame
+DIMAPI int writeDimStreamSlice(DimStream *stream, Dimension *dim, int z) {
+    if (z < 0 || z >= getMatrixDepth(dim)) {
+        fprintf(stderr, "No slice %d in a %d deep dimension\n", z, getMatrixDepth(dim));
+        return 1;
+    }
+    return writeStreamSlices(stream, dim, z, 1, 0);
+}
+
+DIMAPI void closeDimStream(DimStream *stream) {
+    if (stream == NULL) { return; }
+    fflush(stream->fp);
+    if (stream->ownsFile) { fclose(stream->fp); }
+    free(stream->frame);
+    free(stream->buffer);
+    free(stream);
+}
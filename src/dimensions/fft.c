@@ -0,0 +1,370 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//complex arrays are interleaved floats, re then im
+
+void fftRadix2(const DimFFT *f, float *data, int m, const float *twiddles);
+void fftRadix2Block(const DimFFT *f, float *data, int count, size_t stride, bool inverse);
+void fftRowsTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void fftColumnsTask(Dimension *dim, void *ctx, int x0, int x1, int worker);
+
+//twiddles exp(-2i pi k/m) for k < m/2, in double then rounded so the error doesn't grow with m
+static float *makeTwiddles(int m) {
+    float *t = malloc((size_t)(m > 1 ? m : 2)*sizeof(float));
+    if (t == NULL) { return NULL; }
+    for (int k = 0; k < m/2; ++k) {
+        double a = -2.*M_PI*k/m;
+        t[2*k] = (float)cos(a);
+        t[2*k+1] = (float)sin(a);
+    }
+    return t;
+}
+
+//plan of the transforms of length n, radix 2 when n is a power of two, else bluestein over a power of two m >= 2n-1
+DimFFT *createFFT(int n) {
+    DimFFT *f = calloc(1, sizeof(DimFFT));
+    if (f == NULL || n < 1) {
+        free(f);
+        return NULL;
+    }
+    f->n = n;
+    f->m = 1;
+    while (f->m < n) { f->m <<= 1; }
+    if (f->m != n) {
+        f->m = 1;
+        while (f->m < 2*n-1) { f->m <<= 1; }
+    }
+    f->twiddles = makeTwiddles(f->m);
+    if (f->twiddles == NULL) {
+        destroyFFT(f);
+        return NULL;
+    }
+    if (f->m == n) { return f; }
+
+    //chirp exp(-i pi k^2/n), k^2 taken modulo 2n to keep the angle exact
+    f->chirp = malloc(2*(size_t)n*sizeof(float));
+    f->chirpSpectrum = calloc(2*(size_t)f->m, sizeof(float));
+    if (f->chirp == NULL || f->chirpSpectrum == NULL) {
+        destroyFFT(f);
+        return NULL;
+    }
+    for (int k = 0; k < n; ++k) {
+        double a = -M_PI*(double)(((long long)k*k) % (2*(long long)n))/n;
+        f->chirp[2*k] = (float)cos(a);
+        f->chirp[2*k+1] = (float)sin(a);
+    }
+    //spectrum of the conjugate chirp laid out circularly, the filter of the convolution
+    float *b = f->chirpSpectrum;
+    for (int k = 0; k < n; ++k) {
+        b[2*k] = f->chirp[2*k];
+        b[2*k+1] = -f->chirp[2*k+1];
+        if (k > 0) {
+            b[2*(f->m-k)] = b[2*k];
+            b[2*(f->m-k)+1] = b[2*k+1];
+        }
+    }
+    fftRadix2(f, b, f->m, f->twiddles);
+    return f;
+}
+
+void destroyFFT(DimFFT *f) {
+    if (f == NULL) { return; }
+    free(f->twiddles);
+    free(f->chirp);
+    free(f->chirpSpectrum);
+    free(f);
+}
+
+//floats of work fftTransform needs
+size_t fftWorkSize(const DimFFT *f) {
+    return f->m == f->n ? 0 : 2*(size_t)f->m;
+}
+
+//in place forward transform of m complex, m a power of two, iterative decimation in time
+void fftRadix2(const DimFFT *f, float *data, int m, const float *twiddles) {
+    for (int i = 1, j = 0; i < m; ++i) {
+        int bit = m >> 1;
+        for (; j & bit; bit >>= 1) { j ^= bit; }
+        j |= bit;
+        if (i < j) {
+            float re = data[2*i], im = data[2*i+1];
+            data[2*i] = data[2*j];
+            data[2*i+1] = data[2*j+1];
+            data[2*j] = re;
+            data[2*j+1] = im;
+        }
+    }
+    for (int len = 2; len <= m; len <<= 1) {
+        int half = len >> 1, step = m/len;
+        for (int i = 0; i < m; i += len) {
+            float *a = data + 2*i, *b = data + 2*(i+half);
+            for (int k = 0; k < half; ++k) {
+                float wr = twiddles[2*k*step], wi = twiddles[2*k*step+1];
+                float tr = b[2*k]*wr - b[2*k+1]*wi;
+                float ti = b[2*k]*wi + b[2*k+1]*wr;
+                b[2*k] = a[2*k] - tr;
+                b[2*k+1] = a[2*k+1] - ti;
+                a[2*k] += tr;
+                a[2*k+1] += ti;
+            }
+        }
+    }
+}
+
+//count transforms side by side, m being a power of two : point k of transform i is data[2*(k*stride + i)]
+//the count butterflies of a pair of points share their twiddle, the inner loops vectorize
+void fftRadix2Block(const DimFFT *f, float *data, int count, size_t stride, bool inverse) {
+    int m = f->m;
+    if (inverse) {
+        for (int k = 0; k < m; ++k) {
+            float *p = data + 2*k*stride;
+            for (int i = 0; i < count; ++i) { p[2*i+1] = -p[2*i+1]; }
+        }
+    }
+    for (int k = 1, j = 0; k < m; ++k) {
+        int bit = m >> 1;
+        for (; j & bit; bit >>= 1) { j ^= bit; }
+        j |= bit;
+        if (k < j) {
+            float *a = data + 2*k*stride, *b = data + 2*j*stride;
+            for (int i = 0; i < 2*count; ++i) {
+                float t = a[i];
+                a[i] = b[i];
+                b[i] = t;
+            }
+        }
+    }
+    for (int len = 2; len <= m; len <<= 1) {
+        int half = len >> 1, step = m/len;
+        for (int k0 = 0; k0 < m; k0 += len) {
+            for (int k = 0; k < half; ++k) {
+                const float wr = f->twiddles[2*k*step], wi = f->twiddles[2*k*step+1];
+                float *a = data + 2*(k0+k)*stride, *b = data + 2*(k0+k+half)*stride;
+                for (int i = 0; i < count; ++i) {
+                    float tr = b[2*i]*wr - b[2*i+1]*wi;
+                    float ti = b[2*i]*wi + b[2*i+1]*wr;
+                    b[2*i] = a[2*i] - tr;
+                    b[2*i+1] = a[2*i+1] - ti;
+                    a[2*i] += tr;
+                    a[2*i+1] += ti;
+                }
+            }
+        }
+    }
+    if (inverse) {
+        for (int k = 0; k < m; ++k) {
+            float *p = data + 2*k*stride;
+            for (int i = 0; i < count; ++i) { p[2*i+1] = -p[2*i+1]; }
+        }
+    }
+}
+
+//in place transform of the n complex of data, unnormalized : the inverse of the forward one is n times the input
+//work holds fftWorkSize floats
+void fftTransform(const DimFFT *f, float *data, bool inverse, float *work) {
+    int n = f->n, m = f->m;
+    //the inverse is the conjugate of the forward transform of the conjugate
+    if (inverse) { for (int k = 0; k < n; ++k) { data[2*k+1] = -data[2*k+1]; } }
+    if (m == n) {
+        fftRadix2(f, data, m, f->twiddles);
+    } else {
+        const float *c = f->chirp, *b = f->chirpSpectrum;
+        for (int k = 0; k < n; ++k) {
+            work[2*k] = data[2*k]*c[2*k] - data[2*k+1]*c[2*k+1];
+            work[2*k+1] = data[2*k]*c[2*k+1] + data[2*k+1]*c[2*k];
+        }
+        memset(work + 2*n, 0, 2*(size_t)(m-n)*sizeof(float));
+        fftRadix2(f, work, m, f->twiddles);
+        //product with the filter, conjugated for the inverse transform made by the same forward pass
+        for (int k = 0; k < m; ++k) {
+            float re = work[2*k]*b[2*k] - work[2*k+1]*b[2*k+1];
+            float im = work[2*k]*b[2*k+1] + work[2*k+1]*b[2*k];
+            work[2*k] = re;
+            work[2*k+1] = -im;
+        }
+        fftRadix2(f, work, m, f->twiddles);
+        const float scale = 1.f/m;
+        for (int k = 0; k < n; ++k) {
+            float re = work[2*k]*scale, im = -work[2*k+1]*scale;
+            data[2*k] = re*c[2*k] - im*c[2*k+1];
+            data[2*k+1] = re*c[2*k+1] + im*c[2*k];
+        }
+    }
+    if (inverse) { for (int k = 0; k < n; ++k) { data[2*k+1] = -data[2*k+1]; } }
+}
+
+//floats of work fftLines needs
+size_t fftLinesWorkSize(const DimFFT *f) {
+    return f->m == f->n ? 0 : 2*(size_t)DIM_FFT_COLUMNS*f->n + fftWorkSize(f);
+}
+
+//transforms of count lines side by side, point k of line i being data[2*(k*stride + i)], a few lines at a time so that
+//each point is read by whole cache lines, in place when their length is a power of two, else gathered in work
+void fftLines(const DimFFT *f, float *data, int count, size_t stride, bool inverse, float *work) {
+    int len = f->n;
+    for (int c0 = 0; c0 < count; c0 += DIM_FFT_COLUMNS) {
+        int n = count-c0 < DIM_FFT_COLUMNS ? count-c0 : DIM_FFT_COLUMNS;
+        if (f->m == len) {
+            fftRadix2Block(f, data + 2*(size_t)c0, n, stride, inverse);
+            continue;
+        }
+        float *lines = work, *rest = work + 2*(size_t)DIM_FFT_COLUMNS*len;
+        for (int k = 0; k < len; ++k) {
+            const float *src = data + 2*((size_t)k*stride + c0);
+            for (int i = 0; i < n; ++i) {
+                lines[2*((size_t)i*len + k)] = src[2*i];
+                lines[2*((size_t)i*len + k)+1] = src[2*i+1];
+            }
+        }
+        for (int i = 0; i < n; ++i) { fftTransform(f, lines + 2*(size_t)i*len, inverse, rest); }
+        for (int k = 0; k < len; ++k) {
+            float *dst = data + 2*((size_t)k*stride + c0);
+            for (int i = 0; i < n; ++i) {
+                dst[2*i] = lines[2*((size_t)i*len + k)];
+                dst[2*i+1] = lines[2*((size_t)i*len + k)+1];
+            }
+        }
+    }
+}
+
+//plan of the transforms of n reals, n even : a complex transform of n/2 points and the twiddles separating its two halves
+DimRealFFT *createRealFFT(int n) {
+    DimRealFFT *f = calloc(1, sizeof(DimRealFFT));
+    if (f == NULL || n < 2 || n % 2 != 0) {
+        free(f);
+        return NULL;
+    }
+    f->n = n;
+    f->half = createFFT(n/2);
+    f->twiddles = malloc(2*(size_t)(n/2+1)*sizeof(float));
+    if (f->half == NULL || f->twiddles == NULL) {
+        destroyRealFFT(f);
+        return NULL;
+    }
+    for (int k = 0; k <= n/2; ++k) {
+        double a = -2.*M_PI*k/n;
+        f->twiddles[2*k] = (float)cos(a);
+        f->twiddles[2*k+1] = (float)sin(a);
+    }
+    return f;
+}
+
+void destroyRealFFT(DimRealFFT *f) {
+    if (f == NULL) { return; }
+    destroyFFT(f->half);
+    free(f->twiddles);
+    free(f);
+}
+
+//in place transform of the n reals of data into its n/2+1 first complex bins, data holding n+2 floats
+//the even and odd reals are the real and imaginary parts of a transform of n/2 points, X[k] = E[k] + w^k O[k]
+void realFFTForward(const DimRealFFT *f, float *data, float *work) {
+    int m = f->n/2;
+    fftTransform(f->half, data, false, work);
+    float zr = data[0], zi = data[1];
+    data[0] = zr + zi;
+    data[1] = 0.f;
+    data[2*m] = zr - zi;
+    data[2*m+1] = 0.f;
+    //the bins k and m-k are made from the same two points
+    for (int k = 1; 2*k <= m; ++k) {
+        int j = m-k;
+        float ar = data[2*k], ai = data[2*k+1], br = data[2*j], bi = data[2*j+1];
+        //E[k] = (Z[k] + conj(Z[m-k]))/2, O[k] = (Z[k] - conj(Z[m-k]))/2i
+        float er = .5f*(ar + br), ei = .5f*(ai - bi), or = .5f*(ai + bi), oi = -.5f*(ar - br);
+        float wr = f->twiddles[2*k], wi = f->twiddles[2*k+1];
+        data[2*k] = er + wr*or - wi*oi;
+        data[2*k+1] = ei + wr*oi + wi*or;
+        //E[m-k] = conj(E[k]) and O[m-k] = conj(O[k]), with w^(m-k) = -conj(w^k)
+        data[2*j] = er - (wr*or - wi*oi);
+        data[2*j+1] = -ei + (wr*oi + wi*or);
+    }
+}
+
+//in place inverse of realFFTForward, unnormalized : the n reals come out times n
+void realFFTInverse(const DimRealFFT *f, float *data, float *work) {
+    int m = f->n/2;
+    float x0 = data[0], xm = data[2*m];
+    data[0] = x0 + xm;
+    data[1] = x0 - xm;
+    for (int k = 1; 2*k <= m; ++k) {
+        int j = m-k;
+        float ar = data[2*k], ai = data[2*k+1], br = data[2*j], bi = data[2*j+1];
+        //2E[k] = X[k] + conj(X[m-k]), 2O[k] = (X[k] - conj(X[m-k]))/w^k, Z[k] = 2E[k] + 2i O[k]
+        float er = ar + br, ei = ai - bi, dr = ar - br, di = ai + bi;
+        float wr = f->twiddles[2*k], wi = -f->twiddles[2*k+1];
+        float or = dr*wr - di*wi, oi = dr*wi + di*wr;
+        data[2*k] = er - oi;
+        data[2*k+1] = ei + or;
+        //Z[m-k] = conj(2E[k]) + i conj(2O[k])
+        data[2*j] = er + oi;
+        data[2*j+1] = -ei + or;
+    }
+    fftTransform(f->half, data, true, work);
+}
+
+//plans and per worker buffers of the transforms of w x h complex planes
+DimFFT2D *createFFT2D(int w, int h) {
+    DimFFT2D *p = calloc(1, sizeof(DimFFT2D));
+    if (p == NULL) { return NULL; }
+    p->w = w;
+    p->h = h;
+    p->x = createFFT(w);
+    p->y = w == h ? p->x : createFFT(h);
+    if (p->x == NULL || p->y == NULL) {
+        destroyFFT2D(p);
+        return NULL;
+    }
+    //power of two columns are transformed in place, the others are gathered with the bluestein work
+    size_t wx = fftWorkSize(p->x), wy = fftLinesWorkSize(p->y);
+    p->workStride = wx > wy ? wx : wy;
+    return p;
+}
+
+void destroyFFT2D(DimFFT2D *p) {
+    if (p == NULL) { return; }
+    if (p->y != p->x) { destroyFFT(p->y); }
+    destroyFFT(p->x);
+    dimFree(p->work);
+    free(p);
+}
+
+typedef struct DimFFTPass {
+    DimFFT2D *plan;
+    float *data;
+    bool inverse;
+    const bool *rows;
+} DimFFTPass;
+
+void fftRowsTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimFFTPass *pass = ctx;
+    DimFFT2D *p = pass->plan;
+    float *work = p->work + (size_t)worker*p->workStride;
+    for (int y = y0; y < y1; ++y) {
+        if (pass->rows == NULL || pass->rows[y]) { fftTransform(p->x, pass->data + 2*(size_t)y*p->w, pass->inverse, work); }
+    }
+}
+
+//columns [x0, x1) through fftLines
+void fftColumnsTask(Dimension *dim, void *ctx, int x0, int x1, int worker) {
+    DimFFTPass *pass = ctx;
+    DimFFT2D *p = pass->plan;
+    fftLines(p->y, pass->data + 2*(size_t)x0, x1-x0, p->w, pass->inverse, p->work + (size_t)worker*p->workStride);
+}
+
+//2D transform of the w x h complex plane data over the workers of dim, unnormalized
+//the rows pass skips the rows y for which rows[y] is false, known to be zero, rows may be NULL
+int fft2D(Dimension *dim, DimFFT2D *p, float *data, bool inverse, const bool *rows) {
+    if (p->workers < dim->threads && p->workStride > 0) {
+        float *work = dimRealloc(p->work, (size_t)dim->threads*p->workStride*sizeof(float));
+        if (work == NULL) { return 1; }
+        p->work = work;
+        p->workers = dim->threads;
+    }
+    DimFFTPass pass = { p, data, inverse, rows };
+    parallelRange(dim, "fft rows", fftRowsTask, &pass, 0, p->h);
+    parallelRange(dim, "fft columns", fftColumnsTask, &pass, 0, p->w);
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//planes of the fft engine : the sources go by pairs in the real and imaginary parts of a complex plane, and
+//the sums of two kernels come back from a single inverse transform in the two parts of its plane
+typedef struct DimSpectra {
+    int w, h;
+    DimFFT2D *plan;
+    const float **kernels; //real spectrum of each kernel, the 1/wh of the inverse folded in, held by the kernel cache
+    int kernelCount;
+    float *sources; //spectra of the pairs of sources, w x h complex each
+    int pairs;
+    float *plane;   //products transformed back
+} DimSpectra;
+
+typedef struct DimSpectraPass {
+    DimSpectra *s;
+    int sources;
+    const DimFFTKernel *kernels;
+    int first;
+    bool pair;
+} DimSpectraPass;
+
+uint64_t spectrumKey(Dimension *dim, const DimFFTKernel *kernel);
+int kernelSpectrum(Dimension *dim, const DimFFTKernel *kernel, float *spectrum);
+int prepareSpectra(Dimension *dim, int sources, const DimFFTKernel *kernels, int count);
+void packTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void productTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void sumsTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+
+//the spectrum depends on the plane and the scaled taps, not on the source
+uint64_t spectrumKey(Dimension *dim, const DimFFTKernel *kernel) {
+    int shape[] = { dim->MATRIXWIDTH, dim->MATRIXHEIGHT, kernel->radius };
+    int side = 2*kernel->radius+1;
+    uint64_t h = hashBytes(0xcbf29ce484222325ull, shape, sizeof(shape));
+    h = hashBytes(h, &kernel->scale, sizeof(float));
+    return hashBytes(h, kernel->taps, (size_t)side*side*sizeof(float));
+}
+
+void freeSpectra(Dimension *dim) {
+    DimSpectra *s = dim->spectra;
+    if (s == NULL) { return; }
+    destroyFFT2D(s->plan);
+    free(s->kernels);
+    dimFree(s->sources);
+    dimFree(s->plane);
+    free(s);
+    dim->spectra = NULL;
+}
+
+//real spectrum of a point symmetric kernel, transformed in the plane of the engine
+//the sums read the source around each cell, a correlation : the taps are laid flipped around the origin of the torus
+//then transformed, only the rows holding taps go through the row pass
+int kernelSpectrum(Dimension *dim, const DimFFTKernel *kernel, float *spectrum) {
+    DimSpectra *s = dim->spectra;
+    int w = s->w, h = s->h, r = kernel->radius, side = 2*r+1;
+    size_t plane = (size_t)w*h;
+    bool *rows = calloc(h, sizeof(bool));
+    if (rows == NULL) { return 1; }
+    const float norm = 1.f/(float)plane;
+    memset(s->plane, 0, 2*plane*sizeof(float));
+    for (int ty = 0; ty < side; ++ty) {
+        int y = ((r-ty) % h + h) % h;
+        rows[y] = true;
+        for (int tx = 0; tx < side; ++tx) {
+            int x = ((r-tx) % w + w) % w;
+            s->plane[2*((size_t)y*w + x)] += kernel->taps[ty*side+tx]*kernel->scale*norm;
+        }
+    }
+    int failed = fft2D(dim, s->plan, s->plane, false, rows);
+    free(rows);
+    if (failed) { return 1; }
+    for (size_t i = 0; i < plane; ++i) { spectrum[i] = s->plane[2*i]; }
+    return 0;
+}
+
+//plans the transforms for the plane and finds the spectra of the kernels, computing those the cache doesn't have
+int prepareSpectra(Dimension *dim, int sources, const DimFFTKernel *kernels, int count) {
+    for (int k = 0; k < count; ++k) {
+        int area = (2*kernels[k].radius+1)*(2*kernels[k].radius+1);
+        for (int t = 0; t < area; ++t) {
+            if (kernels[k].taps[t] != kernels[k].taps[area-1-t]) {
+                fprintf(stderr, "The fft engine needs point symmetric kernels\n");
+                return 1;
+            }
+        }
+    }
+
+    int w = dim->MATRIXWIDTH, h = dim->MATRIXHEIGHT;
+    size_t plane = (size_t)w*h;
+    DimSpectra *s = dim->spectra;
+    if (s == NULL || s->w != w || s->h != h || s->pairs != (sources+1)/2) {
+        freeSpectra(dim);
+        s = calloc(1, sizeof(DimSpectra));
+        if (s == NULL) { return 1; }
+        dim->spectra = s;
+        s->w = w;
+        s->h = h;
+        s->pairs = (sources+1)/2;
+        s->plan = createFFT2D(w, h);
+        s->sources = dimAlloc(s->pairs*2*plane*sizeof(float));
+        s->plane = dimAlloc(2*plane*sizeof(float));
+        if (s->plan == NULL || s->sources == NULL || s->plane == NULL) {
+            freeSpectra(dim);
+            return 1;
+        }
+    }
+    if (s->kernelCount != count) {
+        const float **spectra = realloc(s->kernels, count*sizeof(float *));
+        if (spectra == NULL) { return 1; }
+        s->kernels = spectra;
+        s->kernelCount = count;
+    }
+    for (int k = 0; k < count; ++k) {
+        uint64_t key = spectrumKey(dim, &kernels[k]);
+        float *spectrum = findSpectrum(dim, key);
+        if (spectrum == NULL) {
+            spectrum = dimAlloc(plane*sizeof(float));
+            if (spectrum == NULL || kernelSpectrum(dim, &kernels[k], spectrum) != 0 || storeSpectrum(dim, key, spectrum) != 0) {
+                dimFree(spectrum);
+                return 1;
+            }
+        }
+        s->kernels[k] = spectrum;
+    }
+    trimSpectra(dim);
+    return 0;
+}
+
+//sources 2p and 2p+1 as the real and imaginary parts of plane p
+void packTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimSpectraPass *pass = ctx;
+    int w = pass->s->w;
+    size_t plane = (size_t)w*pass->s->h;
+    float *row = malloc(2*(size_t)w*sizeof(float));
+    if (row == NULL) {
+        fprintf(stderr, "Failed to allocate the rows of the packed bands\n");
+        return;
+    }
+    for (int p = 0; p < pass->s->pairs; ++p) {
+        bool odd = 2*p+1 < pass->sources;
+        for (int y = y0; y < y1; ++y) {
+            float *dst = pass->s->sources + p*2*plane + 2*(size_t)y*w;
+            loadChannelRow(dim, 2*p, y, row);
+            if (odd) { loadChannelRow(dim, 2*p+1, y, row + w); }
+            else { memset(row + w, 0, w*sizeof(float)); }
+            for (int x = 0; x < w; ++x) {
+                dst[2*x] = row[x];
+                dst[2*x+1] = row[w+x];
+            }
+        }
+    }
+    free(row);
+}
+
+//spectrum of a source at frequency (x, y), split from the plane it shares through the symmetry of real spectra
+//zf is row y of the plane and zm row -y, A = (Z(f) + conj Z(-f))/2 is the even source and B = (Z(f) - conj Z(-f))/2i the odd one
+static inline void sourceSpectrum(const float *zf, const float *zm, bool odd, int x, int w, float *re, float *im) {
+    int m = x == 0 ? 0 : w-x;
+    if (odd) {
+        *re = .5f*(zf[2*x+1] + zm[2*m+1]);
+        *im = .5f*(zm[2*m] - zf[2*x]);
+    } else {
+        *re = .5f*(zf[2*x] + zm[2*m]);
+        *im = .5f*(zf[2*x+1] - zm[2*m+1]);
+    }
+}
+
+//products of the rows [y0, y1) of the spectra of the kernels first and first+1, the second one times i
+void productTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimSpectraPass *pass = ctx;
+    const DimSpectra *s = pass->s;
+    int w = s->w;
+    size_t plane = (size_t)w*s->h;
+    const DimFFTKernel *k0 = &pass->kernels[pass->first], *k1 = pass->pair ? k0+1 : NULL;
+    const float *z0 = s->sources + (size_t)(k0->source/2)*2*plane;
+    const float *z1 = k1 != NULL ? s->sources + (size_t)(k1->source/2)*2*plane : NULL;
+    for (int y = y0; y < y1; ++y) {
+        size_t f = 2*(size_t)y*w, m = 2*(size_t)((s->h-y) % s->h)*w;
+        const float *g0 = s->kernels[pass->first] + (size_t)y*w, *g1 = k1 != NULL ? s->kernels[pass->first+1] + (size_t)y*w : NULL;
+        float *dst = s->plane + f;
+        for (int x = 0; x < w; ++x) {
+            float re, im;
+            sourceSpectrum(z0 + f, z0 + m, k0->source % 2, x, w, &re, &im);
+            dst[2*x] = re*g0[x];
+            dst[2*x+1] = im*g0[x];
+        }
+        if (k1 == NULL) { continue; }
+        for (int x = 0; x < w; ++x) {
+            float re, im;
+            sourceSpectrum(z1 + f, z1 + m, k1->source % 2, x, w, &re, &im);
+            dst[2*x] -= im*g1[x];
+            dst[2*x+1] += re*g1[x];
+        }
+    }
+}
+
+//sums of count kernels over the sources, handed by pairs of kernels to sink through parallelRows with a DimFFTSums
+//one forward transform per pair of sources and one inverse per pair of kernels, whatever the radii
+//returns 1 when the planes or transforms can't be allocated
+int fftConvolve(Dimension *dim, int sources, const DimFFTKernel *kernels, int count, DimRowTask sink, void *ctx) {
+    if (prepareSpectra(dim, sources, kernels, count) != 0) { return 1; }
+    DimSpectra *s = dim->spectra;
+    DimSpectraPass pass = { s, sources, kernels, 0, false };
+    size_t plane = (size_t)s->w*s->h;
+    parallelRows(dim, "fft pack", packTask, &pass);
+    for (int p = 0; p < s->pairs; ++p) {
+        if (fft2D(dim, s->plan, s->sources + p*2*plane, false, NULL) != 0) { return 1; }
+    }
+    for (int k = 0; k < count; k += 2) {
+        pass.first = k;
+        pass.pair = k+1 < count;
+        parallelRows(dim, "fft product", productTask, &pass);
+        if (fft2D(dim, s->plan, s->plane, true, NULL) != 0) { return 1; }
+        DimFFTSums sums = { s->plane, k, pass.pair, ctx };
+        parallelRows(dim, "fft sums", sink, &sums);
+    }
+    return 0;
+}
+
+void sumsTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimFFTSums *sums = ctx;
+    int w = dim->MATRIXWIDTH;
+    for (int y = y0; y < y1; ++y) {
+        const float *src = sums->plane + 2*(size_t)y*w;
+        float *dst = &dim->sums[(size_t)y*w];
+        for (int x = 0; x < w; ++x) { dst[x] = src[2*x]; }
+    }
+}
+
+//neighbour sums of a single kernel world by the fft engine, returns 1 if they could not be computed
+int fftSums(Dimension *dim) {
+    DimFFTKernel kernel = { 0, dim->KERNELRAD, dim->kernel, 1.f/dim->kSum };
+    if (fftConvolve(dim, 1, &kernel, 1, sumsTask, NULL) != 0) {
+        fprintf(stderr, "The fft engine can't step this dimension, switching to the direct engine\n");
+        dim->engine = DIM_ENGINE_DIRECT;
+        return 1;
+    }
+    return 0;
+}
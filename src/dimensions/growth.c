@@ -0,0 +1,179 @@
+#include "dimpriv.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//table sizes allowed for the growth lookup
+#define GROWTH_LUT_MIN 16
+#define GROWTH_LUT_MAX (1<<20)
+#define GROWTH_LUT_DEFAULT_ERROR 1e-6f
+
+float growthValue(Dimension *dim, float sum);
+int buildGrowthLUT(Dimension *dim);
+
+//names of the growth functions, in the order of DimGrowthFunction
+const char *growthFunctionNames[DIM_GROWTH_FUNCTION_COUNT] = { "gaussian", "polynomial", "step", "asymmetric", "callback" };
+
+//samples growth*DT over sums in [0, 1], keeping the parameters to detect their changes
+int buildGrowthLUT(Dimension *dim) {
+    int n = dim->growthLUTSize;
+    float *lut = realloc(dim->growthLUT, n*sizeof(float));
+    if (lut == NULL) {
+        fprintf(stderr, "Failed to allocate the growth table, falling back to expf\n");
+        dim->growthMode = DIM_GROWTH_EXACT;
+        return 1;
+    }
+    dim->growthLUT = lut;
+    for (int k = 0; k < n; ++k) { lut[k] = growthValue(dim, (float)k/(float)(n-1)); }
+    dim->growthLUTParams[0] = dim->a;
+    dim->growthLUTParams[1] = dim->b;
+    dim->growthLUTParams[2] = dim->c;
+    dim->growthLUTParams[3] = dim->d;
+    dim->growthLUTParams[4] = dim->DT;
+    return 0;
+}
+
+//resamples the table if the growth parameters changed since, called before each growth pass
+void prepareGrowth(Dimension *dim) {
+    if (dim->growthMode != DIM_GROWTH_LUT) { return; }
+    if (dim->growthLUT == NULL || dim->growthLUTParams[0] != dim->a || dim->growthLUTParams[1] != dim->b
+        || dim->growthLUTParams[2] != dim->c || dim->growthLUTParams[3] != dim->d || dim->growthLUTParams[4] != dim->DT) {
+        if (dim->growthLUTError > 0) { setGrowthLUT(dim, 0, dim->growthLUTError); }
+        else { buildGrowthLUT(dim); }
+    }
+}
+
+//switches to a lookup table, of the given resolution or else of the resolution reaching maxError
+//returns the number of samples of the table
+DIMAPI int setGrowthLUT(Dimension *dim, int resolution, float maxError) {
+    if (resolution <= 0) {
+        if (maxError <= 0) { maxError = GROWTH_LUT_DEFAULT_ERROR; }
+        //linear interpolation error is at most h^2/8*max|f''|, and |f''| <= |a|*DT/c^2 for the gaussian
+        //the polynomial bump stays under it, the asymmetric one is bounded by its narrower side
+        //the edges of the step are smeared over a sample whatever the resolution, a callback is assumed gaussian
+        double width = dim->c;
+        if (dim->growthFunction == DIM_GROWTH_ASYMMETRIC && dim->growthSkew < 1.f) { width *= dim->growthSkew; }
+        double curvature = fabs(dim->a*dim->DT)/(width*width);
+        double h = curvature > 0 ? sqrt(8.*maxError/curvature) : 1.;
+        resolution = (int)ceil(1./h) + 1;
+        dim->growthLUTError = maxError;
+    } else {
+        dim->growthLUTError = 0;
+    }
+    if (resolution < GROWTH_LUT_MIN) { resolution = GROWTH_LUT_MIN; }
+    if (resolution > GROWTH_LUT_MAX) { resolution = GROWTH_LUT_MAX; }
+    dim->growthLUTSize = resolution;
+    dim->growthMode = DIM_GROWTH_LUT;
+    buildGrowthLUT(dim);
+    return dim->growthLUTSize;
+}
+
+DIMAPI void setGrowthMode(Dimension *dim, DimGrowthMode mode) {
+    if (mode == DIM_GROWTH_LUT) {
+        //keeps the resolution or error bound of a previous setGrowthLUT
+        if (dim->growthLUTError > 0 || dim->growthLUTSize <= 0) { setGrowthLUT(dim, 0, dim->growthLUTError); }
+        else { setGrowthLUT(dim, dim->growthLUTSize, 0); }
+        return;
+    }
+    dim->growthMode = mode;
+}
+
+//shape of the growth, skew being the ratio of the widths above and below b of the asymmetric bump
+//the table of setGrowthLUT is resampled at the next step
+DIMAPI int setGrowthFunction(Dimension *dim, DimGrowthFunction function, float skew) {
+    if (function < 0 || function >= DIM_GROWTH_FUNCTION_COUNT || (function == DIM_GROWTH_CALLBACK && dim->growthCallback == NULL)) {
+        fprintf(stderr, "No growth function %d, callbacks are set with setGrowthCallback\n", (int)function);
+        return 1;
+    }
+    if (function == DIM_GROWTH_ASYMMETRIC && !(skew > 0.f)) {
+        fprintf(stderr, "The asymmetric growth needs a positive skew, not %g\n", skew);
+        return 1;
+    }
+    dim->growthFunction = function;
+    dim->growthSkew = skew;
+    free(dim->growthLUT);
+    dim->growthLUT = NULL;
+    return 0;
+}
+
+//growth given by a function of the sum and of a, b, c and d, for experiments : it is called for every cell and growth,
+//unless setGrowthLUT samples it once into a table
+DIMAPI void setGrowthCallback(Dimension *dim, DimGrowthCallback callback, void *user) {
+    dim->growthCallback = callback;
+    dim->growthUser = user;
+    if (callback != NULL) { setGrowthFunction(dim, DIM_GROWTH_CALLBACK, dim->growthSkew); }
+    else if (dim->growthFunction == DIM_GROWTH_CALLBACK) { setGrowthFunction(dim, DIM_GROWTH_GAUSSIAN, 0.f); }
+}
+
+DIMAPI DimGrowthFunction getGrowthFunction(Dimension *dim) {
+    return dim->growthFunction;
+}
+
+DIMAPI const char *getGrowthFunctionName(DimGrowthFunction function) {
+    return function >= 0 && function < DIM_GROWTH_FUNCTION_COUNT ? growthFunctionNames[function] : "unknown";
+}
+
+//function of that name, -1 if there is none
+DIMAPI int findGrowthFunction(const char *name) {
+    for (int k = 0; k < DIM_GROWTH_FUNCTION_COUNT; ++k) { if (strcmp(name, growthFunctionNames[k]) == 0) { return k; } }
+    return -1;
+}
+
+//loop of a built-in growth function, inlined with a constant function so that each gets a vectorized loop of its own
+static inline __attribute__((always_inline)) void growthLoop(Dimension *dim, DimGrowthFunction function, bool fast, const float *sums, float *states, int stride, int n) {
+    const float a = dim->a, b = dim->b, c = dim->c, d = dim->d, dt = dim->DT, skew = dim->growthSkew;
+    for (int i = 0; i < n; ++i) {
+        float s = states[i*stride] + growthShape(function, fast, sums[i], a, b, c, d, skew)*dt;
+        states[i*stride] = s > 1.f ? 1.f : s < 0.f ? 0.f : s;
+    }
+}
+
+//adds the growth of n states stride floats apart to them and clamps them, sums being their neighbour sums
+static inline __attribute__((always_inline)) void growthStrided(Dimension *dim, const float *sums, float *states, int stride, int n) {
+    if (dim->growthMode == DIM_GROWTH_LUT) {
+        const float *lut = dim->growthLUT;
+        const float last = (float)(dim->growthLUTSize-1);
+        for (int i = 0; i < n; ++i) {
+            float f = sums[i]*last;
+            if (f < 0.f) { f = 0.f; }
+            if (f > last) { f = last; }
+            int k = (int)f;
+            if (k > dim->growthLUTSize-2) { k = dim->growthLUTSize-2; }
+            float t = f - (float)k;
+            float s = states[i*stride] + lut[k] + t*(lut[k+1]-lut[k]);
+            states[i*stride] = s > 1.f ? 1.f : s < 0.f ? 0.f : s;
+        }
+        return;
+    }
+    bool fast = dim->growthMode == DIM_GROWTH_FASTEXP;
+    switch (dim->growthFunction) {
+        case DIM_GROWTH_POLYNOMIAL: growthLoop(dim, DIM_GROWTH_POLYNOMIAL, false, sums, states, stride, n); break;
+        case DIM_GROWTH_STEP: growthLoop(dim, DIM_GROWTH_STEP, false, sums, states, stride, n); break;
+        case DIM_GROWTH_ASYMMETRIC:
+            if (fast) { growthLoop(dim, DIM_GROWTH_ASYMMETRIC, true, sums, states, stride, n); }
+            else { growthLoop(dim, DIM_GROWTH_ASYMMETRIC, false, sums, states, stride, n); }
+            break;
+        case DIM_GROWTH_CALLBACK: {
+            const float params[4] = { dim->a, dim->b, dim->c, dim->d };
+            for (int i = 0; i < n; ++i) {
+                float s = states[i*stride] + dim->growthCallback(sums[i], params, dim->growthUser)*dim->DT;
+                states[i*stride] = s > 1.f ? 1.f : s < 0.f ? 0.f : s;
+            }
+            break;
+        }
+        default:
+            if (fast) { growthLoop(dim, DIM_GROWTH_GAUSSIAN, true, sums, states, stride, n); }
+            else { growthLoop(dim, DIM_GROWTH_GAUSSIAN, false, sums, states, stride, n); }
+            break;
+    }
+}
+
+//growth of the states of n cells
+void growthRow(Dimension *dim, const float *sums, Cell *cells, int n) {
+    growthStrided(dim, sums, &cells[0].state, sizeof(Cell)/sizeof(float), n);
+}
+
+//growth of n packed states
+void growthPlane(Dimension *dim, const float *sums, float *states, int n) {
+    growthStrided(dim, sums, states, 1, n);
+}
@@ -0,0 +1,136 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int prepareInPlace(Dimension *dim);
+void saveHaloTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void inPlaceTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+
+//a world without cells : the states only live in the plane, in the given storage, which each step overwrites
+//the viewers' upload, matrixInit and getMatrixPointer are not available, states are read with getStateRow
+DIMAPI Dimension *CreateInPlaceDimension(int w, int h, int kr, float dt, float rdmd, float a, float b, float c, float d, float nf, int ps, DimStorage storage) {
+    Dimension *dim = calloc(1, sizeof(Dimension));
+    if (dim == NULL) { return NULL; }
+    dim->MATRIXWIDTH = w;
+    dim->MATRIXHEIGHT = h;
+    dim->CELLSIZE = 1;
+    dim->KERNELRAD = kr;
+    dim->DT = dt;
+    dim->RDMDENSITY = rdmd;
+    dim->a = a;
+    dim->b = b;
+    dim->c = c;
+    dim->d = d;
+    dim->noisefactor = nf;
+    dim->patchsize = ps;
+    dim->threads = 1;
+    dim->engine = DIM_ENGINE_DIRECT;
+    dim->inPlace = 1;
+    dim->storage = storage;
+    dim->seed = defaultSeed();
+    //the pinned workers, if any, first touch the bands they step
+    startPlacedPool(dim);
+    dim->kernel = dimAlloc((2*kr+1)*(2*kr+1)*sizeof(float));
+    dim->plane = placedCalloc(dim, 1, h, (size_t)w*storageSize(storage));
+    dim->haloRows = malloc(h*sizeof(float *));
+    if (dim->kernel == NULL || dim->plane == NULL || dim->haloRows == NULL) {
+        fprintf(stderr, "Failed to allocate a %dx%d dimension\n", w, h);
+        DestroyDimension(dim);
+        return NULL;
+    }
+
+    genKernel(dim);
+    genSpans(dim);
+    if (dim->spans == NULL) {
+        DestroyDimension(dim);
+        return NULL;
+    }
+    return dim;
+}
+
+//2R saved rows per band, and a row of sums and one of states per worker
+int prepareInPlace(Dimension *dim) {
+    int r = dim->KERNELRAD, w = dim->MATRIXWIDTH;
+    float *halo = dimRealloc(dim->halo, (size_t)dim->threads*2*r*(w+2*r)*sizeof(float));
+    if (halo == NULL) { return 1; }
+    //the old buffer is already freed when it moved, keep the new one even if the scratch fails
+    dim->halo = halo;
+    if (prepareScratch(dim) != 0) { return 1; }
+    for (int k = 0; k < dim->threads; ++k) {
+        DimScratch *s = &dim->scratch[k];
+        if (s->tileCapacity >= 2*(size_t)w) { continue; }
+        dimFree(s->tile);
+        s->tile = dimAlloc(2*(size_t)w*sizeof(float));
+        s->tileCapacity = s->tile != NULL ? 2*(size_t)w : 0;
+        if (s->tile == NULL) { return 1; }
+    }
+    return 0;
+}
+
+//copies the R first and R last rows of the band before anyone overwrites them, they are the halos of the other bands
+void saveHaloTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    int r = dim->KERNELRAD, stride = dim->MATRIXWIDTH+2*r;
+    float *saved = dim->halo + (size_t)worker*2*r*stride;
+    for (int y = y0; y < y1; ++y) {
+        if (y < y0+r || y >= y1-r) {
+            loadRow(dim, y, saved);
+            dim->haloRows[y] = saved;
+            saved += stride;
+        } else {
+            dim->haloRows[y] = NULL;
+        }
+    }
+}
+
+//steps the rows [y0, y1) over themselves, the ring keeping the 2R+1 original rows around the current one
+//rows outside of the band come from the saved halos, the rows of the band are read before being overwritten
+void inPlaceTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimConvRow convRow = *(DimConvRow *)ctx;
+    int r = dim->KERNELRAD, side = 2*r+1, w = dim->MATRIXWIDTH, h = dim->MATRIXHEIGHT, stride = w+2*r;
+    DimScratch *s = &dim->scratch[worker];
+    float *sums = s->tile, *states = s->tile + w;
+    #define SLOT(y) (s->ring + (size_t)((((y) % side) + side) % side)*stride)
+    #define LOAD(y) { \
+        if ((y) < y0 || (y) >= y1) { memcpy(SLOT(y), dim->haloRows[(((y) % h) + h) % h], stride*sizeof(float)); } \
+        else { loadRow(dim, (y), SLOT(y)); } \
+    }
+
+    for (int y = y0-r; y < y0+r; ++y) { LOAD(y); }
+    for (int y = y0; y < y1; ++y) {
+        LOAD(y+r);
+        for (int k = 0; k < side; ++k) { s->rows[k] = SLOT(y-r+k); }
+        convRow(dim, s->rows, sums);
+        memcpy(states, SLOT(y) + r, w*sizeof(float));
+        growthPlane(dim, sums, states, w);
+        encodeRow(dim, y, states);
+    }
+    #undef LOAD
+    #undef SLOT
+}
+
+//one generation of an in-place world, the growth is fused in the sweep and the halo save stands for the swap
+void doStepInPlace(Dimension *dim) {
+    if (prepareInPlace(dim) != 0) {
+        fprintf(stderr, "Failed to allocate the in-place buffers, the dimension is not stepped\n");
+        return;
+    }
+    DimConvRow convRow = dim->convRow;
+    if (dim->engine == DIM_ENGINE_JIT && buildDimensionJIT(dim) == 0) {
+        DimGrowthRow growthRow = NULL;
+        getJITRows(dim, &convRow, &growthRow);
+    }
+
+    double t = dimClock();
+    parallelRows(dim, "halo", saveHaloTask, NULL);
+    t = lapPhase(dim, DIM_PHASE_SWAP, t);
+    prepareGrowth(dim);
+    parallelRows(dim, "in-place", inPlaceTask, &convRow);
+    lapPhase(dim, DIM_PHASE_CONVOLUTION, t);
+}
+
+void freeInPlace(Dimension *dim) {
+    dimFree(dim->halo);
+    free(dim->haloRows);
+    dim->halo = NULL;
+    dim->haloRows = NULL;
+}
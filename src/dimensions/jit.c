@@ -0,0 +1,262 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+//compiled code loaded for a Dimension, reloaded whenever the constants it bakes change
+typedef struct DimJIT {
+    uint64_t key;    //hash of the constants the loaded code was generated for
+    int failed;      //the build for key failed, the direct rows are used until the constants change
+    void *handle;
+    DimConvRow convRow;
+    DimGrowthRow growthRow;
+} DimJIT;
+
+uint64_t jitKey(Dimension *dim);
+void writeJITSource(Dimension *dim, FILE *fp);
+int jitDirectory(char *dir, size_t size);
+int loadJIT(Dimension *dim, DimJIT *jit);
+int runCompiler(const char *cc, const char *flags, const char *out, const char *src);
+void closeJIT(DimJIT *jit);
+
+//fnv-1a
+uint64_t hashBytes(uint64_t h, const void *data, size_t n) {
+    const unsigned char *p = data;
+    for (size_t k = 0; k < n; ++k) {
+        h ^= p[k];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+//everything the generated code depends on
+uint64_t jitKey(Dimension *dim) {
+    int side = 2*dim->KERNELRAD+1;
+    float params[] = { dim->a, dim->b, dim->c, dim->d, dim->DT, dim->kSum };
+    int shape[] = { dim->MATRIXWIDTH, dim->KERNELRAD };
+    uint64_t h = 0xcbf29ce484222325ull;
+    h = hashBytes(h, shape, sizeof(shape));
+    h = hashBytes(h, params, sizeof(params));
+    return hashBytes(h, dim->kernel, (size_t)side*side*sizeof(float));
+}
+
+//writes the row convolution and growth of dim with its width, taps and parameters as literals
+void writeJITSource(Dimension *dim, FILE *fp) {
+    int r = dim->KERNELRAD, side = 2*r+1, w = dim->MATRIXWIDTH;
+    fprintf(fp, "//generated by libdimensions for a %d wide world, R = %d\n", w, r);
+    fprintf(fp, "#include <math.h>\n\n");
+    fprintf(fp, "typedef struct Cell { float x, y, state, oldState; } Cell;\n");
+    fprintf(fp, "struct Dimension;\n\n");
+
+    //unrolling every tap makes compilers crawl past a few hundred taps, the taps stay a table of literals
+    fprintf(fp, "static const float taps[%d] = {", side*side);
+    for (int k = 0; k < side*side; ++k) { fprintf(fp, "%s%af,", k % 8 == 0 ? "\n   " : " ", dim->kernel[k]); }
+    fprintf(fp, "\n};\n\n");
+    fprintf(fp, "#define ROW(K, LO, HI) { \\\n");
+    fprintf(fp, "    const float *row = rows[K] + x; \\\n");
+    fprintf(fp, "    for (int t = LO; t <= HI; ++t) { \\\n");
+    fprintf(fp, "        const float tap = taps[K*%d+t]; \\\n", side);
+    fprintf(fp, "        for (int i = 0; i < n; ++i) { acc[i] += tap*row[t+i]; } \\\n");
+    fprintf(fp, "    } \\\n}\n\n");
+
+    //the spans are those of convRowRange so the sums are the same
+    fprintf(fp, "static inline __attribute__((always_inline)) void convBlock(const float **rows, float *out, int x, int n) {\n");
+    fprintf(fp, "    float acc[%d] = { 0.f };\n", DIM_CONV_BLOCK);
+    for (int k = 0; k < side; ++k) {
+        if (dim->spans[2*k] > dim->spans[2*k+1]) { continue; }
+        fprintf(fp, "    ROW(%d, %d, %d)\n", k, dim->spans[2*k], dim->spans[2*k+1]);
+    }
+    fprintf(fp, "    for (int i = 0; i < n; ++i) { out[x+i] = acc[i]*%af; }\n}\n\n", 1.f/dim->kSum);
+    fprintf(fp, "void dimJITConvRow(struct Dimension *dim, const float **rows, float *out) {\n");
+    fprintf(fp, "    int x = 0;\n");
+    fprintf(fp, "    for (; x+%d <= %d; x += %d) { convBlock(rows, out, x, %d); }\n", DIM_CONV_BLOCK, w, DIM_CONV_BLOCK, DIM_CONV_BLOCK);
+    if (w % DIM_CONV_BLOCK != 0) { fprintf(fp, "    convBlock(rows, out, x, %d);\n", w % DIM_CONV_BLOCK); }
+    fprintf(fp, "}\n\n");
+
+    //same expression as growthValue, the constants fold to the same floats
+    fprintf(fp, "void dimJITGrowthRow(const float *sums, Cell *cells, int n) {\n");
+    fprintf(fp, "    const float a = %af, b = %af, c = %af, d = %af, dt = %af;\n", dim->a, dim->b, dim->c, dim->d, dim->DT);
+    fprintf(fp, "    for (int i = 0; i < n; ++i) {\n");
+    fprintf(fp, "        float sum = sums[i];\n");
+    fprintf(fp, "        float s = cells[i].state + (a * expf(-(sum-b)*(sum-b)/(2*c*c))+d)*dt;\n");
+    fprintf(fp, "        cells[i].state = s > 1.f ? 1.f : s < 0.f ? 0.f : s;\n");
+    fprintf(fp, "    }\n}\n");
+}
+
+#if defined(_WIN32)
+
+int loadJIT(Dimension *dim, DimJIT *jit) {
+    fprintf(stderr, "The jit engine is not available on windows, stepping with the direct engine\n");
+    return 1;
+}
+
+void closeJIT(DimJIT *jit) {}
+
+#else
+
+void closeJIT(DimJIT *jit) {
+    if (jit->handle != NULL) { dlclose(jit->handle); }
+    jit->handle = NULL;
+    jit->convRow = NULL;
+    jit->growthRow = NULL;
+}
+
+//directory of the compiled libraries : $DIM_JIT_DIR, else jit in the cache directory of the user, else $TMPDIR/dimensions-jit-<uid>
+//the libraries found there are loaded in the process, so it must be a directory of this user that no one else can write to
+int jitDirectory(char *dir, size_t size) {
+    char cache[512];
+    if (getenv("DIM_JIT_DIR") != NULL) {
+        snprintf(dir, size, "%s", getenv("DIM_JIT_DIR"));
+    } else if (cacheDirectory(cache, sizeof(cache)) == 0) {
+        snprintf(dir, size, "%s/jit", cache);
+    } else {
+        snprintf(dir, size, "%s/dimensions-jit-%ld", getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp", (long)getuid());
+    }
+    struct stat st;
+    if ((mkdir(dir, 0700) != 0 && errno != EEXIST) || lstat(dir, &st) != 0) {
+        fprintf(stderr, "Failed to make the jit directory \"%s\"\n", dir);
+        return 1;
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077) != 0) {
+        fprintf(stderr, "The jit directory \"%s\" is not a directory of this user with mode 0700, it is not used\n", dir);
+        return 1;
+    }
+    return 0;
+}
+
+//compiles src into the shared library out, cc and flags being split on whitespace into the arguments of the compiler,
+//which runs without a shell so that nothing in them is interpreted, returns 0 when it exits with 0
+int runCompiler(const char *cc, const char *flags, const char *out, const char *src) {
+    const char *fixed[] = { "-shared", "-fPIC", "-o", out, src, "-lm" };
+    size_t fixedCount = sizeof(fixed)/sizeof(fixed[0]), words = strlen(cc) + strlen(flags) + 2;
+    char *line = malloc(words);
+    char **argv = malloc((words/2 + 1 + fixedCount + 1)*sizeof(char *));
+    if (line == NULL || argv == NULL) {
+        free(line);
+        free(argv);
+        return 1;
+    }
+    snprintf(line, words, "%s %s", cc, flags);
+    size_t argc = 0;
+    char *save = NULL;
+    for (char *word = strtok_r(line, " \t\n", &save); word != NULL; word = strtok_r(NULL, " \t\n", &save)) { argv[argc++] = word; }
+    for (size_t k = 0; k < fixedCount; ++k) { argv[argc++] = (char *)fixed[k]; }
+    argv[argc] = NULL;
+
+    pid_t pid;
+    int status = 0, failed = argc == fixedCount || posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ) != 0;
+    while (!failed && waitpid(pid, &status, 0) < 0) { failed = errno != EINTR; }
+    free(line);
+    free(argv);
+    return failed || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+//builds (or finds in the cache) the library for the current constants and loads it
+//the cache is keyed by a hash of the source and command
+int loadJIT(Dimension *dim, DimJIT *jit) {
+    const char *cc = getenv("DIM_JIT_CC") != NULL ? getenv("DIM_JIT_CC") : "cc";
+    const char *flags = getenv("DIM_JIT_CFLAGS") != NULL ? getenv("DIM_JIT_CFLAGS") : "-O3 -march=native -ffp-contract=off";
+    char dir[512], src[600], lib[600], tmp[640], cmd[2048];
+    if (jitDirectory(dir, sizeof(dir)) != 0) { return 1; }
+
+    char *code = NULL;
+    size_t length = 0;
+    FILE *mem = open_memstream(&code, &length);
+    if (mem == NULL) { return 1; }
+    writeJITSource(dim, mem);
+    fclose(mem);
+    uint64_t h = hashBytes(0xcbf29ce484222325ull, code, length);
+    h = hashBytes(h, cc, strlen(cc));
+    h = hashBytes(h, flags, strlen(flags));
+    snprintf(src, sizeof(src), "%s/dimjit-%016llx.c", dir, (unsigned long long)h);
+    snprintf(lib, sizeof(lib), "%s/dimjit-%016llx.so", dir, (unsigned long long)h);
+
+    if (access(lib, R_OK) != 0) {
+        int fd = open(src, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+        FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (fp == NULL && fd >= 0) { close(fd); }
+        if (fp == NULL || fwrite(code, 1, length, fp) != length) {
+            fprintf(stderr, "Failed to write the jit source \"%s\"\n", src);
+            if (fp != NULL) { fclose(fp); }
+            free(code);
+            return 1;
+        }
+        fclose(fp);
+        //built under a private name then renamed, so concurrent processes never load a partial library
+        snprintf(tmp, sizeof(tmp), "%s.%ld", lib, (long)getpid());
+        if (runCompiler(cc, flags, tmp, src) != 0 || rename(tmp, lib) != 0) {
+            snprintf(cmd, sizeof(cmd), "%s %s -shared -fPIC -o %s %s -lm", cc, flags, tmp, src);
+            fprintf(stderr, "Failed to compile the jit source with \"%s\", stepping with the direct engine\n", cmd);
+            remove(tmp);
+            free(code);
+            return 1;
+        }
+    }
+    free(code);
+
+    void *handle = dlopen(lib, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "Failed to load \"%s\" : %s\n", lib, dlerror());
+        return 1;
+    }
+    DimConvRow convRow = (DimConvRow)dlsym(handle, "dimJITConvRow");
+    DimGrowthRow growthRow = (DimGrowthRow)dlsym(handle, "dimJITGrowthRow");
+    if (convRow == NULL || growthRow == NULL) {
+        fprintf(stderr, "\"%s\" misses the jit entry points\n", lib);
+        dlclose(handle);
+        return 1;
+    }
+    closeJIT(jit);
+    jit->handle = handle;
+    jit->convRow = convRow;
+    jit->growthRow = growthRow;
+    return 0;
+}
+
+#endif
+
+//makes sure the loaded code matches the current constants, returns 0 when it can be used
+DIMAPI int buildDimensionJIT(Dimension *dim) {
+    if (dim->jit == NULL) {
+        dim->jit = calloc(1, sizeof(DimJIT));
+        if (dim->jit == NULL) { return 1; }
+    }
+    DimJIT *jit = dim->jit;
+    uint64_t key = jitKey(dim);
+    if (key == jit->key && (jit->handle != NULL || jit->failed)) { return jit->failed; }
+
+    double t = dimClock();
+    DIM_TRACE_BEGIN("jit");
+    jit->key = key;
+    jit->failed = loadJIT(dim, jit);
+    if (jit->failed) { closeJIT(jit); }
+    DIM_TRACE_END("jit");
+    addPhaseTime(dim, DIM_PHASE_JIT, dimClock() - t);
+    return jit->failed;
+}
+
+//row functions of the loaded code, left untouched when there is none
+void getJITRows(Dimension *dim, DimConvRow *convRow, DimGrowthRow *growthRow) {
+    if (dim->jit == NULL || dim->jit->handle == NULL) { return; }
+    *convRow = dim->jit->convRow;
+    //the generated growth is the exact gaussian, the other functions keep the library's loops
+    if (dim->growthMode == DIM_GROWTH_EXACT && dim->growthFunction == DIM_GROWTH_GAUSSIAN) { *growthRow = dim->jit->growthRow; }
+}
+
+void freeJIT(Dimension *dim) {
+    if (dim->jit == NULL) { return; }
+    closeJIT(dim->jit);
+    free(dim->jit);
+    dim->jit = NULL;
+}
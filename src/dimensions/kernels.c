@@ -0,0 +1,268 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//spectrum of a set of scaled taps over a plane, see fftconv.c
+typedef struct DimKernelSpectrum {
+    uint64_t key;
+    float *spectrum;
+    unsigned long used; //trims survived since its last use
+    struct DimKernelSpectrum *next;
+} DimKernelSpectrum;
+
+//kernel shapes compiled for a dimension : presets are computed once, then switching between them only swaps taps
+typedef struct DimKernelCache {
+    DimCompiledKernel *kernels;
+    DimKernelSpectrum *spectra;
+    int spectrumCount;
+    unsigned long stamp;
+} DimKernelCache;
+
+//a built-in kernel function, the callback having no entry of its own
+typedef struct DimKernelEntry {
+    const char *name;
+    float (*value)(float r);
+} DimKernelEntry;
+
+float kernelPolynomial(float r);
+float kernelStep(float r);
+DimKernelCache *getKernelCache(Dimension *dim);
+int recompileKernels(Dimension *dim);
+
+//kernels are sampled once per shape and cached, their functions need no fast paths
+const DimKernelEntry kernelFunctions[DIM_KERNEL_FUNCTION_COUNT] = {
+    { "exponential", kernelF },
+    { "polynomial", kernelPolynomial },
+    { "step", kernelStep },
+    { "callback", NULL },
+};
+
+float kernelPolynomial(float r) {
+    float q = 4*r*(1-r);
+    return (q*q)*(q*q);
+}
+
+float kernelStep(float r) {
+    return r >= .25f && r <= .75f ? 1.f : 0.f;
+}
+
+//value of the kernel function of dim at the relative radius r in (0, 1)
+float kernelValue(const Dimension *dim, float r) {
+    if (dim->kernelFunction == DIM_KERNEL_CALLBACK) { return dim->kernelCallback(r, dim->kernelUser); }
+    return kernelFunctions[dim->kernelFunction].value(r);
+}
+
+//value of the kernel at the relative radius d in (0, 1] : shell i of n covers [i/n, (i+1)/n) with a bump of height peaks[i]
+//a single shell of peak 1 is the kernel function itself
+float shellValue(Dimension *dim, float d, int shells, const float *peaks) {
+    float x = d*shells;
+    int i = (int)x;
+    if (i >= shells) { return 0.f; }
+    return peaks[i]*kernelValue(dim, x - i);
+}
+
+//fills the (2r+1)^2 taps of a kernel of radius r made of shells, returns their sum
+float shellTaps(Dimension *dim, float *taps, int r, int shells, const float *peaks) {
+    float sum = 0.f;
+    for (int i = -r ; i <= r ; ++i){
+        for (int j = -r ; j <= r ; ++j) {
+            float d = sqrtf(i*i+j*j)/r;
+            if (d > 1 || d == 0) {
+                taps[(i+r)*(2*r+1)+(j+r)] = .0f;
+                continue;
+            }
+            float k = shellValue(dim, d, shells, peaks);
+            taps[(i+r)*(2*r+1)+(j+r)] = k;
+            sum += k;
+        }
+    }
+    return sum;
+}
+
+DimKernelCache *getKernelCache(Dimension *dim) {
+    if (dim->kernelCache == NULL) { dim->kernelCache = calloc(1, sizeof(DimKernelCache)); }
+    return dim->kernelCache;
+}
+
+//taps of the kernel of a radius and shells of the current kernel function, computed on the first call
+//NULL if the shape is not valid
+const DimCompiledKernel *compileKernel(Dimension *dim, int radius, int shells, const float *peaks) {
+    DimKernelCache *cache = getKernelCache(dim);
+    if (cache == NULL) { return NULL; }
+    if (shells < 1 || shells > DIM_MAX_SHELLS || radius < 1) {
+        fprintf(stderr, "No kernel of radius %d with %d shells, 1 to %d are allowed\n", radius, shells, DIM_MAX_SHELLS);
+        return NULL;
+    }
+    for (DimCompiledKernel *k = cache->kernels; k != NULL; k = k->next) {
+        if (k->radius == radius && k->shells == shells && memcmp(k->peaks, peaks, shells*sizeof(float)) == 0
+            && k->function == dim->kernelFunction && k->callback == dim->kernelCallback && k->user == dim->kernelUser) { return k; }
+    }
+
+    int side = 2*radius+1;
+    DimCompiledKernel *k = calloc(1, sizeof(DimCompiledKernel));
+    if (k == NULL) { return NULL; }
+    k->radius = radius;
+    k->shells = shells;
+    memcpy(k->peaks, peaks, shells*sizeof(float));
+    k->function = dim->kernelFunction;
+    k->callback = dim->kernelCallback;
+    k->user = dim->kernelUser;
+    k->raw = malloc(side*side*sizeof(float));
+    k->taps = malloc(side*side*sizeof(float));
+    if (k->raw == NULL || k->taps == NULL) {
+        free(k->raw);
+        free(k->taps);
+        free(k);
+        return NULL;
+    }
+    k->sum = shellTaps(dim, k->raw, radius, shells, peaks);
+    if (!(k->sum > 0.f)) {
+        fprintf(stderr, "The kernel of radius %d with %d shells has no positive weight\n", radius, shells);
+        free(k->raw);
+        free(k->taps);
+        free(k);
+        return NULL;
+    }
+    for (int t = 0; t < side*side; ++t) { k->taps[t] = k->raw[t]/k->sum; }
+    k->next = cache->kernels;
+    cache->kernels = k;
+    return k;
+}
+
+//spectrum stored under key, NULL if there is none
+float *findSpectrum(Dimension *dim, uint64_t key) {
+    DimKernelCache *cache = dim->kernelCache;
+    if (cache == NULL) { return NULL; }
+    for (DimKernelSpectrum *s = cache->spectra; s != NULL; s = s->next) {
+        if (s->key != key) { continue; }
+        s->used = cache->stamp;
+        return s->spectrum;
+    }
+    return NULL;
+}
+
+//hands a spectrum allocated with dimAlloc to the cache, returns 1 if it could not take it
+int storeSpectrum(Dimension *dim, uint64_t key, float *spectrum) {
+    DimKernelCache *cache = getKernelCache(dim);
+    DimKernelSpectrum *s = cache != NULL ? calloc(1, sizeof(DimKernelSpectrum)) : NULL;
+    if (s == NULL) { return 1; }
+    s->key = key;
+    s->spectrum = spectrum;
+    s->used = cache->stamp;
+    s->next = cache->spectra;
+    cache->spectra = s;
+    cache->spectrumCount++;
+    return 0;
+}
+
+//drops the least recently used spectra beyond DIM_SPECTRA_CACHE, except those of the current convolution
+void trimSpectra(Dimension *dim) {
+    DimKernelCache *cache = dim->kernelCache;
+    if (cache == NULL) { return; }
+    while (cache->spectrumCount > DIM_SPECTRA_CACHE) {
+        DimKernelSpectrum **oldest = NULL;
+        for (DimKernelSpectrum **s = &cache->spectra; *s != NULL; s = &(*s)->next) {
+            if ((*s)->used != cache->stamp && (oldest == NULL || (*s)->used < (*oldest)->used)) { oldest = s; }
+        }
+        if (oldest == NULL) { break; }
+        DimKernelSpectrum *dead = *oldest;
+        *oldest = dead->next;
+        dimFree(dead->spectrum);
+        free(dead);
+        cache->spectrumCount--;
+    }
+    cache->stamp++;
+}
+
+void freeKernelCache(Dimension *dim) {
+    DimKernelCache *cache = dim->kernelCache;
+    if (cache == NULL) { return; }
+    while (cache->kernels != NULL) {
+        DimCompiledKernel *k = cache->kernels;
+        cache->kernels = k->next;
+        free(k->raw);
+        free(k->taps);
+        free(k);
+    }
+    while (cache->spectra != NULL) {
+        DimKernelSpectrum *s = cache->spectra;
+        cache->spectra = s->next;
+        dimFree(s->spectrum);
+        free(s);
+    }
+    free(cache);
+    dim->kernelCache = NULL;
+}
+
+//makes dim->kernel count concentric shells of the given peaks, 0 going back to the single bump of the kernel function
+//the radius stays, so does the rest of the world : the taps of each shape are computed once and the fft engine
+//keeps their spectra, switching between presets costs a copy of the taps
+DIMAPI int setKernelShells(Dimension *dim, int count, const float *peaks) {
+    const float one = 1.f;
+    const DimCompiledKernel *k = count > 0 ? compileKernel(dim, dim->KERNELRAD, count, peaks) : compileKernel(dim, dim->KERNELRAD, 1, &one);
+    if (k == NULL) { return 1; }
+    int side = 2*dim->KERNELRAD+1;
+    dim->kernelShells = count;
+    memset(dim->kernelPeaks, 0, sizeof(dim->kernelPeaks));
+    if (count > 0) { memcpy(dim->kernelPeaks, peaks, count*sizeof(float)); }
+    memcpy(dim->kernel, k->raw, side*side*sizeof(float));
+    dim->kSum = k->sum;
+    genSpans(dim);
+    return dim->spans == NULL;
+}
+
+//makes the kernel of dim and those of its channels again with the current kernel function, keeping their shells
+int recompileKernels(Dimension *dim) {
+    float peaks[DIM_MAX_SHELLS];
+    memcpy(peaks, dim->kernelPeaks, sizeof(peaks));
+    if (setKernelShells(dim, dim->kernelShells, peaks) != 0) { return 1; }
+    return recompileChannelKernels(dim);
+}
+
+//function of the kernel and of the shells of every kernel of dim, the shapes already made with another are kept
+DIMAPI int setKernelFunction(Dimension *dim, DimKernelFunction function) {
+    if (function < 0 || function >= DIM_KERNEL_FUNCTION_COUNT || (function == DIM_KERNEL_CALLBACK && dim->kernelCallback == NULL)) {
+        fprintf(stderr, "No kernel function %d, callbacks are set with setKernelCallback\n", (int)function);
+        return 1;
+    }
+    DimKernelFunction previous = dim->kernelFunction;
+    dim->kernelFunction = function;
+    if (recompileKernels(dim) != 0) {
+        fprintf(stderr, "Failed to make the kernels with the %s function, keeping the %s one\n", getKernelFunctionName(function), getKernelFunctionName(previous));
+        dim->kernelFunction = previous;
+        recompileKernels(dim);
+        return 1;
+    }
+    return 0;
+}
+
+//kernels given by a function of the relative radius, for experiments : it is only called to make their taps
+DIMAPI int setKernelCallback(Dimension *dim, DimKernelCallback callback, void *user) {
+    DimKernelCallback previousCallback = dim->kernelCallback;
+    void *previousUser = dim->kernelUser;
+    dim->kernelCallback = callback;
+    dim->kernelUser = user;
+    int failed = 0;
+    if (callback != NULL) { failed = setKernelFunction(dim, DIM_KERNEL_CALLBACK); }
+    else if (dim->kernelFunction == DIM_KERNEL_CALLBACK) { failed = setKernelFunction(dim, DIM_KERNEL_EXPONENTIAL); }
+    if (failed) {
+        dim->kernelCallback = previousCallback;
+        dim->kernelUser = previousUser;
+    }
+    return failed;
+}
+
+DIMAPI DimKernelFunction getKernelFunction(Dimension *dim) {
+    return dim->kernelFunction;
+}
+
+DIMAPI const char *getKernelFunctionName(DimKernelFunction function) {
+    return function >= 0 && function < DIM_KERNEL_FUNCTION_COUNT ? kernelFunctions[function].name : "unknown";
+}
+
+//function of that name, -1 if there is none
+DIMAPI int findKernelFunction(const char *name) {
+    for (int k = 0; k < DIM_KERNEL_FUNCTION_COUNT; ++k) { if (strcmp(name, kernelFunctions[k].name) == 0) { return k; } }
+    return -1;
+}
@@ -0,0 +1,71 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+typedef struct DimTileKey {
+    uint32_t code;
+    int tile;
+} DimTileKey;
+
+int compareTileKeys(const void *a, const void *b);
+
+//spreads the 16 low bits of v over the even bits
+static inline uint32_t spreadBits(uint32_t v) {
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+int compareTileKeys(const void *a, const void *b) {
+    uint32_t ca = ((const DimTileKey *)a)->code, cb = ((const DimTileKey *)b)->code;
+    return ca < cb ? -1 : ca > cb;
+}
+
+//cells of the plane, the morton layout pads the grid to whole tiles
+size_t planeLength(Dimension *dim, DimLayout layout) {
+    if (layout == DIM_LAYOUT_ROWS) { return (size_t)dim->MATRIXWIDTH*dim->MATRIXHEIGHT; }
+    size_t tilesX = (dim->MATRIXWIDTH + DIM_TILE_SIDE-1)/DIM_TILE_SIDE;
+    size_t tilesY = (dim->MATRIXHEIGHT + DIM_TILE_SIDE-1)/DIM_TILE_SIDE;
+    return tilesX*tilesY*DIM_TILE_SIDE*DIM_TILE_SIDE;
+}
+
+//rank of every tile along the Z curve, ranks skip the curve outside of the grid so the plane stays compact
+int *buildTileOrder(Dimension *dim) {
+    int tilesX = (dim->MATRIXWIDTH + DIM_TILE_SIDE-1)/DIM_TILE_SIDE;
+    int tilesY = (dim->MATRIXHEIGHT + DIM_TILE_SIDE-1)/DIM_TILE_SIDE;
+    int count = tilesX*tilesY;
+    int *order = malloc(count*sizeof(int));
+    DimTileKey *keys = malloc(count*sizeof(DimTileKey));
+    if (order == NULL || keys == NULL) {
+        free(order);
+        free(keys);
+        return NULL;
+    }
+    for (int t = 0; t < count; ++t) {
+        keys[t].code = spreadBits(t % tilesX) | spreadBits(t / tilesX) << 1;
+        keys[t].tile = t;
+    }
+    qsort(keys, count, sizeof(DimTileKey), compareTileKeys);
+    for (int k = 0; k < count; ++k) { order[keys[k].tile] = k; }
+    free(keys);
+    return order;
+}
+
+//vertically adjacent cells share cache lines and pages, at the cost of rows being read in runs of a tile's width
+DIMAPI int setStateLayout(Dimension *dim, DimLayout layout) {
+    if (layout == dim->layout) { return 0; }
+    if (layout != DIM_LAYOUT_ROWS && layout != DIM_LAYOUT_MORTON) { return 1; }
+    if (dim->volume != NULL) {
+        fprintf(stderr, "A volume only has the row layout\n");
+        return 1;
+    }
+    return repackPlane(dim, dim->storage, layout);
+}
+
+DIMAPI DimLayout getStateLayout(Dimension *dim) {
+    return dim->layout;
+}
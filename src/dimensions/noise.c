@@ -0,0 +1,217 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//spatially correlated noise : white gaussian noise smoothed by a gaussian filter, made in the frequency domain
+//the spectrum of white noise is white noise, it is drawn directly and only the inverse transform is made
+//the real and imaginary parts of the result are two independent fields, the second one serves the next call
+typedef struct DimNoiseField {
+    int w, h;
+    float length;
+    DimFFT2D *plan;
+    float *filter; //gain of each frequency, with the 1/wh of the inverse and the unit variance folded in
+    bool *rows;    //rows of the spectrum with a gain left, the others stay zero and are not transformed
+    float *plane;  //w x h complex
+    bool spare;    //the imaginary part is unused and the world is still at the draw it was made for
+    uint64_t seed, draws;
+} DimNoiseField;
+
+//what a noise pass adds to the rows
+typedef struct DimNoisePass {
+    DimNoise kind;
+    uint64_t key;
+    const float *field; //correlated noise, a part of the complex plane
+} DimNoisePass;
+
+int prepareNoiseField(Dimension *dim);
+void spectrumTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void noiseTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+
+//noise added by noisify : uniform in [-noisefactor, noisefactor], or gaussian of deviation noisefactor,
+//white or correlated over about length cells
+DIMAPI int setNoise(Dimension *dim, DimNoise kind, float length) {
+    if (kind == DIM_NOISE_CORRELATED && !(length > 0.f)) {
+        fprintf(stderr, "Correlated noise needs a positive length, not %g\n", length);
+        return 1;
+    }
+    if (kind != dim->noise || length != dim->noiseLength) { freeNoise(dim); }
+    dim->noise = kind;
+    dim->noiseLength = length;
+    return 0;
+}
+
+DIMAPI DimNoise getNoise(Dimension *dim) {
+    return dim->noise;
+}
+
+//noisify after every n generations of doStep and doSteps, 0 to stop
+DIMAPI void setStepNoise(Dimension *dim, int every) {
+    dim->stepNoise = every > 0 ? every : 0;
+    dim->stepNoiseClock = 0;
+}
+
+DIMAPI int getStepNoise(Dimension *dim) {
+    return dim->stepNoise;
+}
+
+void stepNoise(Dimension *dim) {
+    if (dim->stepNoise <= 0 || ++dim->stepNoiseClock < dim->stepNoise) { return; }
+    dim->stepNoiseClock = 0;
+    noisify(dim);
+}
+
+void freeNoise(Dimension *dim) {
+    DimNoiseField *f = dim->noiseField;
+    if (f == NULL) { return; }
+    destroyFFT2D(f->plan);
+    dimFree(f->filter);
+    free(f->rows);
+    dimFree(f->plane);
+    free(f);
+    dim->noiseField = NULL;
+}
+
+//plans the transforms and samples the filter, exp(-2 pi^2 l^2 |f|^2) being the spectrum of a gaussian of deviation l cells
+int prepareNoiseField(Dimension *dim) {
+    int w = dim->MATRIXWIDTH, h = dim->MATRIXHEIGHT;
+    DimNoiseField *f = dim->noiseField;
+    if (f != NULL && f->w == w && f->h == h && f->length == dim->noiseLength) { return 0; }
+    freeNoise(dim);
+    f = calloc(1, sizeof(DimNoiseField));
+    if (f == NULL) { return 1; }
+    dim->noiseField = f;
+    f->w = w;
+    f->h = h;
+    f->length = dim->noiseLength;
+    f->plan = createFFT2D(w, h);
+    f->filter = dimAlloc((size_t)w*h*sizeof(float));
+    f->rows = calloc(h, sizeof(bool));
+    f->plane = dimAlloc(2*(size_t)w*h*sizeof(float));
+    if (f->plan == NULL || f->filter == NULL || f->rows == NULL || f->plane == NULL) {
+        freeNoise(dim);
+        return 1;
+    }
+
+    double l2 = 2.*M_PI*M_PI*(double)f->length*f->length, power = 0.;
+    for (int ky = 0; ky < h; ++ky) {
+        double fy = (double)(ky <= h/2 ? ky : ky-h)/h;
+        for (int kx = 0; kx < w; ++kx) {
+            double fx = (double)(kx <= w/2 ? kx : kx-w)/w;
+            //gains too small to move a float state are dropped, most rows of a long correlation vanish
+            double g = exp(-l2*(fx*fx + fy*fy));
+            g = g < 1e-7 ? 0. : g;
+            f->filter[(size_t)ky*w + kx] = (float)g;
+            f->rows[ky] = f->rows[ky] || g > 0.;
+            power += g*g;
+        }
+    }
+    //the inverse of a spectrum of unit normal parts filtered by g has parts of variance sum(g^2)/(wh)^2
+    float scale = (float)(1./sqrt(power));
+    for (size_t k = 0; k < (size_t)w*h; ++k) { f->filter[k] *= scale; }
+    return 0;
+}
+
+//filtered spectrum of complex white noise, both parts standard normal, one stream per row
+void spectrumTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    uint64_t key = *(const uint64_t *)ctx;
+    DimNoiseField *f = dim->noiseField;
+    int w = f->w;
+    for (int y = y0; y < y1; ++y) {
+        float *dst = f->plane + 2*(size_t)y*w;
+        if (!f->rows[y]) {
+            memset(dst, 0, 2*(size_t)w*sizeof(float));
+            continue;
+        }
+        uint32_t row = (uint32_t)dimSubKey(key, y);
+        const float *gain = f->filter + (size_t)y*w;
+        for (int x = 0; x < w; ++x) {
+            float im, re = dimGaussian(row, x, &im);
+            dst[2*x] = re*gain[x];
+            dst[2*x+1] = im*gain[x];
+        }
+    }
+}
+
+//adds the noise of the pass to the states of the rows [y0, y1)
+void noiseTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimNoisePass *pass = ctx;
+    int w = dim->MATRIXWIDTH;
+    const float nf = dim->noisefactor;
+    float *noise = malloc(2*(size_t)w*sizeof(float)), *states = noise + w;
+    if (noise == NULL) {
+        fprintf(stderr, "Failed to allocate the rows of the noised bands\n");
+        return;
+    }
+    for (int y = y0; y < y1; ++y) {
+        uint32_t row = (uint32_t)dimSubKey(pass->key, y);
+        if (pass->kind == DIM_NOISE_UNIFORM) {
+            for (int x = 0; x < w; ++x) { noise[x] = (dimUniform(dimDraw(row, x))*2.f - 1.f)*nf; }
+        } else if (pass->kind == DIM_NOISE_GAUSSIAN) {
+            float unused;
+            for (int x = 0; x < w; ++x) { noise[x] = dimGaussian(row, x, &unused)*nf; }
+        } else {
+            const float *field = pass->field + 2*(size_t)y*w;
+            for (int x = 0; x < w; ++x) { noise[x] = field[2*x]*nf; }
+        }
+        if (dim->volume != NULL) {
+            float *row = volumeRow(dim, y);
+            for (int x = 0; x < w; ++x) { row[x] += noise[x]; }
+        } else if (dim->inPlace) {
+            decodeRow(dim, y, states);
+            for (int x = 0; x < w; ++x) { states[x] += noise[x]; }
+            encodeRow(dim, y, states);
+        } else {
+            Cell *cells = &dim->matrix[(size_t)y*w];
+            for (int x = 0; x < w; ++x) { cells[x].state += noise[x]; }
+        }
+    }
+    free(noise);
+}
+
+//every call draws the next stream of the world's seed, the same noise for any thread count
+//the rows of a volume are noised as one tall plane, its noise can't be correlated
+DIMAPI void noisify(Dimension *dim) {
+    double t = dimClock();
+    DIM_TRACE_BEGIN("noise");
+    DimNoisePass pass = { dim->noise, dimSubKey(dim->seed, dim->draws), NULL };
+    if (dim->volume != NULL) {
+        if (dim->noise == DIM_NOISE_CORRELATED) {
+            fprintf(stderr, "Correlated noise is only made for planes, the volume is not noised\n");
+            DIM_TRACE_END("noise");
+            return;
+        }
+        dim->draws++;
+        parallelRange(dim, "noise", noiseTask, &pass, 0, dim->MATRIXHEIGHT*getMatrixDepth(dim));
+        lapPhase(dim, DIM_PHASE_NOISE, t);
+        DIM_TRACE_END("noise");
+        return;
+    }
+    if (dim->noise == DIM_NOISE_CORRELATED) {
+        DimNoiseField *f = prepareNoiseField(dim) == 0 ? dim->noiseField : NULL;
+        if (f == NULL) {
+            fprintf(stderr, "Failed to allocate the correlated noise of a %dx%d dimension, it is not noised\n", dim->MATRIXWIDTH, dim->MATRIXHEIGHT);
+            DIM_TRACE_END("noise");
+            return;
+        }
+        if (f->spare && f->seed == dim->seed && f->draws == dim->draws) {
+            pass.field = f->plane + 1;
+            f->spare = false;
+        } else {
+            parallelRows(dim, "noise spectrum", spectrumTask, &pass.key);
+            if (fft2D(dim, f->plan, f->plane, true, f->rows) != 0) {
+                fprintf(stderr, "Failed to allocate the transforms of the correlated noise, the dimension is not noised\n");
+                DIM_TRACE_END("noise");
+                return;
+            }
+            pass.field = f->plane;
+            f->spare = true;
+            f->seed = dim->seed;
+            f->draws = dim->draws+1;
+        }
+    }
+    dim->draws++;
+    parallelRows(dim, "noise", noiseTask, &pass);
+    lapPhase(dim, DIM_PHASE_NOISE, t);
+    DIM_TRACE_END("noise");
+}
@@ -0,0 +1,146 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+//a square of random cells dropped by randomizeDimensionByKernel, a cube in a volume
+typedef struct DimPatch {
+    int x, y, z;  //corner, the patch wraps around the torus
+    uint32_t key; //stream of its cells' values
+} DimPatch;
+
+typedef struct DimPatches {
+    const DimPatch *patches;
+    int count;
+    float *plane; //states of an extra channel, NULL for the cells
+} DimPatches;
+
+uint64_t defaultSeed(void);
+void drawPatches(Dimension *dim, uint64_t key, DimPatch *patches, int count);
+void randomizeTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void randomizeVolumeTask(Dimension *dim, void *ctx, int z0, int z1, int worker);
+
+//seed of a new world, worlds created in the same second still get different ones
+uint64_t defaultSeed(void) {
+    static uint64_t worlds = 0;
+    uint64_t n = __atomic_fetch_add(&worlds, 1, __ATOMIC_RELAXED);
+    return dimMix64((uint64_t)time(NULL) ^ dimMix64(n));
+}
+
+//the randomize and noisify calls of a world draw from successive streams of its seed, reseeding restarts the sequence
+DIMAPI void setDimensionSeed(Dimension *dim, uint64_t seed) {
+    dim->seed = seed;
+    dim->draws = 0;
+}
+
+DIMAPI uint64_t getDimensionSeed(Dimension *dim) {
+    return dim->seed;
+}
+
+//rows [y0, y1) from scratch, the patches are applied in order so that overlaps do not depend on the bands
+void randomizeTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimPatches *p = ctx;
+    int w = dim->MATRIXWIDTH, h = dim->MATRIXHEIGHT, side = dim->patchsize+1;
+    float *states = malloc(2*(size_t)w*sizeof(float));
+    if (states == NULL) {
+        fprintf(stderr, "Failed to allocate the rows of the randomized bands\n");
+        return;
+    }
+    float *olds = states + w;
+    for (int y = y0; y < y1; ++y) {
+        memset(states, 0, 2*(size_t)w*sizeof(float));
+        for (int k = 0; k < p->count; ++k) {
+            const DimPatch *patch = &p->patches[k];
+            int j = ((y - patch->y) % h + h) % h;
+            if (j >= side) { continue; }
+            for (int i = 0; i < side; ++i) {
+                int x = (patch->x + i) % w;
+                uint32_t n = 2*(uint32_t)(j*side + i);
+                states[x] = dimUniform(dimDraw(patch->key, n));
+                olds[x] = dimUniform(dimDraw(patch->key, n+1));
+            }
+        }
+        if (p->plane != NULL) {
+            memcpy(p->plane + (size_t)y*w, states, w*sizeof(float));
+            continue;
+        }
+        //an in-place world has a single state
+        if (dim->inPlace) {
+            encodeRow(dim, y, states);
+            continue;
+        }
+        Cell *cells = &dim->matrix[(size_t)y*w];
+        for (int x = 0; x < w; ++x) {
+            cells[x].state = states[x];
+            cells[x].oldState = olds[x];
+        }
+    }
+    free(states);
+}
+
+//slices [z0, z1) of a volume from scratch, a patch covering the cubes of side patchsize+1 at its corner
+void randomizeVolumeTask(Dimension *dim, void *ctx, int z0, int z1, int worker) {
+    const DimPatches *p = ctx;
+    int w = dim->MATRIXWIDTH, h = dim->MATRIXHEIGHT, d = getMatrixDepth(dim), side = dim->patchsize+1;
+    for (int z = z0; z < z1; ++z) {
+        for (int y = 0; y < h; ++y) {
+            float *states = volumeRow(dim, (size_t)z*h + y);
+            memset(states, 0, w*sizeof(float));
+            for (int k = 0; k < p->count; ++k) {
+                const DimPatch *patch = &p->patches[k];
+                int j = ((y - patch->y) % h + h) % h, l = ((z - patch->z) % d + d) % d;
+                if (j >= side || l >= side) { continue; }
+                for (int i = 0; i < side; ++i) {
+                    states[(patch->x + i) % w] = dimUniform(dimDraw(patch->key, (uint32_t)((l*side + j)*side + i)));
+                }
+            }
+        }
+    }
+}
+
+//positions drawn up front, the bands then only read them
+void drawPatches(Dimension *dim, uint64_t key, DimPatch *patches, int count) {
+    for (int k = 0; k < count; ++k) {
+        uint64_t z = dimSubKey(key, k);
+        patches[k].x = (int)(((z & 0xffffffffu) * (uint64_t)dim->MATRIXWIDTH) >> 32);
+        patches[k].y = (int)(((z >> 32) * (uint64_t)dim->MATRIXHEIGHT) >> 32);
+        patches[k].key = (uint32_t)dimMix64(z);
+        patches[k].z = (int)(((dimMix64(z) >> 32) * (uint64_t)getMatrixDepth(dim)) >> 32);
+    }
+}
+
+DIMAPI void randomizeDimensionByKernel(Dimension *dim) {
+    double t = dimClock();
+    DIM_TRACE_BEGIN("randomize");
+    uint64_t key = dimSubKey(dim->seed, dim->draws++);
+    //a volume gets as many patches in every R thick layer of slices as a plane does
+    float layers = dim->volume != NULL ? (float)getMatrixDepth(dim)/dim->KERNELRAD : 1.f;
+    int count = (int)(((float)dim->MATRIXWIDTH*1.f)/((float)dim->KERNELRAD)*dim->RDMDENSITY*layers) + 1;
+    DimPatch *patches = malloc(count*sizeof(DimPatch));
+    if (patches == NULL) {
+        fprintf(stderr, "Failed to allocate %d patches, the dimension is not randomized\n", count);
+        DIM_TRACE_END("randomize");
+        return;
+    }
+    drawPatches(dim, key, patches, count);
+    DimPatches p = { patches, count, NULL };
+    if (dim->volume != NULL) {
+        parallelRange(dim, "randomize", randomizeVolumeTask, &p, 0, getMatrixDepth(dim));
+        free(patches);
+        lapPhase(dim, DIM_PHASE_RANDOMIZE, t);
+        DIM_TRACE_END("randomize");
+        return;
+    }
+    parallelRows(dim, "randomize", randomizeTask, &p);
+    //the extra channels of a multi-channel world get patches of their own, from streams of the same key
+    for (int c = 1; c < getDimensionChannels(dim); ++c) {
+        drawPatches(dim, dimSubKey(~key, c), patches, count);
+        p.plane = dim->channels->planes + (size_t)(c-1)*dim->MATRIXWIDTH*dim->MATRIXHEIGHT;
+        parallelRows(dim, "randomize", randomizeTask, &p);
+    }
+    free(patches);
+    syncDimension(dim);
+    if (!dim->inPlace) { memcpy(dim->matrixInit, dim->matrix, sizeof(struct Cell)*dim->MATRIXHEIGHT*dim->MATRIXWIDTH); }
+    lapPhase(dim, DIM_PHASE_RANDOMIZE, t);
+    DIM_TRACE_END("randomize");
+}
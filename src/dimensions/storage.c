@@ -0,0 +1,259 @@
+#include "dimpriv.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+//bytes per cell of each storage
+size_t storageSize(DimStorage storage) {
+    switch (storage) {
+        case DIM_STORAGE_FLOAT16:
+        case DIM_STORAGE_FIXED16: return 2;
+        case DIM_STORAGE_UINT8: return 1;
+        default: return sizeof(float);
+    }
+}
+
+//ieee half precision, round to nearest even
+static inline unsigned short floatToHalf(float f) {
+    unsigned int x;
+    memcpy(&x, &f, sizeof(x));
+    unsigned int sign = (x >> 16) & 0x8000;
+    int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+    unsigned int mantissa = x & 0x7fffff;
+    if (exponent >= 31) { return sign | 0x7c00; }
+    if (exponent <= 0) {
+        if (exponent < -10) { return sign; }
+        //subnormal half
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        unsigned int half = mantissa >> shift;
+        unsigned int rest = mantissa & ((1u << shift) - 1);
+        unsigned int mid = 1u << (shift - 1);
+        if (rest > mid || (rest == mid && (half & 1))) { ++half; }
+        return sign | half;
+    }
+    unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+    unsigned int rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) { ++half; }
+    return half;
+}
+
+static inline float halfToFloat(unsigned short h) {
+    unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+    unsigned int exponent = (h >> 10) & 0x1f;
+    unsigned int mantissa = h & 0x3ff;
+    float f;
+    if (exponent == 0) {
+        //zero or subnormal, mantissa * 2^-24
+        f = (float)mantissa*5.9604644775390625e-8f;
+        return sign ? -f : f;
+    }
+    unsigned int x = sign | (exponent == 31 ? 0x7f800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static inline float clampUnit(float s) {
+    return s > 1.f ? 1.f : s < 0.f ? 0.f : s;
+}
+
+//value of s once stored and read back
+float quantizeState(DimStorage storage, float s) {
+    switch (storage) {
+        case DIM_STORAGE_FLOAT16: return halfToFloat(floatToHalf(s));
+        case DIM_STORAGE_FIXED16: return (float)(unsigned short)(clampUnit(s)*65535.f+.5f)*(1.f/65535.f);
+        case DIM_STORAGE_UINT8: return (float)(unsigned char)(clampUnit(s)*255.f+.5f)*(1.f/255.f);
+        default: return s;
+    }
+}
+
+//packs n values in the storage at index k of plane
+static inline void packStates(DimStorage storage, void *plane, size_t k, const float *src, int n) {
+    switch (storage) {
+        case DIM_STORAGE_FLOAT16:
+            for (int i = 0; i < n; ++i) { ((unsigned short *)plane)[k+i] = floatToHalf(src[i]); }
+            break;
+        case DIM_STORAGE_FIXED16:
+            for (int i = 0; i < n; ++i) { ((unsigned short *)plane)[k+i] = (unsigned short)(clampUnit(src[i])*65535.f+.5f); }
+            break;
+        case DIM_STORAGE_UINT8:
+            for (int i = 0; i < n; ++i) { ((unsigned char *)plane)[k+i] = (unsigned char)(clampUnit(src[i])*255.f+.5f); }
+            break;
+        default:
+            memcpy((float *)plane + k, src, n*sizeof(float));
+            break;
+    }
+}
+
+static inline void unpackStates(DimStorage storage, const void *plane, size_t k, float *dst, int n) {
+    switch (storage) {
+        case DIM_STORAGE_FLOAT16:
+            for (int i = 0; i < n; ++i) { dst[i] = halfToFloat(((const unsigned short *)plane)[k+i]); }
+            break;
+        case DIM_STORAGE_FIXED16:
+            for (int i = 0; i < n; ++i) { dst[i] = (float)((const unsigned short *)plane)[k+i]*(1.f/65535.f); }
+            break;
+        case DIM_STORAGE_UINT8:
+            for (int i = 0; i < n; ++i) { dst[i] = (float)((const unsigned char *)plane)[k+i]*(1.f/255.f); }
+            break;
+        default:
+            memcpy(dst, (const float *)plane + k, n*sizeof(float));
+            break;
+    }
+}
+
+//reads a row of the plane (or of the cells' oldState when there is none) into dst as floats
+void decodeRow(Dimension *dim, int y, float *dst) {
+    int w = dim->MATRIXWIDTH;
+    if (dim->plane == NULL) {
+        const Cell *src = &dim->matrix[(size_t)y*w];
+        for (int i = 0; i < w; ++i) { dst[i] = src[i].oldState; }
+        return;
+    }
+    for (int x = 0, n; x < w; x += n) {
+        n = planeRun(dim, x);
+        unpackStates(dim->storage, dim->plane, planeIndex(dim, x, y), dst + x, n);
+    }
+}
+
+//packs the state (current) or oldState of the cells of row y in the plane, then sets them to the value stored
+static void packCells(Dimension *dim, int y, bool current) {
+    int w = dim->MATRIXWIDTH;
+    Cell *cells = &dim->matrix[(size_t)y*w];
+    float states[DIM_TILE_SIDE];
+    for (int x = 0, n; x < w; x += n) {
+        n = planeRun(dim, x) < DIM_TILE_SIDE ? planeRun(dim, x) : DIM_TILE_SIDE;
+        size_t k = planeIndex(dim, x, y);
+        for (int i = 0; i < n; ++i) { states[i] = current ? cells[x+i].state : cells[x+i].oldState; }
+        packStates(dim->storage, dim->plane, k, states, n);
+        unpackStates(dim->storage, dim->plane, k, states, n);
+        for (int i = 0; i < n; ++i) {
+            if (current) { cells[x+i].state = states[i]; }
+            cells[x+i].oldState = states[i];
+        }
+    }
+}
+
+//quantizes the states of row y to the storage, copies them to oldState and packs them in the plane
+void swapRow(Dimension *dim, int y) {
+    if (dim->plane != NULL) {
+        packCells(dim, y, true);
+        return;
+    }
+    Cell *cells = &dim->matrix[(size_t)y*dim->MATRIXWIDTH];
+    for (int i = 0; i < dim->MATRIXWIDTH; ++i) { cells[i].oldState = cells[i].state; }
+}
+
+//packs a row of states in the plane of an in-place world
+void encodeRow(Dimension *dim, int y, const float *src) {
+    for (int x = 0, n; x < dim->MATRIXWIDTH; x += n) {
+        n = planeRun(dim, x);
+        packStates(dim->storage, dim->plane, planeIndex(dim, x, y), src + x, n);
+    }
+}
+
+//single states of an in-place world, k being the index of the cell
+float loadState(Dimension *dim, size_t k) {
+    float s;
+    unpackStates(dim->storage, dim->plane, planeIndex(dim, k % dim->MATRIXWIDTH, k / dim->MATRIXWIDTH), &s, 1);
+    return s;
+}
+
+void storeState(Dimension *dim, size_t k, float s) {
+    packStates(dim->storage, dim->plane, planeIndex(dim, k % dim->MATRIXWIDTH, k / dim->MATRIXWIDTH), &s, 1);
+}
+
+//current states of row y, whichever way the world keeps them
+DIMAPI void getStateRow(Dimension *dim, int y, float *dst) {
+    if (dim->volume != NULL) {
+        memcpy(dst, volumeRow(dim, y), dim->MATRIXWIDTH*sizeof(float));
+        return;
+    }
+    if (dim->inPlace) {
+        decodeRow(dim, y, dst);
+        return;
+    }
+    const Cell *cells = &dim->matrix[(size_t)y*dim->MATRIXWIDTH];
+    for (int i = 0; i < dim->MATRIXWIDTH; ++i) { dst[i] = cells[i].state; }
+}
+
+//sets the current states of row y, both state and oldState of a world with cells, rounded to the storage
+DIMAPI void setStateRow(Dimension *dim, int y, const float *src) {
+    if (dim->volume != NULL) {
+        memcpy(volumeRow(dim, y), src, dim->MATRIXWIDTH*sizeof(float));
+        return;
+    }
+    if (dim->inPlace) {
+        encodeRow(dim, y, src);
+        return;
+    }
+    Cell *cells = &dim->matrix[(size_t)y*dim->MATRIXWIDTH];
+    for (int i = 0; i < dim->MATRIXWIDTH; ++i) { cells[i].state = cells[i].oldState = src[i]; }
+    if (dim->plane != NULL) { packCells(dim, y, true); }
+}
+
+//repacks the plane from the cells' oldState, to call after writing the cells directly
+//the plane of an in-place world is its only copy of the states, there is nothing to sync
+DIMAPI void syncDimension(Dimension *dim) {
+    if (dim->inPlace || dim->plane == NULL || dim->volume != NULL) { return; }
+    for (int j = 0; j < dim->MATRIXHEIGHT; ++j) { packCells(dim, j, false); }
+}
+
+//moves the plane to another storage and layout, an in-place world has its states recoded in the new plane
+//a world with cells only needs a plane for packed storages or the morton layout, it is rebuilt from oldState
+int repackPlane(Dimension *dim, DimStorage storage, DimLayout layout) {
+    Dimension to = *dim;
+    to.storage = storage;
+    to.layout = layout;
+    to.tileOrder = layout == DIM_LAYOUT_MORTON ? buildTileOrder(dim) : NULL;
+    to.plane = NULL;
+    bool planed = dim->inPlace || storage != DIM_STORAGE_FLOAT32 || layout != DIM_LAYOUT_ROWS;
+    if (planed) { to.plane = dimCalloc(planeLength(dim, layout), storageSize(storage)); }
+    float *row = dim->inPlace ? malloc(dim->MATRIXWIDTH*sizeof(float)) : NULL;
+    if ((layout == DIM_LAYOUT_MORTON && to.tileOrder == NULL) || (planed && to.plane == NULL) || (dim->inPlace && row == NULL)) {
+        fprintf(stderr, "Failed to allocate the state plane, keeping the current storage and layout\n");
+        free(to.tileOrder);
+        dimFree(to.plane);
+        free(row);
+        return 1;
+    }
+
+    if (dim->inPlace) {
+        for (int j = 0; j < dim->MATRIXHEIGHT; ++j) {
+            decodeRow(dim, j, row);
+            for (int i = 0; i < dim->MATRIXWIDTH; ++i) { row[i] = quantizeState(storage, row[i]); }
+            encodeRow(&to, j, row);
+        }
+        free(row);
+    }
+    dimFree(dim->plane);
+    free(dim->tileOrder);
+    dim->plane = to.plane;
+    dim->tileOrder = to.tileOrder;
+    dim->storage = storage;
+    dim->layout = layout;
+    syncDimension(dim);
+    //written by the calling thread, the pages go to the pinned workers if any
+    placeDimension(dim);
+    return 0;
+}
+
+//stores the states of an in-place world with the given precision, the convolution itself still sums floats
+//a world with cells keeps its 16 byte cells whatever the plane, so it only stores float32 states, see DimStorage
+DIMAPI int setStateStorage(Dimension *dim, DimStorage storage) {
+    if (storage == dim->storage) { return 0; }
+    if (dim->volume != NULL) {
+        fprintf(stderr, "A volume only stores float32 states\n");
+        return 1;
+    }
+    if (!dim->inPlace) {
+        fprintf(stderr, "A world with cells only stores float32 states, create it with CreateInPlaceDimension to pack them\n");
+        return 1;
+    }
+    return repackPlane(dim, storage, dim->layout);
+}
+
+DIMAPI DimStorage getStateStorage(Dimension *dim) {
+    return dim->storage;
+}
@@ -0,0 +1,185 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+//persistent workers of a Dimension, the calling thread takes the first band unless the workers are pinned
+typedef struct DimPool {
+    pthread_t *threads;
+    int count;   //number of bands
+    int workers; //threads started, count-1, or count when pinned
+    int pinned;  //every band runs on a pinned worker, the calling thread is never pinned and only waits
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    int pending;
+    int quit;
+    Dimension *dim;
+    DimRowTask task;
+    void *ctx;
+    const char *name;
+    int y0, y1; //rows split between the bands
+} DimPool;
+
+typedef struct WorkerArgs {
+    DimPool *pool;
+    int worker;
+    int cpu; //-1 when not pinned
+} WorkerArgs;
+
+void runBand(DimPool *pool, int worker) {
+    int h = pool->y1 - pool->y0;
+    int y0 = pool->y0 + (int)((long)h*worker/pool->count);
+    int y1 = pool->y0 + (int)((long)h*(worker+1)/pool->count);
+    DIM_TRACE_BEGIN(pool->name);
+    if (y1 > y0) { pool->task(pool->dim, pool->ctx, y0, y1, worker); }
+    DIM_TRACE_END(pool->name);
+}
+
+void *workerMain(void *arg) {
+    WorkerArgs args = *(WorkerArgs *)arg;
+    DimPool *pool = args.pool;
+    free(arg);
+    if (args.cpu >= 0) { pinThread(args.cpu); }
+    unsigned long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->quit) { pthread_cond_wait(&pool->start, &pool->lock); }
+        if (pool->quit) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        runBand(pool, args.worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) { pthread_cond_signal(&pool->done); }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+//runs task over horizontal bands of dim, one per thread, and returns once every band is done
+void parallelRows(Dimension *dim, const char *name, DimRowTask task, void *ctx) {
+    parallelRange(dim, name, task, ctx, 0, dim->MATRIXHEIGHT);
+}
+
+//same over the rows [y0, y1) only
+void parallelRange(Dimension *dim, const char *name, DimRowTask task, void *ctx, int y0, int y1) {
+    DimPool *pool = dim->pool;
+    if (y1 <= y0) { return; }
+    if (pool == NULL) {
+        DIM_TRACE_BEGIN(name);
+        task(dim, ctx, y0, y1, 0);
+        DIM_TRACE_END(name);
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->name = name;
+    pool->y0 = y0;
+    pool->y1 = y1;
+    pool->pending = pool->workers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!pool->pinned) { runBand(pool, 0); }
+
+    DIM_TRACE_BEGIN("barrier");
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending != 0) { pthread_cond_wait(&pool->done, &pool->lock); }
+    pthread_mutex_unlock(&pool->lock);
+    DIM_TRACE_END("barrier");
+}
+
+void destroyPool(Dimension *dim) {
+    DimPool *pool = dim->pool;
+    if (pool == NULL) { return; }
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int k = 0; k < pool->workers; ++k) { pthread_join(pool->threads[k], NULL); }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool);
+    dim->pool = NULL;
+}
+
+DIMAPI int getCpuCount(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+//sets the number of threads stepping dim, 0 or less meaning one per cpu
+//with a pinning policy, a pinned worker steps every band, the first one too, then the pages of the world are moved to their nodes
+//the calling thread keeps its own affinity, it may step other worlds or draw
+DIMAPI void setDimensionThreads(Dimension *dim, int n) {
+    if (n <= 0) { n = getCpuCount(); }
+    if (n > dim->MATRIXHEIGHT) { n = dim->MATRIXHEIGHT; }
+    destroyPool(dim);
+    dim->threads = n;
+    int *cpus = malloc(n*sizeof(int));
+    int cpuCount = cpus != NULL ? listCpus(dim->affinity, cpus, n) : 0;
+    int pinned = cpuCount > 0, workers = pinned ? n : n-1;
+    if (workers == 0) {
+        free(cpus);
+        return;
+    }
+
+    DimPool *pool = calloc(1, sizeof(DimPool));
+    if (pool == NULL) {
+        free(cpus);
+        dim->threads = 1;
+        return;
+    }
+    pool->threads = malloc(workers*sizeof(pthread_t));
+    pool->count = n;
+    pool->pinned = pinned;
+    pool->dim = dim;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    dim->pool = pool;
+    for (int k = 0; k < workers; ++k) {
+        int band = pinned ? k : k+1;
+        WorkerArgs *args = malloc(sizeof(WorkerArgs));
+        if (args != NULL) { *args = (WorkerArgs){ pool, band, pinned ? cpus[band % cpuCount] : -1 }; }
+        if (pool->threads == NULL || args == NULL || pthread_create(&pool->threads[k], NULL, workerMain, args) != 0) {
+            fprintf(stderr, "Failed to start worker %d, stepping with %d threads\n", band, band > 0 ? band : 1);
+            free(args);
+            pool->count = band;
+            break;
+        }
+        pool->workers++;
+    }
+    free(cpus);
+    dim->threads = pool->count > 0 ? pool->count : 1;
+    //a single band left to the calling thread needs no pool
+    if (pool->count == 0 || (!pinned && pool->count == 1)) {
+        destroyPool(dim);
+        return;
+    }
+    placeDimension(dim);
+}
+
+DIMAPI int getDimensionThreads(Dimension *dim) {
+    return dim->threads;
+}
@@ -0,0 +1,72 @@
+#include "dimensions.h"
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+const char *phaseNames[DIM_PHASE_COUNT] = {
+    "convolution",
+    "growth",
+    "swap",
+    "noise",
+    "randomize",
+    "upload",
+    "draw",
+    "jit",
+    "blocked"
+};
+
+//monotonic wall clock in seconds, unlike clock() it keeps counting across threads
+DIMAPI double dimClock(void) {
+#if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) { QueryPerformanceFrequency(&freq); }
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart/(double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec*1e-9;
+#endif
+}
+
+DIMAPI void addPhaseTime(Dimension *dim, DimPhase phase, double seconds) {
+    dim->phaseTime[phase] += seconds;
+    dim->phaseCount[phase]++;
+}
+
+//closes the phase started at start and returns the current time, so phases can be chained
+DIMAPI double lapPhase(Dimension *dim, DimPhase phase, double start) {
+    double now = dimClock();
+    addPhaseTime(dim, phase, now - start);
+    return now;
+}
+
+DIMAPI double getPhaseTime(Dimension *dim, DimPhase phase) {
+    return dim->phaseTime[phase];
+}
+
+DIMAPI unsigned long getPhaseCount(Dimension *dim, DimPhase phase) {
+    return dim->phaseCount[phase];
+}
+
+DIMAPI const char *getPhaseName(DimPhase phase) {
+    return phase < DIM_PHASE_COUNT ? phaseNames[phase] : "unknown";
+}
+
+DIMAPI void resetPhaseTimes(Dimension *dim) {
+    memset(dim->phaseTime, 0, sizeof(dim->phaseTime));
+    memset(dim->phaseCount, 0, sizeof(dim->phaseCount));
+}
+
+DIMAPI int dumpPhaseTimesCSV(Dimension *dim, FILE *fp) {
+    if (fprintf(fp, "phase,calls,total_s,mean_ms\n") < 0) { return 1; }
+    for (int p = 0; p < DIM_PHASE_COUNT; ++p) {
+        double mean = dim->phaseCount[p] ? dim->phaseTime[p]/dim->phaseCount[p]*1e3 : 0.;
+        if (fprintf(fp, "%s,%lu,%.6f,%.4f\n", phaseNames[p], dim->phaseCount[p], dim->phaseTime[p], mean) < 0) { return 1; }
+    }
+    return 0;
+}
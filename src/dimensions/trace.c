@@ -0,0 +1,126 @@
+#include "dimensions.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//events kept per thread, older ones are overwritten when a ring wraps around
+#define TRACE_RING_SIZE (1<<16)
+#define TRACE_MAX_THREADS 256
+
+typedef struct TraceEvent {
+    const char *name; //must be a string literal, only the pointer is recorded
+    double ts;
+    char phase;
+} TraceEvent;
+
+//single producer ring, only its owner thread writes, the flush reads after the workers are done
+//head only ever grows, the owner may still be writing while a trace is flushed or started
+typedef struct TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    unsigned long head;
+    unsigned long start; //head when the current trace started
+    int tid;
+} TraceRing;
+
+int dimTraceOn = 0;
+TraceRing *traceRings[TRACE_MAX_THREADS];
+int traceRingCount = 0;
+double traceStart;
+char *tracePath = NULL;
+_Thread_local TraceRing *localRing = NULL;
+_Thread_local int localRingFull = 0;
+
+void flushTraceAtExit(void);
+
+//returns the calling thread's ring, registering it the first time
+TraceRing *getLocalRing(void) {
+    if (localRing != NULL || localRingFull) { return localRing; }
+    int slot = __atomic_fetch_add(&traceRingCount, 1, __ATOMIC_ACQ_REL);
+    if (slot >= TRACE_MAX_THREADS) {
+        localRingFull = 1;
+        return NULL;
+    }
+    TraceRing *ring = calloc(1, sizeof(TraceRing));
+    if (ring == NULL) {
+        localRingFull = 1;
+        return NULL;
+    }
+    ring->tid = slot + 1;
+    __atomic_store_n(&traceRings[slot], ring, __ATOMIC_RELEASE);
+    localRing = ring;
+    return ring;
+}
+
+DIMAPI void traceEvent(const char *name, char phase) {
+    TraceRing *ring = getLocalRing();
+    if (ring == NULL) { return; }
+    unsigned long head = ring->head;
+    TraceEvent *e = &ring->events[head & (TRACE_RING_SIZE-1)];
+    e->name = name;
+    e->ts = dimClock();
+    e->phase = phase;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+//starts recording, the trace is written to path by stopTrace or at exit
+DIMAPI int startTrace(const char *path) {
+    static int registered = 0;
+    char *copy = malloc(strlen(path)+1);
+    if (copy == NULL) { return 1; }
+    strcpy(copy, path);
+    free(tracePath);
+    tracePath = copy;
+    //the events of a previous trace are skipped, rings registered later start at 0
+    int count = __atomic_load_n(&traceRingCount, __ATOMIC_ACQUIRE);
+    if (count > TRACE_MAX_THREADS) { count = TRACE_MAX_THREADS; }
+    for (int r = 0; r < count; ++r) {
+        TraceRing *ring = __atomic_load_n(&traceRings[r], __ATOMIC_ACQUIRE);
+        if (ring != NULL) { __atomic_store_n(&ring->start, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE); }
+    }
+    traceStart = dimClock();
+    if (!registered) {
+        atexit(flushTraceAtExit);
+        registered = 1;
+    }
+    __atomic_store_n(&dimTraceOn, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+//stops recording and writes the chrome json trace (chrome://tracing, ui.perfetto.dev)
+DIMAPI int stopTrace(void) {
+    if (tracePath == NULL) { return 0; }
+    __atomic_store_n(&dimTraceOn, 0, __ATOMIC_RELEASE);
+
+    FILE *fp = fopen(tracePath, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open trace file \"%s\"\n", tracePath);
+        return 1;
+    }
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int first = 1;
+    int count = __atomic_load_n(&traceRingCount, __ATOMIC_ACQUIRE);
+    if (count > TRACE_MAX_THREADS) { count = TRACE_MAX_THREADS; }
+    for (int r = 0; r < count; ++r) {
+        TraceRing *ring = __atomic_load_n(&traceRings[r], __ATOMIC_ACQUIRE);
+        if (ring == NULL) { continue; }
+        unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long start = __atomic_load_n(&ring->start, __ATOMIC_ACQUIRE);
+        if (head - start > TRACE_RING_SIZE) { start = head - TRACE_RING_SIZE; }
+        for (unsigned long k = start; k < head; ++k) {
+            TraceEvent *e = &ring->events[k & (TRACE_RING_SIZE-1)];
+            if (e->ts < traceStart) { continue; } //left over from a previous trace
+            fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                first ? "" : ",\n", e->name, e->phase, (e->ts - traceStart)*1e6, ring->tid);
+            first = 0;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    free(tracePath);
+    tracePath = NULL;
+    return 0;
+}
+
+void flushTraceAtExit(void) {
+    stopTrace();
+}
@@ -0,0 +1,223 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//version of the trials, settings tuned by another one are tuned again
+#define DIM_TUNE_VERSION 1
+//largest generations per pass and tile heights tried, 0 rows being the height doSteps sizes from its cache budget
+#define DIM_TUNE_DEPTHS 4
+#define DIM_TUNE_TILES 5
+static const int tuneDepths[DIM_TUNE_DEPTHS] = { 1, 2, 4, 8 };
+static const int tuneTiles[DIM_TUNE_TILES] = { 0, 32, 64, 128, 256 };
+
+//settings of a world and the seconds per generation they were timed at
+typedef struct DimTuning {
+    int threads;
+    int depth;
+    int tileRows;
+    DimLayout layout;
+    double seconds;
+} DimTuning;
+
+//what the trials change of a world besides its settings, put back once they are over
+typedef struct DimSnapshot {
+    Cell *cells;   //both states of the cells, which the first step reads the old ones of
+    float *rows;   //states of every row of a world without cells, then of every extra channel
+    size_t length;
+    uint64_t draws;
+    int stepNoiseClock;
+    double phaseTime[DIM_PHASE_COUNT];
+    unsigned long phaseCount[DIM_PHASE_COUNT];
+} DimSnapshot;
+
+uint64_t tuneKey(Dimension *dim);
+int tunePath(char *path, size_t size);
+int loadTuning(Dimension *dim, DimTuning *t);
+void saveTuning(Dimension *dim, const DimTuning *t);
+int applyTuning(Dimension *dim, const DimTuning *t);
+int takeSnapshot(Dimension *dim, DimSnapshot *s);
+void restoreSnapshot(Dimension *dim, DimSnapshot *s);
+double timeTrial(Dimension *dim, const DimTuning *t, double seconds);
+int runTrials(Dimension *dim, double seconds);
+int canMorton(Dimension *dim);
+
+//the shape of the world and the rules its cost depends on, not its parameters or states
+uint64_t tuneKey(Dimension *dim) {
+    int shape[] = { DIM_TUNE_VERSION, dim->MATRIXWIDTH, dim->MATRIXHEIGHT, getMatrixDepth(dim), dim->KERNELRAD, kernelTaps(dim),
+        dim->inPlace, dim->storage, getDimensionChannels(dim), dim->channels != NULL ? dim->channels->kernelCount : 0,
+        getDimensionEngine(dim), dim->growthMode, dim->growthFunction, dim->stepNoise > 0 };
+    return hashBytes(0xcbf29ce484222325ull, shape, sizeof(shape));
+}
+
+//one file per machine next to the engine costs, a line per world shape
+int tunePath(char *path, size_t size) {
+    char dir[512];
+    if (cacheDirectory(dir, sizeof(dir)) != 0) { return 1; }
+    snprintf(path, size, "%s/tune-%016llx.txt", dir, (unsigned long long)machineKey());
+    return 0;
+}
+
+//last line for the shape of dim
+int loadTuning(Dimension *dim, DimTuning *t) {
+    char path[600], line[256];
+    if (tunePath(path, sizeof(path)) != 0) { return 1; }
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) { return 1; }
+    unsigned long long key = tuneKey(dim), read;
+    int found = 1;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        DimTuning l;
+        int layout;
+        if (sscanf(line, "%llx %d %d %d %d %lg", &read, &l.threads, &l.depth, &l.tileRows, &layout, &l.seconds) != 6 || read != key) { continue; }
+        l.layout = (DimLayout)layout;
+        *t = l;
+        found = 0;
+    }
+    fclose(fp);
+    return found;
+}
+
+void saveTuning(Dimension *dim, const DimTuning *t) {
+    char path[600], name[256];
+    if (tunePath(path, sizeof(path)) != 0) { return; }
+    FILE *fp = fopen(path, "a");
+    if (fp == NULL) { return; }
+    if (ftell(fp) == 0) {
+        cpuName(name, sizeof(name));
+        fprintf(fp, "# libdimensions settings tuned on %s : shape, threads, generations per pass, tile rows, layout, seconds per generation\n", name);
+    }
+    fprintf(fp, "%016llx %d %d %d %d %.9g\n", (unsigned long long)tuneKey(dim), t->threads, t->depth, t->tileRows, (int)t->layout, t->seconds);
+    fclose(fp);
+}
+
+int applyTuning(Dimension *dim, const DimTuning *t) {
+    if (t->threads != dim->threads) { setDimensionThreads(dim, t->threads); }
+    setTileRows(dim, t->tileRows);
+    setBlockDepth(dim, t->depth);
+    return t->layout != dim->layout ? setStateLayout(dim, t->layout) : 0;
+}
+
+//the trials step the world itself, from its current states
+int takeSnapshot(Dimension *dim, DimSnapshot *s) {
+    int w = dim->MATRIXWIDTH, rows = dim->inPlace || dim->volume != NULL ? dim->MATRIXHEIGHT*getMatrixDepth(dim) : 0;
+    size_t extra = (size_t)(getDimensionChannels(dim) > 1 ? getDimensionChannels(dim)-1 : 0)*w*dim->MATRIXHEIGHT;
+    s->length = (size_t)w*rows + extra;
+    s->cells = rows == 0 ? malloc((size_t)w*dim->MATRIXHEIGHT*sizeof(Cell)) : NULL;
+    s->rows = malloc(s->length*sizeof(float) + 1);
+    if (s->rows == NULL || (rows == 0 && s->cells == NULL)) {
+        free(s->cells);
+        free(s->rows);
+        return 1;
+    }
+    if (s->cells != NULL) { memcpy(s->cells, dim->matrix, (size_t)w*dim->MATRIXHEIGHT*sizeof(Cell)); }
+    for (int j = 0; j < rows; ++j) { getStateRow(dim, j, s->rows + (size_t)j*w); }
+    if (extra > 0) { memcpy(s->rows + (size_t)w*rows, dim->channels->planes, extra*sizeof(float)); }
+    s->draws = dim->draws;
+    s->stepNoiseClock = dim->stepNoiseClock;
+    memcpy(s->phaseTime, dim->phaseTime, sizeof(s->phaseTime));
+    memcpy(s->phaseCount, dim->phaseCount, sizeof(s->phaseCount));
+    return 0;
+}
+
+//the plane of a world with cells is repacked from their old states, in whichever layout the trials left
+void restoreSnapshot(Dimension *dim, DimSnapshot *s) {
+    int w = dim->MATRIXWIDTH, rows = s->cells == NULL ? dim->MATRIXHEIGHT*getMatrixDepth(dim) : 0;
+    if (s->cells != NULL) {
+        memcpy(dim->matrix, s->cells, (size_t)w*dim->MATRIXHEIGHT*sizeof(Cell));
+        syncDimension(dim);
+    }
+    for (int j = 0; j < rows; ++j) { setStateRow(dim, j, s->rows + (size_t)j*w); }
+    if (s->length > (size_t)w*rows) { memcpy(dim->channels->planes, s->rows + (size_t)w*rows, (s->length - (size_t)w*rows)*sizeof(float)); }
+    dim->draws = s->draws;
+    dim->stepNoiseClock = s->stepNoiseClock;
+    memcpy(dim->phaseTime, s->phaseTime, sizeof(s->phaseTime));
+    memcpy(dim->phaseCount, s->phaseCount, sizeof(s->phaseCount));
+    free(s->cells);
+    free(s->rows);
+}
+
+//seconds per generation of doSteps with the settings, after a pass paying for the pool, the tiles and the jit build
+double timeTrial(Dimension *dim, const DimTuning *t, double seconds) {
+    if (applyTuning(dim, t) != 0) { return -1.; }
+    doSteps(dim, t->depth);
+    int generations = 0;
+    double start = dimClock(), elapsed = 0.;
+    while (elapsed < seconds || generations == 0) {
+        doSteps(dim, t->depth);
+        generations += t->depth;
+        elapsed = dimClock() - start;
+    }
+    return elapsed/generations;
+}
+
+//the morton layout is a layout of the single state plane
+int canMorton(Dimension *dim) {
+    return dim->channels == NULL && dim->volume == NULL;
+}
+
+//times short runs of the world with thread counts up to the cpu count, then with the generations per pass and the tile
+//heights of doSteps when its engine blocks, then with the other layout, keeping the fastest at each stage
+//the world is left with the fastest settings, its states as they were, and the settings are saved for its shape
+//seconds is the total budget of the trials, each gets at least a pass
+int runTrials(Dimension *dim, double seconds) {
+    int threads[32], threadCount = 0, cpus = getCpuCount();
+    for (int n = 1; n < cpus && n < dim->MATRIXHEIGHT && threadCount < 31; n *= 2) { threads[threadCount++] = n; }
+    threads[threadCount++] = cpus < dim->MATRIXHEIGHT ? cpus : dim->MATRIXHEIGHT;
+    double trial = seconds/(threadCount + DIM_TUNE_DEPTHS-1 + DIM_TUNE_TILES-1 + 1);
+
+    DimSnapshot snapshot;
+    if (takeSnapshot(dim, &snapshot) != 0) {
+        fprintf(stderr, "Failed to save the states of the dimension, it is not tuned\n");
+        return 1;
+    }
+    DIM_TRACE_BEGIN("tune");
+    DimTuning best = { dim->threads, 1, 0, dim->layout, -1. };
+    for (int k = 0; k < threadCount; ++k) {
+        DimTuning t = { threads[k], 1, 0, best.layout, 0. };
+        t.seconds = timeTrial(dim, &t, trial);
+        if (t.seconds > 0. && (best.seconds < 0. || t.seconds < best.seconds)) { best = t; }
+    }
+    //the engine picked for the best thread count decides whether doSteps blocks at all
+    applyTuning(dim, &best);
+    chooseEngine(dim);
+    if (canBlock(dim)) {
+        for (int k = 1; k < DIM_TUNE_DEPTHS; ++k) {
+            DimTuning t = best;
+            t.depth = tuneDepths[k];
+            t.tileRows = 0;
+            t.seconds = timeTrial(dim, &t, trial);
+            if (t.seconds > 0. && t.seconds < best.seconds) { best = t; }
+        }
+        for (int k = 1; k < DIM_TUNE_TILES && best.depth > 1; ++k) {
+            if (tuneTiles[k] >= dim->MATRIXHEIGHT) { continue; }
+            DimTuning t = best;
+            t.tileRows = tuneTiles[k];
+            t.seconds = timeTrial(dim, &t, trial);
+            if (t.seconds > 0. && t.seconds < best.seconds) { best = t; }
+        }
+    }
+    if (canMorton(dim)) {
+        DimTuning t = best;
+        t.layout = best.layout == DIM_LAYOUT_ROWS ? DIM_LAYOUT_MORTON : DIM_LAYOUT_ROWS;
+        t.seconds = timeTrial(dim, &t, trial);
+        if (t.seconds > 0. && t.seconds < best.seconds) { best = t; }
+    }
+    applyTuning(dim, &best);
+    restoreSnapshot(dim, &snapshot);
+    DIM_TRACE_END("tune");
+    if (best.seconds < 0.) {
+        fprintf(stderr, "No setting could step the dimension, it is not tuned\n");
+        return 1;
+    }
+    saveTuning(dim, &best);
+    return 0;
+}
+
+//applies the settings saved for the shape of dim on this machine, or tunes it within seconds when there are none
+//or when force is set, a budget of 0 only applies saved settings, returns 1 when dim is left as it was
+//the generations per pass and tile rows only apply to doSteps, a caller stepping with doStep gets the threads and layout
+DIMAPI int tuneDimension(Dimension *dim, double seconds, int force) {
+    DimTuning t;
+    if (!force && loadTuning(dim, &t) == 0) { return applyTuning(dim, &t); }
+    return seconds > 0. ? runTrials(dim, seconds) : 1;
+}
@@ -0,0 +1,296 @@
+#include "dimpriv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//states and transforms of a volumetric world, stepped through 3D real transforms
+//the spectrum holds w/2+1 complex bins per row, the real transform of the row being made in place in its w+2 floats
+typedef struct DimVolume {
+    int w, h, d;
+    float *states;         //w x h x d, slice z then row y
+    float *spectrum;       //(w+2) x h x d
+    float *kernelSpectrum; //(w/2+1) x h x d, real since the sphere kernel is symmetric, with 1/(sum whd) folded in
+    uint64_t kernelKey;    //kernel the spectrum was made for, 0 before the first step
+    DimRealFFT *x;
+    DimFFT *y, *z;
+    float *work;
+    size_t workStride;
+    int workers;
+} DimVolume;
+
+//what a pass over the slices or the rows of the spectrum does
+typedef struct DimVolumePass {
+    bool load;     //copy the states into the spectrum first
+    bool multiply; //convolve by the kernel between the forward and inverse z transforms
+} DimVolumePass;
+
+int prepareVolume(Dimension *dim);
+uint64_t volumeKernelKey(Dimension *dim);
+int buildVolumeKernel(Dimension *dim);
+void volumeForwardTask(Dimension *dim, void *ctx, int z0, int z1, int worker);
+void volumeDepthTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+void volumeGrowthTask(Dimension *dim, void *ctx, int z0, int z1, int worker);
+void placeSlicesTask(Dimension *dim, void *ctx, int z0, int z1, int worker);
+void placeColumnsTask(Dimension *dim, void *ctx, int y0, int y1, int worker);
+
+//a world of w x h x depth cells without cells : the states live in the volume and are read a row at a time with
+//getStateRow, row y of slice z being row y + z*h, or a slice at a time with getVolumeSlice
+//the neighbour sums are made by 3D transforms whatever the engine, a direct sum over a ball of R^3 cells being too slow
+DIMAPI Dimension *CreateVolumeDimension(int w, int h, int depth, int kr, float dt, float rdmd, float a, float b, float c, float d, float nf, int ps) {
+    if (w < 2 || w % 2 != 0 || h < 1 || depth < 1) {
+        fprintf(stderr, "A volume needs an even width, not %dx%dx%d\n", w, h, depth);
+        return NULL;
+    }
+    Dimension *dim = calloc(1, sizeof(Dimension));
+    if (dim == NULL) { return NULL; }
+    dim->MATRIXWIDTH = w;
+    dim->MATRIXHEIGHT = h;
+    dim->CELLSIZE = 1;
+    dim->KERNELRAD = kr;
+    dim->DT = dt;
+    dim->RDMDENSITY = rdmd;
+    dim->a = a;
+    dim->b = b;
+    dim->c = c;
+    dim->d = d;
+    dim->noisefactor = nf;
+    dim->patchsize = ps;
+    dim->threads = 1;
+    dim->engine = DIM_ENGINE_FFT;
+    dim->seed = defaultSeed();
+    //the pinned workers, if any, first touch the slices and rows they step
+    startPlacedPool(dim);
+    dim->kernel = dimAlloc((2*kr+1)*(2*kr+1)*sizeof(float));
+    DimVolume *v = dim->volume = calloc(1, sizeof(DimVolume));
+    if (dim->kernel == NULL || v == NULL) {
+        fprintf(stderr, "Failed to allocate a %dx%dx%d dimension\n", w, h, depth);
+        DestroyDimension(dim);
+        return NULL;
+    }
+    v->w = w;
+    v->h = h;
+    v->d = depth;
+    //split by slices as the rows and growth passes, the kernel spectrum by rows as the depth pass reading it
+    v->states = placedCalloc(dim, 1, depth, (size_t)w*h*sizeof(float));
+    v->spectrum = placedCalloc(dim, 1, depth, (size_t)(w+2)*h*sizeof(float));
+    v->kernelSpectrum = placedCalloc(dim, depth, h, (size_t)(w/2+1)*sizeof(float));
+    v->x = createRealFFT(w);
+    v->y = createFFT(h);
+    v->z = createFFT(depth);
+    if (v->states == NULL || v->spectrum == NULL || v->kernelSpectrum == NULL || v->x == NULL || v->y == NULL || v->z == NULL) {
+        fprintf(stderr, "Failed to allocate a %dx%dx%d dimension\n", w, h, depth);
+        DestroyDimension(dim);
+        return NULL;
+    }
+    //the plane kernel is kept up to date for the setters sharing it, the sphere is sampled from the same shells
+    genKernel(dim);
+    return dim;
+}
+
+void freeVolume(Dimension *dim) {
+    DimVolume *v = dim->volume;
+    if (v == NULL) { return; }
+    dimFree(v->states);
+    dimFree(v->spectrum);
+    dimFree(v->kernelSpectrum);
+    destroyRealFFT(v->x);
+    destroyFFT(v->y);
+    destroyFFT(v->z);
+    dimFree(v->work);
+    free(v);
+    dim->volume = NULL;
+}
+
+void placeSlicesTask(Dimension *dim, void *ctx, int z0, int z1, int worker) {
+    DimVolume *v = dim->volume;
+    size_t slice = (size_t)v->w*v->h;
+    placeRange(v->states + z0*slice, (z1-z0)*slice*sizeof(float));
+    placeRange(v->spectrum + z0*(slice + 2*v->h), (z1-z0)*(slice + 2*v->h)*sizeof(float));
+}
+
+void placeColumnsTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    DimVolume *v = dim->volume;
+    size_t bins = v->w/2+1;
+    for (int z = 0; z < v->d; ++z) { placeRange(v->kernelSpectrum + ((size_t)z*v->h + y0)*bins, (y1-y0)*bins*sizeof(float)); }
+}
+
+//moves the pages of the volume to the nodes of the workers stepping them, split as the passes split them
+//the fft scratch is dropped, the next step allocates it again for the pinned workers to first touch
+void placeVolume(Dimension *dim) {
+    DimVolume *v = dim->volume;
+    if (v->states == NULL || v->spectrum == NULL || v->kernelSpectrum == NULL) { return; }
+    parallelRange(dim, "place", placeSlicesTask, NULL, 0, v->d);
+    parallelRange(dim, "place", placeColumnsTask, NULL, 0, v->h);
+    dimFree(v->work);
+    v->work = NULL;
+    v->workers = 0;
+}
+
+//1 for a plane
+DIMAPI int getMatrixDepth(Dimension *dim) {
+    return dim->volume != NULL ? dim->volume->d : 1;
+}
+
+//row k of the volume, row y of slice z being k = y + z*h
+float *volumeRow(Dimension *dim, size_t k) {
+    return dim->volume->states + k*dim->volume->w;
+}
+
+//copies the h x w states of slice z to dst, returns 1 if there is no such slice
+DIMAPI int getVolumeSlice(Dimension *dim, int z, float *dst) {
+    DimVolume *v = dim->volume;
+    if (v == NULL || z < 0 || z >= v->d) { return 1; }
+    memcpy(dst, v->states + (size_t)z*v->w*v->h, (size_t)v->w*v->h*sizeof(float));
+    return 0;
+}
+
+DIMAPI int setVolumeSlice(Dimension *dim, int z, const float *src) {
+    DimVolume *v = dim->volume;
+    if (v == NULL || z < 0 || z >= v->d) { return 1; }
+    memcpy(v->states + (size_t)z*v->w*v->h, src, (size_t)v->w*v->h*sizeof(float));
+    return 0;
+}
+
+//a work buffer per worker, big enough for the transforms of any of the three axes
+int prepareVolume(Dimension *dim) {
+    DimVolume *v = dim->volume;
+    if (v->work != NULL && v->workers >= dim->threads) { return 0; }
+    size_t stride = fftWorkSize(v->x->half);
+    if (fftLinesWorkSize(v->y) > stride) { stride = fftLinesWorkSize(v->y); }
+    if (fftLinesWorkSize(v->z) > stride) { stride = fftLinesWorkSize(v->z); }
+    stride = stride > 0 ? stride : 1;
+    float *work = dimRealloc(v->work, (size_t)dim->threads*stride*sizeof(float));
+    if (work == NULL) { return 1; }
+    v->work = work;
+    v->workStride = stride;
+    v->workers = dim->threads;
+    return 0;
+}
+
+//everything the kernel spectrum depends on
+uint64_t volumeKernelKey(Dimension *dim) {
+    int shape[] = { dim->KERNELRAD, dim->kernelShells, dim->kernelFunction };
+    uint64_t h = 0xcbf29ce484222325ull;
+    h = hashBytes(h, shape, sizeof(shape));
+    h = hashBytes(h, dim->kernelPeaks, sizeof(dim->kernelPeaks));
+    h = hashBytes(h, &dim->kernelCallback, sizeof(dim->kernelCallback));
+    h = hashBytes(h, &dim->kernelUser, sizeof(dim->kernelUser));
+    return h | 1;
+}
+
+//slices [z0, z1) : the rows then the columns of each slice, after a copy of its states when loading
+void volumeForwardTask(Dimension *dim, void *ctx, int z0, int z1, int worker) {
+    const DimVolumePass *pass = ctx;
+    DimVolume *v = dim->volume;
+    int w = v->w, h = v->h, bins = w/2+1;
+    float *work = v->work + (size_t)worker*v->workStride;
+    for (int z = z0; z < z1; ++z) {
+        float *slice = v->spectrum + (size_t)z*h*(w+2);
+        for (int y = 0; y < h; ++y) {
+            float *row = slice + (size_t)y*(w+2);
+            if (pass->load) { memcpy(row, v->states + ((size_t)z*h + y)*w, w*sizeof(float)); }
+            realFFTForward(v->x, row, work);
+        }
+        fftLines(v->y, slice, bins, bins, false, work);
+    }
+}
+
+//rows [y0, y1) of every slice : the z transforms a few columns at a time, times the kernel and back while they are in cache
+void volumeDepthTask(Dimension *dim, void *ctx, int y0, int y1, int worker) {
+    const DimVolumePass *pass = ctx;
+    DimVolume *v = dim->volume;
+    int h = v->h, d = v->d, bins = v->w/2+1;
+    size_t stride = (size_t)h*bins;
+    float *work = v->work + (size_t)worker*v->workStride;
+    for (int y = y0; y < y1; ++y) {
+        for (int c0 = 0; c0 < bins; c0 += DIM_FFT_COLUMNS) {
+            int n = bins-c0 < DIM_FFT_COLUMNS ? bins-c0 : DIM_FFT_COLUMNS;
+            float *columns = v->spectrum + 2*((size_t)y*bins + c0);
+            fftLines(v->z, columns, n, stride, false, work);
+            if (!pass->multiply) { continue; }
+            for (int z = 0; z < d; ++z) {
+                float *bin = columns + 2*(size_t)z*stride;
+                const float *gain = v->kernelSpectrum + (size_t)z*stride + (size_t)y*bins + c0;
+                for (int i = 0; i < n; ++i) {
+                    bin[2*i] *= gain[i];
+                    bin[2*i+1] *= gain[i];
+                }
+            }
+            fftLines(v->z, columns, n, stride, true, work);
+        }
+    }
+}
+
+//slices [z0, z1) : back through the columns and the rows, then the growth of the slice's states from its sums
+void volumeGrowthTask(Dimension *dim, void *ctx, int z0, int z1, int worker) {
+    DimVolume *v = dim->volume;
+    int w = v->w, h = v->h, bins = w/2+1;
+    float *work = v->work + (size_t)worker*v->workStride;
+    for (int z = z0; z < z1; ++z) {
+        float *slice = v->spectrum + (size_t)z*h*(w+2);
+        fftLines(v->y, slice, bins, bins, true, work);
+        for (int y = 0; y < h; ++y) {
+            float *row = slice + (size_t)y*(w+2);
+            realFFTInverse(v->x, row, work);
+            growthPlane(dim, row, v->states + ((size_t)z*h + y)*w, w);
+        }
+    }
+}
+
+//samples the ball of radius R on the torus and transforms it, shell i covering the radii [i/n, (i+1)/n) of R as in the plane
+int buildVolumeKernel(Dimension *dim) {
+    DimVolume *v = dim->volume;
+    int w = v->w, h = v->h, d = v->d, r = dim->KERNELRAD, bins = w/2+1;
+    const float one = 1.f;
+    int shells = dim->kernelShells > 0 ? dim->kernelShells : 1;
+    const float *peaks = dim->kernelShells > 0 ? dim->kernelPeaks : &one;
+    memset(v->spectrum, 0, (size_t)(w+2)*h*d*sizeof(float));
+    double sum = 0.;
+    for (int k = -r; k <= r; ++k) {
+        for (int j = -r; j <= r; ++j) {
+            for (int i = -r; i <= r; ++i) {
+                float dist = sqrtf(i*i+j*j+k*k)/r;
+                if (dist > 1 || dist == 0) { continue; }
+                float tap = shellValue(dim, dist, shells, peaks);
+                //a kernel wider than the volume wraps onto itself, as it would in a direct sum over the torus
+                int x = ((i % w) + w) % w, y = ((j % h) + h) % h, z = ((k % d) + d) % d;
+                v->spectrum[((size_t)z*h + y)*(w+2) + x] += tap;
+                sum += tap;
+            }
+        }
+    }
+    if (!(sum > 0.)) {
+        fprintf(stderr, "The kernel of radius %d has no weight in the volume\n", r);
+        return 1;
+    }
+    DimVolumePass pass = { false, false };
+    parallelRange(dim, "volume kernel", volumeForwardTask, &pass, 0, d);
+    parallelRange(dim, "volume kernel", volumeDepthTask, &pass, 0, h);
+    //the imaginary parts are rounding noise, the inverse's 1/whd and the normalization of the sums are folded in
+    float scale = (float)(1./(sum*(double)w*h*d));
+    for (size_t k = 0; k < (size_t)bins*h*d; ++k) { v->kernelSpectrum[k] = v->spectrum[2*k]*scale; }
+    return 0;
+}
+
+//a generation of a volume : slices forward, depth through the kernel, slices back and grown
+void doStepVolume(Dimension *dim) {
+    DimVolume *v = dim->volume;
+    double t = dimClock();
+    if (prepareVolume(dim) != 0) {
+        fprintf(stderr, "Failed to allocate the transforms of a %dx%dx%d dimension, it is not stepped\n", v->w, v->h, v->d);
+        return;
+    }
+    uint64_t key = volumeKernelKey(dim);
+    if (key != v->kernelKey) {
+        if (buildVolumeKernel(dim) != 0) { return; }
+        v->kernelKey = key;
+    }
+    prepareGrowth(dim);
+    DimVolumePass pass = { true, true };
+    parallelRange(dim, "volume rows", volumeForwardTask, &pass, 0, v->d);
+    parallelRange(dim, "volume depth", volumeDepthTask, &pass, 0, v->h);
+    t = lapPhase(dim, DIM_PHASE_CONVOLUTION, t);
+    //the inverse transforms of the slices are fused with their growth and counted with it
+    parallelRange(dim, "volume growth", volumeGrowthTask, &pass, 0, v->d);
+    lapPhase(dim, DIM_PHASE_GROWTH, t);
+}
@@ -0,0 +1,467 @@
+/*  Distributed world : the torus is split in 2D blocks, one per MPI rank, stepped with halo exchanges    */
+
+
+/********************** PREPROCESSOR **********************/
+
+//LIBS
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <mpi.h>
+#include <dimensions.h>
+
+//DEFS
+#define TAG_LEFT 0  //data travelling towards the lower x
+#define TAG_RIGHT 1
+#define TAG_UP 2    //data travelling towards the lower y
+#define TAG_DOWN 3
+
+//the cells a rank owns, kept in a Dimension padded with r halo cells on every side
+//the padded world wraps on itself, which only ever spoils the halo cells, refreshed before each generation
+typedef struct Block {
+    MPI_Comm comm; //periodic cartesian communicator
+    int rank;
+    int dims[2];   //ranks along x and y
+    int coords[2];
+    int left, right, up, down;
+    int x0, y0;    //first owned cell in the global grid
+    int w, h;      //owned cells
+    int r;
+    Dimension *dim;
+    float *send[4];
+    float *recv[4];
+    double exchangeTime; //seconds spent waiting on halos
+} Block;
+
+void usage();
+Block *createBlock(MPI_Comm world, int width, int height, int r, int threads);
+void destroyBlock(Block *b);
+void blockExtent(Block *b, int coords[2], int *x0, int *y0, int *w, int *h);
+void postX(Block *b, MPI_Request req[4]);
+void finishX(Block *b, MPI_Request req[4]);
+void postY(Block *b, MPI_Request req[4]);
+void finishY(Block *b, MPI_Request req[4]);
+void stepBlock(Block *b);
+bool gatherStates(Block *b, float *global);
+void scatterStates(Block *b, const float *global);
+bool writeFrame(DimStream *stream, Dimension *frame, const float *global);
+double checkAgainstSingle(const float *initial, const float *final);
+
+
+/********************** C **********************/
+
+int width = 1024;
+int height = 1024;
+int radius = 13;
+int generations = 100;
+int threads = 1;
+int frameEvery = 0;
+const char *outPath = NULL;
+const char *blobPath = NULL;
+DimStreamType frameType = DIM_STREAM_FLOAT32;
+bool check = false;
+double checkTol = 0.;
+unsigned long long seed; //of the random world, drawn whole by rank 0
+
+
+/************************* MAIN  *************************/
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    seed = (unsigned long long)time(NULL);
+    for (int k = 1; k < argc; ++k) {
+        if (strcmp(argv[k], "-n") == 0 && k+1 < argc) {
+            width = height = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-r") == 0 && k+1 < argc) {
+            radius = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-g") == 0 && k+1 < argc) {
+            generations = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-t") == 0 && k+1 < argc) {
+            threads = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-b") == 0 && k+1 < argc) {
+            blobPath = argv[++k];
+        } else if (strcmp(argv[k], "-o") == 0 && k+1 < argc) {
+            outPath = argv[++k];
+        } else if (strcmp(argv[k], "-f") == 0 && k+1 < argc) {
+            frameEvery = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-u") == 0) {
+            frameType = DIM_STREAM_UINT8;
+        } else if (strcmp(argv[k], "-c") == 0) {
+            check = true;
+        } else if (strcmp(argv[k], "-x") == 0 && k+1 < argc) {
+            checkTol = atof(argv[++k]);
+        } else if (strcmp(argv[k], "-s") == 0 && k+1 < argc) {
+            seed = strtoull(argv[++k], NULL, 10);
+        } else {
+            if (rank == 0) { usage(); }
+            MPI_Finalize();
+            return 2;
+        }
+    }
+
+    //a blob fixes the size of the world, rank 0 reads it and deals out the blocks
+    if (blobPath != NULL) {
+        long len = getBlobLength(blobPath);
+        width = height = (int)sqrt((double)len);
+        if (len <= 0 || (long)width*height != len) {
+            if (rank == 0) { fprintf(stderr, "\"%s\" not found or not square\n", blobPath); }
+            MPI_Finalize();
+            return 1;
+        }
+    }
+
+    Block *b = createBlock(MPI_COMM_WORLD, width, height, radius, threads);
+    int ok = b != NULL, allOk;
+    MPI_Allreduce(&ok, &allOk, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!allOk) {
+        destroyBlock(b);
+        MPI_Finalize();
+        return 1;
+    }
+
+    //the whole grid only lives on rank 0, which reads or randomizes it, so that the world is the same whatever
+    //the number of ranks, and deals it out
+    float *global = rank == 0 ? malloc((size_t)width*height*sizeof(float)) : NULL;
+    float *initial = rank == 0 && check ? malloc((size_t)width*height*sizeof(float)) : NULL;
+    Dimension *frame = NULL;
+    DimStream *stream = NULL;
+    ok = rank != 0 || (global != NULL && (!check || initial != NULL));
+    if (rank == 0 && ok) {
+        //randomize draws a separate oldState, the blocks start from the states alone like a loaded save
+        Dimension *loaded = blobPath != NULL
+            ? CreateDimension(width, height, 1, radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, radius)
+            : CreateInPlaceDimension(width, height, radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, radius, DIM_STORAGE_FLOAT32);
+        ok = loaded != NULL;
+        if (ok && blobPath != NULL) {
+            ok = loadDimensionBlob(loaded, blobPath) == 0;
+        } else if (ok) {
+            setDimensionSeed(loaded, seed);
+            randomizeDimensionByKernel(loaded);
+        }
+        for (int j = 0; ok && j < height; ++j) { getStateRow(loaded, j, global + (size_t)j*width); }
+        DestroyDimension(loaded);
+    }
+    if (rank == 0 && ok && outPath != NULL) {
+        frame = CreateInPlaceDimension(width, height, radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, radius, DIM_STORAGE_FLOAT32);
+        stream = frame != NULL ? openDimStream(outPath, DIM_STREAM_NPY, frameType) : NULL;
+        ok = stream != NULL;
+    }
+    MPI_Allreduce(&ok, &allOk, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!allOk) {
+        if (rank == 0) { fprintf(stderr, "Failed to prepare the world on rank 0\n"); }
+        closeDimStream(stream);
+        DestroyDimension(frame);
+        free(global);
+        free(initial);
+        destroyBlock(b);
+        MPI_Finalize();
+        return 1;
+    }
+
+    scatterStates(b, global);
+    if (check) { gatherStates(b, initial); }
+
+    MPI_Barrier(b->comm);
+    double start = MPI_Wtime();
+    for (int g = 1; g <= generations; ++g) {
+        stepBlock(b);
+        //every rank takes part in the gather, only rank 0 writes
+        if (outPath != NULL) {
+            bool due = frameEvery > 0 ? g % frameEvery == 0 : g == generations;
+            if (due && gatherStates(b, global)) { writeFrame(stream, frame, global); }
+        }
+    }
+    double elapsed = MPI_Wtime() - start, slowest, exchange;
+    MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, b->comm);
+    MPI_Reduce(&b->exchangeTime, &exchange, 1, MPI_DOUBLE, MPI_MAX, 0, b->comm);
+
+    int status = 0;
+    if (check && gatherStates(b, global)) {
+        double dev = checkAgainstSingle(initial, global);
+        status = dev <= checkTol ? 0 : 1;
+        fprintf(stderr, "check against a single world : max deviation %.3g (tol %.3g) %s\n", dev, checkTol, status == 0 ? "ok" : "FAILED");
+    }
+    if (rank == 0) {
+        printf("{\"ranks\": %d, \"grid\": [%d, %d], \"blocks\": [%d, %d], \"radius\": %d, \"threads\": %d, "
+            "\"generations\": %d, \"seconds\": %.6f, \"steps_per_second\": %.4f, \"cell_updates_per_second\": %.1f, \"halo_wait_s\": %.6f}\n",
+            size, width, height, b->dims[0], b->dims[1], radius, threads,
+            generations, slowest, generations/slowest, (double)width*height*generations/slowest, exchange);
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, b->comm);
+
+    closeDimStream(stream);
+    DestroyDimension(frame);
+    free(global);
+    free(initial);
+    destroyBlock(b);
+    MPI_Finalize();
+    return status;
+}
+
+
+/************************* FUNCTIONS  *************************/
+
+void usage() {
+    fprintf(stderr,
+        "usage : mpirun -np ranks distributed [-n size] [-r radius] [-g generations] [-t threads]\n"
+        "                                     [-b blob] [-o out.npy] [-f every] [-u] [-c] [-x tol] [-s seed]\n"
+        "  -n  side of the square world (1024), ignored with -b\n"
+        "  -t  threads stepping the block of each rank (1)\n"
+        "  -b  initial state from a .blob save, else a random world, either made whole by rank 0 and dealt out\n"
+        "  -o  gathers frames on rank 0 into a .npy stream, the last one only unless -f is given\n"
+        "  -f  writes a frame every this many generations\n"
+        "  -u  writes uint8 frames instead of float32\n"
+        "  -c  steps the same world on rank 0 alone and compares, exits with 1 past the tolerance\n"
+        "  -x  largest deviation allowed by -c (0, the blocks are meant to be bit identical)\n"
+        "  -s  seed of the random world, the same for any number of ranks (the time of rank 0)\n"
+        "  the left and right halos are in flight while the cells away from every halo are convolved, the upper and\n"
+        "  lower ones while the columns next to the left and right halos are\n"
+        "  prints a json summary on stdout\n");
+}
+
+//owned cells of the block at coords, the remainder of the division spread over the blocks
+void blockExtent(Block *b, int coords[2], int *x0, int *y0, int *w, int *h) {
+    *x0 = (int)((long)width*coords[0]/b->dims[0]);
+    *y0 = (int)((long)height*coords[1]/b->dims[1]);
+    *w = (int)((long)width*(coords[0]+1)/b->dims[0]) - *x0;
+    *h = (int)((long)height*(coords[1]+1)/b->dims[1]) - *y0;
+}
+
+Block *createBlock(MPI_Comm world, int width, int height, int r, int threads) {
+    Block *b = calloc(1, sizeof(Block));
+    if (b == NULL) { return NULL; }
+    int size, periods[2] = { 1, 1 };
+    MPI_Comm_size(world, &size);
+    MPI_Dims_create(size, 2, b->dims);
+    MPI_Cart_create(world, 2, b->dims, periods, 1, &b->comm);
+    MPI_Comm_rank(b->comm, &b->rank);
+    MPI_Cart_coords(b->comm, b->rank, 2, b->coords);
+    MPI_Cart_shift(b->comm, 0, 1, &b->left, &b->right);
+    MPI_Cart_shift(b->comm, 1, 1, &b->up, &b->down);
+    blockExtent(b, b->coords, &b->x0, &b->y0, &b->w, &b->h);
+    b->r = r;
+
+    //halos only come from the next block, which must be at least as wide as them
+    if (b->w < r || b->h < r) {
+        if (b->rank == 0) { fprintf(stderr, "Blocks of %dx%d cells are thinner than the radius %d, use fewer ranks\n", b->w, b->h, r); }
+        destroyBlock(b);
+        return NULL;
+    }
+    b->dim = CreateDimension(b->w+2*r, b->h+2*r, 1, r, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, r);
+    size_t columns = (size_t)r*b->h, rows = (size_t)r*(b->w+2*r);
+    bool ok = b->dim != NULL;
+    for (int k = 0; k < 4 && ok; ++k) {
+        b->send[k] = malloc((k < 2 ? columns : rows)*sizeof(float));
+        b->recv[k] = malloc((k < 2 ? columns : rows)*sizeof(float));
+        ok = b->send[k] != NULL && b->recv[k] != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "Rank %d failed to allocate its %dx%d block\n", b->rank, b->w, b->h);
+        destroyBlock(b);
+        return NULL;
+    }
+    setDimensionThreads(b->dim, threads);
+    return b;
+}
+
+void destroyBlock(Block *b) {
+    if (b == NULL) { return; }
+    for (int k = 0; k < 4; ++k) {
+        free(b->send[k]);
+        free(b->recv[k]);
+    }
+    DestroyDimension(b->dim);
+    if (b->comm != MPI_COMM_NULL && b->comm != 0) { MPI_Comm_free(&b->comm); }
+    free(b);
+}
+
+//copies the r x n cells at (x, y) of the padded block, row by row, from (pack) or into the buffer
+static void copyCells(Block *b, int x, int y, int w, int h, float *buffer, bool pack) {
+    Cell *cells = getMatrixPointer(b->dim);
+    int stride = getMatrixWidth(b->dim);
+    for (int j = 0; j < h; ++j) {
+        Cell *row = &cells[(size_t)(y+j)*stride + x];
+        for (int i = 0; i < w; ++i) {
+            if (pack) {
+                *buffer++ = row[i].state;
+            } else {
+                row[i].state = row[i].oldState = *buffer++;
+            }
+        }
+    }
+}
+
+//first phase : the owned columns next to the left and right neighbours, for the owned rows only
+void postX(Block *b, MPI_Request req[4]) {
+    int r = b->r, w = b->w, h = b->h, n = r*h;
+    copyCells(b, r, r, r, h, b->send[0], true);
+    copyCells(b, w, r, r, h, b->send[1], true);
+    MPI_Irecv(b->recv[0], n, MPI_FLOAT, b->left, TAG_RIGHT, b->comm, &req[0]);
+    MPI_Irecv(b->recv[1], n, MPI_FLOAT, b->right, TAG_LEFT, b->comm, &req[1]);
+    MPI_Isend(b->send[0], n, MPI_FLOAT, b->left, TAG_LEFT, b->comm, &req[2]);
+    MPI_Isend(b->send[1], n, MPI_FLOAT, b->right, TAG_RIGHT, b->comm, &req[3]);
+}
+
+void finishX(Block *b, MPI_Request req[4]) {
+    int r = b->r, w = b->w, h = b->h;
+    double t = MPI_Wtime();
+    MPI_Waitall(4, req, MPI_STATUSES_IGNORE);
+    b->exchangeTime += MPI_Wtime() - t;
+    copyCells(b, 0, r, r, h, b->recv[0], false);
+    copyCells(b, w+r, r, r, h, b->recv[1], false);
+}
+
+//second phase : the owned rows next to the upper and lower neighbours, over the whole padded width
+//so that the corners, received by the first phase, reach the diagonal neighbours
+void postY(Block *b, MPI_Request req[4]) {
+    int r = b->r, h = b->h, n = r*(b->w+2*r);
+    copyCells(b, 0, r, b->w+2*r, r, b->send[2], true);
+    copyCells(b, 0, h, b->w+2*r, r, b->send[3], true);
+    MPI_Irecv(b->recv[2], n, MPI_FLOAT, b->up, TAG_DOWN, b->comm, &req[0]);
+    MPI_Irecv(b->recv[3], n, MPI_FLOAT, b->down, TAG_UP, b->comm, &req[1]);
+    MPI_Isend(b->send[2], n, MPI_FLOAT, b->up, TAG_UP, b->comm, &req[2]);
+    MPI_Isend(b->send[3], n, MPI_FLOAT, b->down, TAG_DOWN, b->comm, &req[3]);
+}
+
+void finishY(Block *b, MPI_Request req[4]) {
+    int r = b->r, h = b->h;
+    double t = MPI_Wtime();
+    MPI_Waitall(4, req, MPI_STATUSES_IGNORE);
+    b->exchangeTime += MPI_Wtime() - t;
+    copyCells(b, 0, 0, b->w+2*r, r, b->recv[2], false);
+    copyCells(b, 0, h+r, b->w+2*r, r, b->recv[3], false);
+}
+
+//one generation of the block, each part of it convolved as soon as the halos it reads are in
+//the upper and lower halos carry the corners, they are only sent once the left and right ones arrived
+void stepBlock(Block *b) {
+    int r = b->r, w = b->w, h = b->h;
+    MPI_Request req[4];
+    postX(b, req);
+    //padded rows [2r, h) only read the owned rows [r, h+r), padded columns [2r, w) the owned columns
+    bool interior = h > 2*r;
+    if (interior) { convolveDimensionRegion(b->dim, 2*r, w, 2*r, h); }
+    finishX(b, req);
+    postY(b, req);
+    //the columns next to the left and right halos, those of a block thinner than 2r overlap and are convolved twice
+    if (interior) {
+        convolveDimensionRegion(b->dim, r, 2*r, 2*r, h);
+        convolveDimensionRegion(b->dim, w, w+r, 2*r, h);
+    }
+    finishY(b, req);
+    if (interior) {
+        convolveDimensionRows(b->dim, r, 2*r);
+        convolveDimensionRows(b->dim, h, h+r);
+    } else {
+        convolveDimensionRows(b->dim, r, h+r);
+    }
+    growDimensionRows(b->dim, r, h+r);
+}
+
+//collects the owned states of every rank into the row-major global grid of rank 0, true on rank 0
+bool gatherStates(Block *b, float *global) {
+    int size;
+    MPI_Comm_size(b->comm, &size);
+    float *mine = malloc((size_t)b->w*b->h*sizeof(float));
+    float *all = b->rank == 0 ? malloc((size_t)width*height*sizeof(float)) : NULL;
+    int *counts = b->rank == 0 ? malloc(2*size*sizeof(int)) : NULL;
+    if (mine == NULL || (b->rank == 0 && (all == NULL || counts == NULL))) {
+        fprintf(stderr, "Failed to allocate the gathered frame\n");
+        MPI_Abort(b->comm, 1);
+    }
+    copyCells(b, b->r, b->r, b->w, b->h, mine, true);
+
+    int *displs = counts != NULL ? counts + size : NULL;
+    if (b->rank == 0) {
+        for (int k = 0, offset = 0; k < size; ++k) {
+            int coords[2], x0, y0, w, h;
+            MPI_Cart_coords(b->comm, k, 2, coords);
+            blockExtent(b, coords, &x0, &y0, &w, &h);
+            counts[k] = w*h;
+            displs[k] = offset;
+            offset += w*h;
+        }
+    }
+    MPI_Gatherv(mine, b->w*b->h, MPI_FLOAT, all, counts, displs, MPI_FLOAT, 0, b->comm);
+    if (b->rank == 0) {
+        for (int k = 0; k < size; ++k) {
+            int coords[2], x0, y0, w, h;
+            MPI_Cart_coords(b->comm, k, 2, coords);
+            blockExtent(b, coords, &x0, &y0, &w, &h);
+            for (int j = 0; j < h; ++j) { memcpy(global + (size_t)(y0+j)*width + x0, all + displs[k] + (size_t)j*w, w*sizeof(float)); }
+        }
+    }
+    free(mine);
+    free(all);
+    free(counts);
+    return b->rank == 0;
+}
+
+//deals out the global grid of rank 0 to the blocks
+void scatterStates(Block *b, const float *global) {
+    int size;
+    MPI_Comm_size(b->comm, &size);
+    float *mine = malloc((size_t)b->w*b->h*sizeof(float));
+    float *all = b->rank == 0 ? malloc((size_t)width*height*sizeof(float)) : NULL;
+    int *counts = b->rank == 0 ? malloc(2*size*sizeof(int)) : NULL;
+    if (mine == NULL || (b->rank == 0 && (all == NULL || counts == NULL))) {
+        fprintf(stderr, "Failed to allocate the scattered frame\n");
+        MPI_Abort(b->comm, 1);
+    }
+
+    int *displs = counts != NULL ? counts + size : NULL;
+    if (b->rank == 0) {
+        for (int k = 0, offset = 0; k < size; ++k) {
+            int coords[2], x0, y0, w, h;
+            MPI_Cart_coords(b->comm, k, 2, coords);
+            blockExtent(b, coords, &x0, &y0, &w, &h);
+            for (int j = 0; j < h; ++j) { memcpy(all + offset + (size_t)j*w, global + (size_t)(y0+j)*width + x0, w*sizeof(float)); }
+            counts[k] = w*h;
+            displs[k] = offset;
+            offset += w*h;
+        }
+    }
+    MPI_Scatterv(all, counts, displs, MPI_FLOAT, mine, b->w*b->h, MPI_FLOAT, 0, b->comm);
+    copyCells(b, b->r, b->r, b->w, b->h, mine, false);
+    free(mine);
+    free(all);
+    free(counts);
+}
+
+bool writeFrame(DimStream *stream, Dimension *frame, const float *global) {
+    for (int j = 0; j < height; ++j) { setStateRow(frame, j, global + (size_t)j*width); }
+    return writeDimStream(stream, frame) == 0;
+}
+
+//steps the initial grid as a single world with the same parameters, returns the largest deviation from final
+double checkAgainstSingle(const float *initial, const float *final) {
+    Dimension *dim = CreateDimension(width, height, 1, radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, radius);
+    float *row = malloc(width*sizeof(float));
+    if (dim == NULL || row == NULL) {
+        DestroyDimension(dim);
+        free(row);
+        return INFINITY;
+    }
+    setDimensionThreads(dim, threads);
+    //the blocks are convolved row by row by the direct engine, so is the check
+    setDimensionEngine(dim, DIM_ENGINE_DIRECT);
+    for (int j = 0; j < height; ++j) { setStateRow(dim, j, initial + (size_t)j*width); }
+    for (int g = 0; g < generations; ++g) { doStep(dim); }
+    double max = 0.;
+    for (int j = 0; j < height; ++j) {
+        getStateRow(dim, j, row);
+        for (int i = 0; i < width; ++i) {
+            double dev = fabs((double)row[i] - (double)final[(size_t)j*width + i]);
+            if (dev > max) { max = dev; }
+        }
+    }
+    DestroyDimension(dim);
+    free(row);
+    return max;
+}
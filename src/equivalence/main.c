@@ -0,0 +1,518 @@
+/*  Numerical equivalence of the step engines against the reference scalar loop    */
+/*  and of the volume steps against a direct sum over the ball                     */
+
+
+/********************** PREPROCESSOR **********************/
+
+//LIBS
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <dimensions.h>
+
+//DEFS
+typedef struct Variant {
+    const char *name;
+    void (*setup)(Dimension *dim);
+    double maxTol;  //largest absolute deviation allowed on a cell
+    double meanTol; //largest mean absolute deviation allowed over the world
+    int divergence; //earliest generation the variant may leave its tolerances at
+    int depth;      //generations per doSteps call, compared every depth generations, 0 for doStep
+    int inPlace;    //the variant world is created with CreateInPlaceDimension
+    void (*rules)(Dimension *dim); //growth and kernel functions given to both worlds, NULL for the default ones
+} Variant;
+
+//a volume variant, stepped with its 3D transforms against a direct sum over the ball
+typedef struct VolumeVariant {
+    const char *name;
+    int threads;    //more than one : also compared with the volume stepped by a single thread, which it must match exactly
+    double maxTol;
+    double meanTol;
+    int divergence;
+} VolumeVariant;
+
+//small enough for the direct sum over the ball, with sides that are not powers of two
+#define VOLUME_WIDTH 20
+#define VOLUME_HEIGHT 18
+#define VOLUME_DEPTH 12
+#define VOLUME_RADIUS 4
+
+typedef struct Scenario {
+    const char *name;
+    const char *blob; //NULL for a randomized world
+    int size;
+    int radius;
+} Scenario;
+
+void usage();
+bool runVariant(Variant *v, Scenario *sc);
+bool runVolume(VolumeVariant *v);
+bool reportRun(const char *name, const char *scenario, int divergence, int earliest, double max, double maxTol, double mean, double meanTol);
+void stepBallSum(Dimension *dim, const float *taps, double weight, const float *states, float *next);
+void setupDirect(Dimension *dim);
+void setupDirectThreaded(Dimension *dim);
+void setupPinned(Dimension *dim);
+void setupGrowthLUT(Dimension *dim);
+void setupFastExp(Dimension *dim);
+void setupJIT(Dimension *dim);
+void setupFloat16(Dimension *dim);
+void setupFixed16(Dimension *dim);
+void setupUint8(Dimension *dim);
+void setupMorton(Dimension *dim);
+void setupMortonFixed16(Dimension *dim);
+void setupFFT(Dimension *dim);
+void setupFFTThreaded(Dimension *dim);
+void setupAuto(Dimension *dim);
+void setupChannels(Dimension *dim);
+void setupChannelsThreaded(Dimension *dim);
+void setupChannelsFFT(Dimension *dim);
+void rulesPolynomial(Dimension *dim);
+void rulesAsymmetric(Dimension *dim);
+void rulesCallback(Dimension *dim);
+void rulesStepKernel(Dimension *dim);
+
+
+/********************** C **********************/
+
+//every alternative path of doStep, each compared to DIM_ENGINE_REFERENCE over the whole run
+//the tolerances tell when the variant has diverged from the reference, the run fails when that happens before the
+//variant's earliest divergence : a path summing the same floats in another order starts about 1e-7 away and the
+//dynamics being chaotic the gap grows about tenfold every 8 generations of random-r5, the earliest divergence is
+//about two thirds of the earliest one of seeds 1 to 9 in any scenario, the saved scenes diverging much later if ever
+//the quantized storages start a rounding away, their tolerances follow from their step
+Variant variants[] = {
+    { "direct", setupDirect, 1e-2, 2e-5, 30 }, //random-r5 diverges from 48
+    { "direct-threaded", setupDirectThreaded, 1e-2, 2e-5, 30 }, //random-r5 diverges from 48
+    { "direct-pinned", setupPinned, 1e-2, 2e-5, 30 }, //the sums of direct-threaded
+    { "growth-lut", setupGrowthLUT, 1e-2, 2e-5, 20 }, //the interpolated growth starts about 1e-4 away, random-r5 from 29
+    { "growth-fastexp", setupFastExp, 1e-2, 2e-5, 30 }, //random-r5 diverges from 47
+    { "jit", setupJIT, 1e-2, 2e-5, 30 }, //the sums of direct-threaded
+    { "blocked-4", setupDirect, 1e-2, 2e-5, 30, 4 }, //the sums of direct
+    { "blocked-4-threaded", setupDirectThreaded, 1e-2, 2e-5, 30, 4 }, //the sums of direct-threaded
+    { "in-place", setupDirect, 1e-2, 2e-5, 30, 0, 1 }, //random-r5 diverges from 45
+    { "in-place-threaded", setupDirectThreaded, 1e-2, 2e-5, 30, 0, 1 }, //random-r5 diverges from 45
+    //states rounded to 1/65535 every generation, random-r5 diverges from 27
+    { "in-place-fixed16", setupFixed16, 2.5e-2, 5e-5, 20, 0, 1 },
+    { "layout-morton", setupMorton, 1e-2, 2e-5, 30 }, //the sums of direct-threaded
+    { "in-place-morton-fixed16", setupMortonFixed16, 2.5e-2, 5e-5, 20, 0, 1 },
+    //11 bits, states near 1 rounded by up to 2.4e-4 every generation, random-r5 diverges from 18
+    { "storage-float16", setupFloat16, 6e-2, 1.5e-4, 10, 0, 1 },
+    //states rounded to steps of 1/255, a cell is a step away after a generation and the growth doubles the gap about
+    //every 2 : diverged past 2 steps a generation or a quarter of a step on the mean, from 6 on
+    { "storage-uint8", setupUint8, 8./255, .25/255, 4, 0, 1 },
+    { "fft", setupFFT, 1e-2, 2e-5, 25 }, //the transforms start about 1e-6 away, random-r5 from 35
+    { "fft-threaded", setupFFTThreaded, 1e-2, 2e-5, 25 }, //the transforms start about 1e-6 away, random-r5 from 35
+    { "channels", setupChannels, 1e-2, 2e-5, 30 }, //random-r5 diverges from 49
+    { "channels-threaded", setupChannelsThreaded, 1e-2, 2e-5, 30 }, //random-r5 diverges from 49
+    { "channels-fft", setupChannelsFFT, 1e-2, 2e-5, 25 }, //the transforms start about 1e-6 away, random-r5 from 35
+    { "growth-polynomial", setupDirect, 1e-2, 2e-5, 25, 0, 0, rulesPolynomial }, //random-r5 diverges from 40
+    { "growth-polynomial-channels", setupChannels, 1e-2, 2e-5, 25, 0, 0, rulesPolynomial }, //random-r5 from 40
+    { "growth-asymmetric-fastexp", setupFastExp, 1e-2, 2e-5, 30, 0, 0, rulesAsymmetric }, //not diverged in 50
+    { "growth-callback-threaded", setupDirectThreaded, 1e-2, 2e-5, 30, 0, 0, rulesCallback }, //not diverged in 50
+    { "kernel-step-fft", setupFFT, 1e-2, 2e-5, 25, 0, 0, rulesStepKernel }, //random-r5 diverges from 38
+    { "engine-auto", setupAuto, 1e-2, 2e-5, 30 }, //the sums of direct-threaded
+};
+
+//the transform sums drift from the double ones by about 5e-4 at most over 50 generations, mean 5e-6
+VolumeVariant volumes[] = {
+    { "volume", 1, 2e-3, 2e-5, 50 },
+    { "volume-threaded", 3, 2e-3, 2e-5, 50 },
+};
+
+Scenario scenarios[] = {
+    { "random-r5", NULL, 96, 5 },
+    { "random-r7", NULL, 96, 7 }, //no generated row convolution, covers the generic one
+    { "random-r13", NULL, 128, 13 },
+    { "glider", "glider", 0, 13 },
+    { "colision", "colision", 0, 13 },
+};
+
+const char *savesDir = "./saves";
+const char *only = NULL;
+int generations = 50;
+double maxTolOverride = -1.;
+double meanTolOverride = -1.;
+bool verbose = false;
+unsigned long long seed; //of the random scenarios, printed so that a failure can be replayed with -R
+
+
+/************************* MAIN  *************************/
+int main(int argc, char **argv) {
+    seed = (unsigned long long)time(NULL);
+    for (int k = 1; k < argc; ++k) {
+        if (strcmp(argv[k], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[k], "-e") == 0 && k+1 < argc) {
+            only = argv[++k];
+        } else if (strcmp(argv[k], "-g") == 0 && k+1 < argc) {
+            generations = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-s") == 0 && k+1 < argc) {
+            savesDir = argv[++k];
+        } else if (strcmp(argv[k], "-x") == 0 && k+1 < argc) {
+            maxTolOverride = atof(argv[++k]);
+        } else if (strcmp(argv[k], "-a") == 0 && k+1 < argc) {
+            meanTolOverride = atof(argv[++k]);
+        } else if (strcmp(argv[k], "-R") == 0 && k+1 < argc) {
+            seed = strtoull(argv[++k], NULL, 10);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (verbose) { printf("variant,scenario,generation,max_abs_dev,mean_abs_dev\n"); }
+
+    int failures = 0, runs = 0;
+    for (int v = 0; v < (int)(sizeof(variants)/sizeof(variants[0])); ++v) {
+        if (only != NULL && strcmp(only, variants[v].name) != 0) { continue; }
+        for (int s = 0; s < (int)(sizeof(scenarios)/sizeof(scenarios[0])); ++s) {
+            if (!runVariant(&variants[v], &scenarios[s])) { ++failures; }
+            ++runs;
+        }
+    }
+    for (int v = 0; v < (int)(sizeof(volumes)/sizeof(volumes[0])); ++v) {
+        if (only != NULL && strcmp(only, volumes[v].name) != 0) { continue; }
+        if (!runVolume(&volumes[v])) { ++failures; }
+        ++runs;
+    }
+
+    if (runs == 0) {
+        fprintf(stderr, "No variant named \"%s\"\n", only);
+        return 2;
+    }
+    fprintf(stderr, "%d/%d runs diverged no earlier than allowed, random scenarios seeded with %llu\n", runs-failures, runs, seed);
+    return failures == 0 ? 0 : 1;
+}
+
+
+/************************* FUNCTIONS  *************************/
+
+void usage() {
+    fprintf(stderr,
+        "usage : equivalence [-v] [-e variant] [-g generations] [-s savesdir] [-x maxtol] [-a meantol] [-R seed]\n"
+        "  -v  print the deviations of every generation as csv on stdout\n"
+        "  -g  generations compared (50)\n"
+        "  -x  overrides the per cell tolerance of every variant\n"
+        "  -a  overrides the mean tolerance of every variant\n"
+        "  -R  seed of the random scenarios and volume (the time)\n"
+        "  prints the first generation over tolerance of every run, exits with 1 when a run reaches it before\n"
+        "  the earliest divergence of its variant\n");
+}
+
+void setupDirect(Dimension *dim) {
+    setDimensionEngine(dim, DIM_ENGINE_DIRECT);
+}
+
+void setupDirectThreaded(Dimension *dim) {
+    setDimensionEngine(dim, DIM_ENGINE_DIRECT);
+    setDimensionThreads(dim, 4);
+}
+
+void setupPinned(Dimension *dim) {
+    setDimensionEngine(dim, DIM_ENGINE_DIRECT);
+    setDimensionAffinity(dim, DIM_AFFINITY_SCATTER);
+    setDimensionThreads(dim, 4);
+}
+
+void setupGrowthLUT(Dimension *dim) {
+    setGrowthLUT(dim, 0, 1e-6f);
+}
+
+void setupFastExp(Dimension *dim) {
+    setGrowthMode(dim, DIM_GROWTH_FASTEXP);
+}
+
+void setupJIT(Dimension *dim) {
+    setDimensionEngine(dim, DIM_ENGINE_JIT);
+}
+
+void setupFloat16(Dimension *dim) {
+    setStateStorage(dim, DIM_STORAGE_FLOAT16);
+}
+
+void setupFixed16(Dimension *dim) {
+    setStateStorage(dim, DIM_STORAGE_FIXED16);
+}
+
+void setupUint8(Dimension *dim) {
+    setStateStorage(dim, DIM_STORAGE_UINT8);
+}
+
+void setupMorton(Dimension *dim) {
+    setStateLayout(dim, DIM_LAYOUT_MORTON);
+}
+
+void setupMortonFixed16(Dimension *dim) {
+    setStateStorage(dim, DIM_STORAGE_FIXED16);
+    setStateLayout(dim, DIM_LAYOUT_MORTON);
+}
+
+void setupFFT(Dimension *dim) {
+    setDimensionEngine(dim, DIM_ENGINE_FFT);
+}
+
+void setupFFTThreaded(Dimension *dim) {
+    setDimensionEngine(dim, DIM_ENGINE_FFT);
+    setDimensionThreads(dim, 4);
+}
+
+//whichever engine the cost model of this machine picks for the scenario
+void setupAuto(Dimension *dim) {
+    setDimensionEngine(dim, DIM_ENGINE_AUTO);
+}
+
+//a single channel grown by a single kernel, the same world through the multi-channel step
+void setupChannels(Dimension *dim) {
+    setDimensionChannels(dim, 1);
+    addChannelKernel(dim, 0, 0, dim->KERNELRAD, 1.f, dim->a, dim->b, dim->c, dim->d);
+}
+
+void setupChannelsThreaded(Dimension *dim) {
+    setupChannels(dim);
+    setDimensionThreads(dim, 4);
+}
+
+void setupChannelsFFT(Dimension *dim) {
+    setupChannels(dim);
+    setDimensionEngine(dim, DIM_ENGINE_FFT);
+}
+
+void rulesPolynomial(Dimension *dim) {
+    setGrowthFunction(dim, DIM_GROWTH_POLYNOMIAL, 0.f);
+    setKernelFunction(dim, DIM_KERNEL_POLYNOMIAL);
+}
+
+void rulesAsymmetric(Dimension *dim) {
+    setGrowthFunction(dim, DIM_GROWTH_ASYMMETRIC, 2.f);
+}
+
+//a smooth bump of width 2c the library knows nothing about
+float triweightGrowth(float sum, const float *params, void *user) {
+    float t = (sum-params[1])/(2.f*params[2]);
+    t = t < -1.f ? 1.f : t > 1.f ? 1.f : t*t;
+    return params[0]*(1.f-t)*(1.f-t)*(1.f-t) + params[3];
+}
+
+void rulesCallback(Dimension *dim) {
+    setGrowthCallback(dim, triweightGrowth, NULL);
+}
+
+void rulesStepKernel(Dimension *dim) {
+    setKernelFunction(dim, DIM_KERNEL_STEP);
+}
+
+//the variants step with the direct engine unless their setup picks another
+Dimension *createScenario(Scenario *sc, int size, bool inPlace) {
+    if (inPlace) { return CreateInPlaceDimension(size, size, sc->radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, sc->radius, DIM_STORAGE_FLOAT32); }
+    Dimension *dim = CreateDimension(size, size, 1, sc->radius, .1f, .5f, 2.f, .15f, .017f, -1.f, .25f, sc->radius);
+    if (dim != NULL) { setDimensionEngine(dim, DIM_ENGINE_DIRECT); }
+    return dim;
+}
+
+//steps a reference world and a variant world from the same state, returns false when out of tolerance
+bool runVariant(Variant *v, Scenario *sc) {
+    double maxTol = maxTolOverride >= 0 ? maxTolOverride : v->maxTol;
+    double meanTol = meanTolOverride >= 0 ? meanTolOverride : v->meanTol;
+    char path[512];
+    int size = sc->size;
+
+    if (sc->blob != NULL) {
+        snprintf(path, sizeof(path), "%s/%s.blob", savesDir, sc->blob);
+        long len = getBlobLength(path);
+        size = (int)sqrt((double)len);
+        if (len <= 0 || (long)size*size != len) {
+            fprintf(stderr, "%s %s : skipped, \"%s\" not found or not square\n", v->name, sc->name, path);
+            return true;
+        }
+    }
+
+    Dimension *ref = createScenario(sc, size, false);
+    Dimension *dim = createScenario(sc, size, v->inPlace);
+    float *a = malloc(size*sizeof(float)), *b = malloc(size*sizeof(float));
+    if (ref == NULL || dim == NULL || a == NULL || b == NULL) {
+        DestroyDimension(ref);
+        DestroyDimension(dim);
+        free(a);
+        free(b);
+        return false;
+    }
+    setDimensionEngine(ref, DIM_ENGINE_REFERENCE);
+    if (v->rules != NULL) {
+        v->rules(ref);
+        v->rules(dim);
+    }
+    if (sc->blob != NULL) {
+        loadDimensionBlob(ref, path);
+    } else {
+        setDimensionSeed(ref, seed);
+        randomizeDimensionByKernel(ref);
+    }
+    copyDimensionState(dim, ref);
+    v->setup(dim);
+    //an in-place world keeps a single state, the reference starts from it too
+    if (v->inPlace) { copyDimensionState(ref, dim); }
+
+    double worstMax = 0., worstMean = 0.;
+    int divergence = -1;
+    unsigned int length = getMatrixLength(ref);
+    for (int g = 1; g <= generations; ++g) {
+        doStep(ref);
+        if (v->depth > 1) {
+            if (g % v->depth != 0) { continue; }
+            doSteps(dim, v->depth);
+        } else {
+            doStep(dim);
+        }
+
+        double max = 0., sum = 0.;
+        for (int j = 0; j < size; ++j) {
+            getStateRow(ref, j, a);
+            getStateRow(dim, j, b);
+            for (int i = 0; i < size; ++i) {
+                double dev = fabs((double)a[i] - (double)b[i]);
+                if (dev > max) { max = dev; }
+                sum += dev;
+            }
+        }
+        double mean = sum/length;
+
+        if (verbose) { printf("%s,%s,%d,%.9g,%.9g\n", v->name, sc->name, g, max, mean); }
+        if (max > worstMax) { worstMax = max; }
+        if (mean > worstMean) { worstMean = mean; }
+        if (divergence < 0 && (max > maxTol || mean > meanTol)) { divergence = g; }
+    }
+
+    bool ok = reportRun(v->name, sc->name, divergence, v->divergence, worstMax, maxTol, worstMean, meanTol);
+
+    DestroyDimension(ref);
+    DestroyDimension(dim);
+    free(a);
+    free(b);
+    return ok;
+}
+
+//prints the deviations and the divergence time of a run, which fails when it diverged before earliest
+bool reportRun(const char *name, const char *scenario, int divergence, int earliest, double max, double maxTol, double mean, double meanTol) {
+    bool ok = divergence < 0 || divergence >= earliest;
+    fprintf(stderr, "%s %s : %s, max %.3g (tol %.3g) mean %.3g (tol %.3g) over %d generations, ", name, scenario,
+        ok ? "ok" : "FAILED", max, maxTol, mean, meanTol, generations);
+    if (divergence < 0) { fprintf(stderr, "not diverged (not before %d)\n", earliest); }
+    else { fprintf(stderr, "diverged at generation %d (not before %d)\n", divergence, earliest); }
+    return ok;
+}
+
+//a generation of the volume states by the sum over the ball of every cell, in double, then the growth of dim
+void stepBallSum(Dimension *dim, const float *taps, double weight, const float *states, float *next) {
+    int w = VOLUME_WIDTH, h = VOLUME_HEIGHT, d = VOLUME_DEPTH, r = VOLUME_RADIUS, side = 2*r+1;
+    const float params[4] = { dim->a, dim->b, dim->c, dim->d };
+    for (int z = 0; z < d; ++z) {
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                double sum = 0.;
+                for (int k = -r; k <= r; ++k) {
+                    for (int j = -r; j <= r; ++j) {
+                        for (int i = -r; i <= r; ++i) {
+                            float tap = taps[((k+r)*side + j+r)*side + i+r];
+                            if (tap == 0.f) { continue; }
+                            sum += tap*states[((size_t)((z+k+d) % d)*h + (y+j+h) % h)*w + (x+i+w) % w];
+                        }
+                    }
+                }
+                size_t c = ((size_t)z*h + y)*w + x;
+                float s = states[c] + triweightGrowth((float)(sum/weight), params, NULL)*dim->DT;
+                next[c] = s > 1.f ? 1.f : s < 0.f ? 0.f : s;
+            }
+        }
+    }
+}
+
+//steps a random volume and the direct sum from the same state, returns false when out of tolerance
+//the growth is the callback of the harness so that the direct sum can apply it too
+bool runVolume(VolumeVariant *v) {
+    double maxTol = maxTolOverride >= 0 ? maxTolOverride : v->maxTol;
+    double meanTol = meanTolOverride >= 0 ? meanTolOverride : v->meanTol;
+    int w = VOLUME_WIDTH, h = VOLUME_HEIGHT, d = VOLUME_DEPTH, r = VOLUME_RADIUS, side = 2*r+1;
+    size_t length = (size_t)w*h*d;
+    //a wider bump than the plane scenarios, with the narrower one a random volume is dead within 30 generations
+    Dimension *one = CreateVolumeDimension(w, h, d, r, .1f, .5f, 2.f, .15f, .03f, -1.f, .25f, r);
+    Dimension *dim = CreateVolumeDimension(w, h, d, r, .1f, .5f, 2.f, .15f, .03f, -1.f, .25f, r);
+    float *states = malloc(length*sizeof(float)), *next = malloc(length*sizeof(float)), *row = malloc(w*sizeof(float));
+    float *taps = malloc((size_t)side*side*side*sizeof(float));
+    if (one == NULL || dim == NULL || states == NULL || next == NULL || row == NULL || taps == NULL) {
+        DestroyDimension(one);
+        DestroyDimension(dim);
+        free(states);
+        free(next);
+        free(row);
+        free(taps);
+        return false;
+    }
+    setGrowthCallback(one, triweightGrowth, NULL);
+    setGrowthCallback(dim, triweightGrowth, NULL);
+    setDimensionSeed(one, seed);
+    randomizeDimensionByKernel(one);
+    copyDimensionState(dim, one);
+    setDimensionThreads(dim, v->threads);
+    for (int k = 0; k < h*d; ++k) { getStateRow(one, k, states + (size_t)k*w); }
+    //the exponential bump of the library written out, sampled over the ball as the volume samples it
+    double weight = 0.;
+    for (int k = -r; k <= r; ++k) {
+        for (int j = -r; j <= r; ++j) {
+            for (int i = -r; i <= r; ++i) {
+                float dist = sqrtf((float)(i*i + j*j + k*k))/r;
+                float tap = dist > 1.f || dist == 0.f ? 0.f : expf(4*(1-1/(4*dist*(1-dist))));
+                taps[((k+r)*side + j+r)*side + i+r] = tap;
+                weight += tap;
+            }
+        }
+    }
+
+    double worstMax = 0., worstMean = 0., worstThreads = 0.;
+    int divergence = -1;
+    for (int g = 1; g <= generations; ++g) {
+        stepBallSum(dim, taps, weight, states, next);
+        float *swap = states;
+        states = next;
+        next = swap;
+        doStep(dim);
+        if (v->threads > 1) { doStep(one); }
+
+        double max = 0., sum = 0., threads = 0.;
+        for (int k = 0; k < h*d; ++k) {
+            getStateRow(dim, k, row);
+            for (int i = 0; i < w; ++i) {
+                double dev = fabs((double)states[(size_t)k*w + i] - (double)row[i]);
+                if (dev > max) { max = dev; }
+                sum += dev;
+            }
+            if (v->threads == 1) { continue; }
+            const float *a = row;
+            getStateRow(one, k, next);
+            for (int i = 0; i < w; ++i) { threads = fmax(threads, fabs((double)a[i] - (double)next[i])); }
+        }
+        double mean = sum/length;
+
+        if (verbose) { printf("%s,%s,%d,%.9g,%.9g\n", v->name, "random-volume", g, max, mean); }
+        if (max > worstMax) { worstMax = max; }
+        if (mean > worstMean) { worstMean = mean; }
+        if (threads > worstThreads) { worstThreads = threads; }
+        if (divergence < 0 && (max > maxTol || mean > meanTol)) { divergence = g; }
+    }
+
+    bool ok = reportRun(v->name, "random-volume", divergence, v->divergence, worstMax, maxTol, worstMean, meanTol);
+    if (worstThreads > 0.) {
+        fprintf(stderr, "%s random-volume : FAILED, %.3g from the volume stepped by a single thread (tol 0)\n", v->name, worstThreads);
+        ok = false;
+    }
+
+    DestroyDimension(one);
+    DestroyDimension(dim);
+    free(states);
+    free(next);
+    free(row);
+    free(taps);
+    return ok;
+}
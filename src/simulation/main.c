@@ -84,26 +84,42 @@ int main() {
         //fps cap
         while ((now - lastFrameTime) < fpsMax) { now = glfwGetTime(); }
 
+        DIM_TRACE_BEGIN("frame");
+        DIM_TRACE_BEGIN("input");
         processInput(window, VBO);
+        DIM_TRACE_END("input");
 
         if(step) {
+            DIM_TRACE_BEGIN("step");
             doStep(dim);
+            DIM_TRACE_END("step");
             //send data to gpu to display
+            double t = dimClock();
+            DIM_TRACE_BEGIN("upload");
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
             glBufferData(GL_ARRAY_BUFFER, sizeof(struct Cell)*getMatrixLength(dim), getMatrixPointer(dim), GL_DYNAMIC_DRAW);
             glBindBuffer(GL_ARRAY_BUFFER, 0);
+            lapPhase(dim, DIM_PHASE_UPLOAD, t);
+            DIM_TRACE_END("upload");
         }
 
         //create new frame
+        double t = dimClock();
+        DIM_TRACE_BEGIN("draw");
         glDrawArrays(GL_POINTS, 0, getMatrixLength(dim));
 
         //display
         glfwSwapBuffers(window);
+        lapPhase(dim, DIM_PHASE_DRAW, t);
+        DIM_TRACE_END("draw");
         glfwPollEvents();
+        DIM_TRACE_END("frame");
 
         lastFrameTime = now;
     }
 
+    dumpPhaseTimesCSV(dim, stderr);
+
     //close glfw, exit
     glfwTerminate();
     return 0;
@@ -159,6 +175,7 @@ void processInput(GLFWwindow *window, unsigned int VBO) {
     //R to reset
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
         memcpy(dim->matrix, dim->matrixInit, sizeof(struct Cell)*getMatrixLength(dim));
+        syncDimension(dim);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(struct Cell)*getMatrixLength(dim), getMatrixPointer(dim), GL_DYNAMIC_DRAW);
@@ -178,6 +195,7 @@ void processInput(GLFWwindow *window, unsigned int VBO) {
         openfile("rb");
         fread(getMatrixPointer(dim), sizeof(struct Cell), getMatrixLength(dim), fp);
         fclose(fp);
+        syncDimension(dim);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(struct Cell)*getMatrixLength(dim), getMatrixPointer(dim), GL_DYNAMIC_DRAW);
@@ -192,7 +210,10 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 
 //initializes all necessary components
 int init() {
+    //DIM_TRACE=path records a chrome trace of the run into path
+    if (getenv("DIM_TRACE") != NULL) { startTrace(getenv("DIM_TRACE")); }
     dim = CreateDimension(256, 256, 3, 13, .1f, 0.5f, 2.0, 0.15, 0.017, -1.0, 0.25, 13);
+    setDimensionThreads(dim, 0);
 
     //init the matrix with random values
     randomizeDimensionByKernel(dim);
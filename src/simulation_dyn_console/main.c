@@ -7,7 +7,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
-#include <time.h>
+#include <stdlib.h>
 #include <glad.h>
 #include <glfw3.h>
 #include <dimensions.h>
@@ -60,8 +60,7 @@ bool noisebutton;
 char filename[255] = "";
 char oldFilename[255] = "";
 bool filenameReady = false;
-double Ttime = 0;
-double zero = 0;
+DimStream *stream = NULL;
 
 unsigned int vShader, fShader, pShader, VAO, VBO;
 GLFWwindow* window;
@@ -83,30 +82,44 @@ int main() {
         //fps cap
         while ((now - lastFrameTime) < fpsMax) { now = glfwGetTime(); }
 
+        DIM_TRACE_BEGIN("frame");
+        DIM_TRACE_BEGIN("input");
         processInput(window, VBO);
+        DIM_TRACE_END("input");
 
         if(step) {
-            doStep(dim);
-            printMatrix(dim);
+            DIM_TRACE_BEGIN("step");
+            //the generations of a pass of the tuned depth, a single one unless autotuned
+            doSteps(dim, getBlockDepth(dim) > 0 ? getBlockDepth(dim) : 1);
+            DIM_TRACE_END("step");
+            if (stream != NULL) { writeDimStream(stream, dim); }
             //send data to gpu to display
+            double t = dimClock();
+            DIM_TRACE_BEGIN("upload");
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
             glBufferData(GL_ARRAY_BUFFER, sizeof(struct Cell)*getMatrixLength(dim), getMatrixPointer(dim), GL_DYNAMIC_DRAW);
             glBindBuffer(GL_ARRAY_BUFFER, 0);
+            lapPhase(dim, DIM_PHASE_UPLOAD, t);
+            DIM_TRACE_END("upload");
         }
 
         //create new frame
+        double t = dimClock();
+        DIM_TRACE_BEGIN("draw");
         glDrawArrays(GL_POINTS, 0, getMatrixLength(dim));
 
         //display
         glfwSwapBuffers(window);
+        lapPhase(dim, DIM_PHASE_DRAW, t);
+        DIM_TRACE_END("draw");
         glfwPollEvents();
+        DIM_TRACE_END("frame");
 
         lastFrameTime = now;
     }
 
-    if (step) { Ttime += clock() - zero; }
-
-    printf("%f\n", Ttime/CLOCKS_PER_SEC);
+    closeDimStream(stream);
+    dumpPhaseTimesCSV(dim, stderr);
 
     //close glfw, exit
     glfwTerminate();
@@ -131,11 +144,6 @@ void processInput(GLFWwindow *window, unsigned int VBO) {
     bool ndpress = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
     if(ndpress && !dpress) {
         dstep = !dstep;
-	if (dstep) {
-	    zero = clock();
-	} else {
-	    Ttime += clock() - zero;
-	}
     }
     dpress = ndpress;
 
@@ -169,6 +177,7 @@ void processInput(GLFWwindow *window, unsigned int VBO) {
     //R to reset
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
         memcpy(dim->matrix, dim->matrixInit, sizeof(struct Cell)*getMatrixLength(dim));
+        syncDimension(dim);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(struct Cell)*getMatrixLength(dim), getMatrixPointer(dim), GL_DYNAMIC_DRAW);
@@ -188,6 +197,7 @@ void processInput(GLFWwindow *window, unsigned int VBO) {
         openfile("rb");
         fread(getMatrixPointer(dim), sizeof(struct Cell), getMatrixLength(dim), fp);
         fclose(fp);
+        syncDimension(dim);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(struct Cell)*getMatrixLength(dim), getMatrixPointer(dim), GL_DYNAMIC_DRAW);
@@ -202,41 +212,58 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 
 //initializes all necessary components
 int init() {
+    //DIM_TRACE=path records a chrome trace of the run into path
+    if (getenv("DIM_TRACE") != NULL) { startTrace(getenv("DIM_TRACE")); }
 
-    int w, h, kr, invFps, ps;
+    int w, h, kr, invFps, ps, sf, threads;
     float dt, rdmd, a, b, c, d, nf;
-    printf("------ CONFIG ------\n");
-    printf("width (128) = ");
+    char streamPath[255];
+    //the prompts go to stderr, stdout may carry the stream
+    fprintf(stderr, "------ CONFIG ------\n");
+    fprintf(stderr, "width (128) = ");
     scanf("%d", &w);
-    printf("height (128) = ");
+    fprintf(stderr, "height (128) = ");
     scanf("%d", &h);
-    printf("kernel size (13) = ");
+    fprintf(stderr, "kernel size (13) = ");
     scanf("%d", &kr);
-    printf("delta t (0.1) = ");
+    fprintf(stderr, "delta t (0.1) = ");
     scanf("%f", &dt);
-    printf("random kernel gen density (0.5) = ");
+    fprintf(stderr, "random kernel gen density (0.5) = ");
     scanf("%f", &rdmd);
-    printf("a (2.0) = ");
+    fprintf(stderr, "a (2.0) = ");
     scanf("%f", &a);
-    printf("b (0.15) = ");
+    fprintf(stderr, "b (0.15) = ");
     scanf("%f", &b);
-    printf("c (0.017) = ");
+    fprintf(stderr, "c (0.017) = ");
     scanf("%f", &c);
-    printf("d (-1.0) = ");
+    fprintf(stderr, "d (-1.0) = ");
     scanf("%f", &d);
-    printf("noise factor (1.0) = ");
+    fprintf(stderr, "noise factor (1.0) = ");
     scanf("%f", &nf);
-    printf("lifepatch size (13) = ");
+    fprintf(stderr, "lifepatch size (13) = ");
     scanf("%d", &ps);
-    printf("max FPS (60) = ");
+    fprintf(stderr, "max FPS (60) = ");
     scanf("%d", &invFps);
     fpsMax = 1.f/invFps;
-    printf("---- END CONFIG ----\n");
+    fprintf(stderr, "threads (0 = one per cpu, -1 = autotuned, a frame then being a pass of the tuned generations) = ");
+    scanf("%d", &threads);
+    fprintf(stderr, "stream output (- for stdout, none) = ");
+    scanf("%254s", streamPath);
+    fprintf(stderr, "stream format (0 raw f32, 1 raw u8, 2 npy f32, 3 npy u8) = ");
+    scanf("%d", &sf);
+    fprintf(stderr, "---- END CONFIG ----\n");
+
+    if (strcmp(streamPath, "none") != 0) {
+        stream = openDimStream(streamPath, sf & 2 ? DIM_STREAM_NPY : DIM_STREAM_RAW, sf & 1 ? DIM_STREAM_UINT8 : DIM_STREAM_FLOAT32);
+    }
 
     dim = CreateDimension(w, h, 3, kr, dt, rdmd, a, b, c, d, nf, ps);
+    setDimensionThreads(dim, threads < 0 ? 0 : threads);
 
     //init the matrix with random values
     randomizeDimensionByKernel(dim);
+    //settings saved for this size on this machine, else two seconds of trials from the random world
+    if (threads < 0) { tuneDimension(dim, 2., 0); }
 
     // glfw init
     glfwInit();